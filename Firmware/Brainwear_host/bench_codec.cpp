@@ -0,0 +1,173 @@
+/**
+ Host benchmark of the block compression of Brainwear_codec.h on a recording: the signals of a BDF
+ file are cut in blocks of BLOCK_FRAMES frames, each channel is coded and decoded back as the
+ firmware and the decoders do, and the decoded samples are compared with the recording. Prints the
+ bits per sample and compression ratio of each signal and the time per sample of the coder and
+ the decoder.
+
+ Signals with a digital range wider than 16 bits are coded as EEG channels (24 bits), the others
+ as MMG channels (16 bits). A BDF recording of the board or of the host build works, e.g.
+   ./brainwear_host -t 60 -c 100:B -c 200:A -c 300:b -d sd
+
+ Usage:
+   bench_codec FILE.BDF [REPEAT]
+**/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Brainwear_codec.h"
+#include "Brainwear_int24.h"
+
+#define BDF_HEADER_BYTES 256
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static long field(const uint8_t *header, size_t offset, size_t width)
+{
+    char buf[16];
+    memcpy(buf, header + offset, width);
+    buf[width] = 0;
+    return strtol(buf, NULL, 10);
+}
+
+struct Signal {
+    char label[17];
+    uint8_t width;      // CODEC_EEG_BITS or CODEC_MMG_BITS
+    int32_t *samples;
+    uint64_t codedBits;
+};
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s FILE.BDF [REPEAT]\n", argv[0]);
+        return 2;
+    }
+    long repeat = argc > 2 ? atol(argv[2]) : 20;
+    FILE *f = fopen(argv[1], "rb");
+    if (f == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *) malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, f) != (size_t) size) {
+        fprintf(stderr, "%s: read error\n", argv[1]);
+        return 1;
+    }
+    fclose(f);
+
+    long headerSize = size >= BDF_HEADER_BYTES ? field(data, 184, 8) : 0;
+    long numSignals = size >= BDF_HEADER_BYTES ? field(data, 252, 4) : 0;
+    if (numSignals <= 0 || numSignals > CODEC_MAX_CHANNELS || headerSize != BDF_HEADER_BYTES * (1 + numSignals) || headerSize > size) {
+        fprintf(stderr, "%s: not a BDF file with up to %d signals\n", argv[1], CODEC_MAX_CHANNELS);
+        return 1;
+    }
+    long perRecord = field(data, 256 + numSignals * 216, 8);
+    for (long i = 1; i < numSignals; i++) {
+        if (field(data, 256 + numSignals * 216 + i * 8, 8) != perRecord) {
+            fprintf(stderr, "signals with different sample rates are not supported\n");
+            return 1;
+        }
+    }
+    long recordSize = numSignals * perRecord * 3;
+    long records = perRecord > 0 ? (size - headerSize) / recordSize : 0;
+    uint32_t frames = records * perRecord;
+    uint32_t blocks = frames / BLOCK_FRAMES;    // the last, partial block is left out
+    frames = blocks * BLOCK_FRAMES;
+    if (blocks == 0) {
+        fprintf(stderr, "%s: less than %d samples\n", argv[1], BLOCK_FRAMES);
+        return 1;
+    }
+
+    Signal signals[CODEC_MAX_CHANNELS];
+    for (long i = 0; i < numSignals; i++) {
+        Signal &s = signals[i];
+        memcpy(s.label, data + 256 + i * 16, 16);
+        s.label[16] = 0;
+        for (int n = 15; n >= 0 && s.label[n] == ' '; n--) s.label[n] = 0;
+        long digitalMax = field(data, 256 + numSignals * 128 + i * 8, 8);
+        s.width = digitalMax > 32767 ? CODEC_EEG_BITS : CODEC_MMG_BITS;
+        s.samples = (int32_t *) malloc(records * perRecord * sizeof(int32_t));
+        for (long r = 0; r < records; r++) {
+            int24LEToInt32(data + headerSize + r * recordSize + i * perRecord * 3, s.samples + r * perRecord, perRecord);
+        }
+        s.codedBits = 0;
+    }
+
+    // one channel of one block at a time, as codecEncodeBlock does
+    static uint8_t coded[CODEC_MAX_BYTES(1, 0, BLOCK_FRAMES)];
+    uint32_t scratch[BLOCK_FRAMES];
+    int32_t decoded[BLOCK_FRAMES];
+    int16_t mmg[BLOCK_FRAMES];
+    bool same = true;
+    double encodeTime = 0, decodeTime = 0;
+    for (long i = 0; i < numSignals; i++) {
+        Signal &s = signals[i];
+        for (uint32_t b = 0; b < blocks; b++) {
+            const int32_t *x = s.samples + b * BLOCK_FRAMES;
+            for (int n = 0; n < BLOCK_FRAMES; n++) mmg[n] = x[n];
+            size_t bytes = 0, bits = 0;
+            double start = seconds();
+            for (long r = 0; r < repeat; r++) {
+                CodecBitWriter w(coded);
+                if (s.width == CODEC_EEG_BITS) {
+                    codecEncodeChannel(w, x, BLOCK_FRAMES, s.width, scratch);
+                } else {
+                    codecEncodeChannel(w, mmg, BLOCK_FRAMES, s.width, scratch);
+                }
+                bits = w.bytes * 8 + w.bits;
+                bytes = w.finish();
+                __asm__ __volatile__("" : : "r"(coded) : "memory");
+            }
+            double middle = seconds();
+            bool ok = true;
+            for (long r = 0; r < repeat; r++) {
+                CodecBitReader reader(coded, bytes);
+                ok = codecDecodeChannel(reader, decoded, BLOCK_FRAMES, s.width);
+                __asm__ __volatile__("" : : "r"(decoded) : "memory");
+            }
+            decodeTime += seconds() - middle;
+            encodeTime += middle - start;
+            if (!ok || memcmp(decoded, x, sizeof(decoded)) != 0) {
+                if (same) fprintf(stderr, "%s: block %u does not decode to the recording\n", s.label, b);
+                same = false;
+            }
+            s.codedBits += bits;
+        }
+    }
+
+    printf("%s: %ld signals, %u blocks of %d frames\n", argv[1], numSignals, blocks, BLOCK_FRAMES);
+    printf("signal            bits  coded bits/sample  ratio\n");
+    uint64_t rawBits = 0, codedBits = 0;
+    for (long i = 0; i < numSignals; i++) {
+        Signal &s = signals[i];
+        double bits = (double) s.codedBits / frames;
+        printf("%-16s  %4u  %17.2f  %5.2f\n", s.label, s.width, bits, s.width / bits);
+        rawBits += (uint64_t) s.width * frames;
+        codedBits += s.codedBits;
+        free(s.samples);
+    }
+    // block headers, and the padding of each block to a byte at worst
+    codedBits += 8ULL * (CODEC_HEADER_BYTES + 1) * blocks;
+    printf("total             %4.1f  %17.2f  %5.2f  (%.2f against the 24-bit BDF records)\n",
+           (double) rawBits / frames / numSignals, (double) codedBits / frames / numSignals,
+           (double) rawBits / codedBits, 24.0 * frames * numSignals / codedBits);
+    double samples = (double) frames * numSignals * repeat;
+    printf("encode            %6.2f ns/sample\n", encodeTime * 1e9 / samples);
+    printf("decode            %6.2f ns/sample\n", decodeTime * 1e9 / samples);
+    printf("%s\n", same ? "lossless" : "DECODED SAMPLES DIFFER");
+    free(data);
+    return same ? 0 : 1;
+}
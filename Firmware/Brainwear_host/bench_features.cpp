@@ -0,0 +1,123 @@
+/**
+ Host benchmark of the band powers of Brainwear_features.h: a synthetic EEG (one sinusoid in each
+ band, a DC offset and noise, a different mix per channel) at FEATURE_RATE_HZ goes through
+ BandPowers as the firmware feeds it, and the levels of every window are compared with the same
+ window transformed in double precision. Prints the largest difference of each band and the time
+ of add() per sample and of compute() per window of all the channels.
+
+ Usage:
+   bench_features [WINDOWS]
+**/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Brainwear_features.h"
+
+#define CHANNELS 4
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @description Level of each band of one window, in hundredths of dB re 1 count^2, as BandPowers
+ *  computes it but with a direct DFT in double precision
+ */
+static void referenceLevels(const int32_t *window, double *levels)
+{
+    double mean = 0;
+    for (int n = 0; n < FEATURE_FFT_SIZE; n++) mean += window[n];
+    mean /= FEATURE_FFT_SIZE;
+    double x[FEATURE_FFT_SIZE];
+    for (int n = 0; n < FEATURE_FFT_SIZE; n++) {
+        x[n] = (window[n] - mean) * 0.5 * (1 - cos(2 * M_PI * n / FEATURE_FFT_SIZE));
+    }
+    for (int band = 0; band < FEATURE_BANDS; band++) {
+        double power = 0;
+        for (int k = featureBandBins[band][0]; k <= featureBandBins[band][1]; k++) {
+            double re = 0, im = 0;
+            for (int n = 0; n < FEATURE_FFT_SIZE; n++) {
+                re += x[n] * cos(2 * M_PI * k * n / FEATURE_FFT_SIZE);
+                im -= x[n] * sin(2 * M_PI * k * n / FEATURE_FFT_SIZE);
+            }
+            power += (re * re + im * im) / FEATURE_FFT_SIZE / FEATURE_FFT_SIZE;
+        }
+        levels[band] = 1000 * log10(power * 2 / 0.375);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long windows = argc > 1 ? atol(argv[1]) : 400;
+    if (windows <= 0) {
+        fprintf(stderr, "usage: %s [WINDOWS]\n", argv[0]);
+        return 2;
+    }
+    static BandPowers<CHANNELS> stage;
+    stage.begin(FEATURE_RATE_HZ);
+
+    // 1 count is 0.022 uV at gain 24: tens of uV are a few thousand counts
+    static const double bandHz[FEATURE_BANDS] = {2.3, 6.1, 10.2, 21.7, 38.4};
+    uint32_t seed = 1;
+    long samples = 0;
+    int32_t history[CHANNELS][FEATURE_FFT_SIZE];
+    double worst[FEATURE_BANDS] = {0};
+    double addTime = 0, computeTime = 0;
+    long computed = 0;
+    while (computed < windows) {
+        int32_t values[CHANNELS];
+        double t = (double) samples / FEATURE_RATE_HZ;
+        for (int c = 0; c < CHANNELS; c++) {
+            double x = 150000 + 1000 * c;
+            for (int band = 0; band < FEATURE_BANDS; band++) {
+                double amplitude = 4000.0 * (1 + ((band + c) % FEATURE_BANDS)) / (1 + band);
+                x += amplitude * sin(2 * M_PI * bandHz[band] * (1 + 0.01 * c) * t + c);
+            }
+            seed = seed * 1664525 + 1013904223;
+            x += ((int32_t) (seed >> 16) % 2000) - 1000;
+            values[c] = (int32_t) lrint(x);
+            history[c][samples % FEATURE_FFT_SIZE] = values[c];
+        }
+        samples++;
+        double start = seconds();
+        bool due = stage.add(values);
+        addTime += seconds() - start;
+        if (!due) continue;
+
+        start = seconds();
+        stage.compute((1 << CHANNELS) - 1);
+        computeTime += seconds() - start;
+        computed++;
+        for (int c = 0; c < CHANNELS; c++) {
+            int32_t window[FEATURE_FFT_SIZE];
+            for (int n = 0; n < FEATURE_FFT_SIZE; n++) window[n] = history[c][(samples + n) % FEATURE_FFT_SIZE];
+            double levels[FEATURE_BANDS];
+            referenceLevels(window, levels);
+            for (int band = 0; band < FEATURE_BANDS; band++) {
+                double error = fabs(stage.levels[c][band] - levels[band]);
+                if (error > worst[band]) worst[band] = error;
+            }
+        }
+    }
+
+    printf("%ld windows of %d samples, %d channels\n", computed, FEATURE_FFT_SIZE, CHANNELS);
+    static const char *const names[FEATURE_BANDS] = {"delta", "theta", "alpha", "beta", "gamma"};
+    for (int band = 0; band < FEATURE_BANDS; band++) {
+        printf("%-6s %2u-%2u Hz  largest error %.3f dB\n", names[band],
+               (unsigned) lrint(featureBandBins[band][0] * (double) FEATURE_RATE_HZ / FEATURE_FFT_SIZE),
+               (unsigned) lrint((featureBandBins[band][1] + 1) * (double) FEATURE_RATE_HZ / FEATURE_FFT_SIZE),
+               worst[band] / 100);
+    }
+    printf("add       %7.1f ns/sample\n", addTime * 1e9 / samples);
+    printf("compute   %7.1f us/window\n", computeTime * 1e6 / computed);
+    double worstAll = 0;
+    for (int band = 0; band < FEATURE_BANDS; band++) if (worst[band] > worstAll) worstAll = worst[band];
+    return worstAll < 10 ? 0 : 1;  // within 0.1 dB
+}
@@ -0,0 +1,156 @@
+/**
+ Host benchmark of the frame decoding of updateBoardData: the loops of the firmware before
+ ADSFrame (bytes shifted into an int, bitRead of bit 23 and a branch to extend the sign) against
+ ADSFrame specialised for the 4 channel board and for an 8 channel ADS1299.
+
+ Usage:
+   bench_frame [FRAMES]
+**/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Brainwear_frame.h"
+
+#define ADS_BYTES_PER_ADS_SAMPLE 24
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+static const int FRAME_POOL = 4096;    // frames cycled through, they stay in the cache
+
+/**
+ * @description The decoding of updateBoardData before ADSFrame, with its oversized arrays
+ */
+template <int Channels>
+struct LegacyDecoder {
+    int boardStat;
+    uint8_t boardChannelDataRaw[ADS_BYTES_PER_ADS_SAMPLE];
+    int boardChannelDataInt[ADS_BYTES_PER_ADS_SAMPLE];
+    uint8_t serialChannelDataRaw[ADS_BYTES_PER_ADS_SAMPLE];
+
+    void decode(const uint8_t *frame)
+    {
+        int byteCounter = 0;
+        int n = 0;
+        for (int i = 0; i < 3; i++) {
+            boardStat = (boardStat << 8) | frame[n++];
+        }
+        for (int i = 0; i < Channels; i++) {
+            for (int j = 0; j < 3; j++) {
+                uint8_t inByte = frame[n++];
+                boardChannelDataRaw[byteCounter] = inByte;
+                byteCounter++;
+                boardChannelDataInt[i] = (boardChannelDataInt[i] << 8) | inByte;
+            }
+        }
+        for (int i = 0; i < Channels; i++) {
+            if (bitRead(boardChannelDataInt[i], 23) == 1) {
+                boardChannelDataInt[i] |= 0xFF000000;
+            } else {
+                boardChannelDataInt[i] &= 0x00FFFFFF;
+            }
+        }
+    }
+
+    void pack(void)
+    {
+        int byteCounter = 0;
+        for (int i = 0; i < Channels; i++) {
+            for (int b = 2; b >= 0; b--) {
+                serialChannelDataRaw[byteCounter] = (boardChannelDataInt[i] >> (b * 8)) & 0xFF;
+                byteCounter++;
+            }
+        }
+    }
+};
+
+/**
+ * @description The decoding of updateBoardData with ADSFrame
+ */
+template <int Channels>
+struct FrameDecoder {
+    typedef ADSFrame<Channels, 3> Frame;
+    uint32_t boardStat;
+    uint8_t boardChannelDataRaw[Frame::DATA_BYTES];
+    int32_t boardChannelDataInt[Frame::CHANNELS];
+    uint8_t serialChannelDataRaw[Frame::DATA_BYTES];
+
+    void decode(const uint8_t *frame)
+    {
+        Frame::decode(frame, &boardStat, boardChannelDataInt);
+        memcpy(boardChannelDataRaw, frame + Frame::STATUS_BYTES, Frame::DATA_BYTES);
+    }
+
+    void pack(void)
+    {
+        Frame::pack(boardChannelDataInt, serialChannelDataRaw);
+    }
+};
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+template <typename Decoder>
+static double run(Decoder &decoder, const uint8_t *frames, int frameBytes, long count, int32_t *checksum)
+{
+    int32_t sum = 0;
+    double start = seconds();
+    for (long i = 0; i < count; i++) {
+        decoder.decode(frames + (i % FRAME_POOL) * frameBytes);
+        decoder.pack();
+        sum += decoder.boardChannelDataInt[i & 3] + decoder.serialChannelDataRaw[i & 7];
+    }
+    double elapsed = seconds() - start;
+    *checksum = sum;
+    return elapsed * 1e9 / count;
+}
+
+template <int Channels>
+static bool bench(long count)
+{
+    const int frameBytes = 3 + 3 * Channels;
+    uint8_t *frames = (uint8_t *) malloc(FRAME_POOL * frameBytes);
+    srand(Channels);
+    for (int i = 0; i < FRAME_POOL * frameBytes; i++) frames[i] = rand();
+
+    static LegacyDecoder<Channels> legacy;
+    static FrameDecoder<Channels> frame;
+    bool same = true;
+    for (int i = 0; i < FRAME_POOL; i++) { // both decode to the same values and bytes
+        legacy.decode(frames + i * frameBytes);
+        legacy.pack();
+        frame.decode(frames + i * frameBytes);
+        frame.pack();
+        if (memcmp(legacy.boardChannelDataInt, frame.boardChannelDataInt, Channels * sizeof(int32_t)) != 0 ||
+            memcmp(legacy.serialChannelDataRaw, frame.serialChannelDataRaw, Channels * 3) != 0 ||
+            memcmp(legacy.boardChannelDataRaw, frame.boardChannelDataRaw, Channels * 3) != 0) {
+            same = false;
+        }
+    }
+
+    int32_t legacySum, frameSum;
+    double legacyNs = run(legacy, frames, frameBytes, count, &legacySum);
+    double frameNs = run(frame, frames, frameBytes, count, &frameSum);
+    printf("%d channels  loops %6.2f ns/frame  ADSFrame %6.2f ns/frame  %.2fx  %s\n", Channels, legacyNs, frameNs,
+           legacyNs / frameNs, same && legacySum == frameSum ? "same output" : "OUTPUT DIFFERS");
+    free(frames);
+    return same && legacySum == frameSum;
+}
+
+int main(int argc, char **argv)
+{
+    long count = argc > 1 ? atol(argv[1]) : 20000000;
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [FRAMES]\n", argv[0]);
+        return 2;
+    }
+    bool ok = bench<4>(count);
+    ok = bench<8>(count) && ok;
+    return ok ? 0 : 1;
+}
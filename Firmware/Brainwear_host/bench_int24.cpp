@@ -0,0 +1,123 @@
+/**
+ Host benchmark of the 24-bit to 32-bit conversion kernels of Brainwear_int24.h on blocks of
+ frames, against the conversion of updateBoardData before them (bytes shifted into an int,
+ bitRead of bit 23 and a branch to extend the sign).
+
+ Usage:
+   bench_int24 [BLOCKS]
+**/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "Brainwear_int24.h"
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+
+static const int CHANNELS = 8;
+static const int FRAME_BYTES = 3 + 3 * CHANNELS;
+static const int FRAMES = 256;     // frames per block
+
+static uint8_t frames[FRAMES * FRAME_BYTES];
+static int32_t reference[CHANNELS * FRAMES];   // channel major
+static int32_t output[CHANNELS * FRAMES];
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**
+ * @description Conversion of updateBoardData before the kernels, one sample at a time
+ */
+static void legacyBlock(int32_t *dst)
+{
+    for (int f = 0; f < FRAMES; f++) {
+        const uint8_t *p = frames + f * FRAME_BYTES + 3;
+        for (int c = 0; c < CHANNELS; c++) {
+            int value = 0;
+            for (int j = 0; j < 3; j++) value = (value << 8) | *p++;
+            if (bitRead(value, 23) == 1) {
+                value |= 0xFF000000;
+            } else {
+                value &= 0x00FFFFFF;
+            }
+            dst[c * FRAMES + f] = value;
+        }
+    }
+}
+
+/**
+ * @description One frame at a time with the contiguous kernel, then transposed
+ */
+static void frameBlock(int32_t *dst)
+{
+    int32_t values[CHANNELS];
+    for (int f = 0; f < FRAMES; f++) {
+        int24BEToInt32(frames + f * FRAME_BYTES + 3, values, CHANNELS);
+        for (int c = 0; c < CHANNELS; c++) dst[c * FRAMES + f] = values[c];
+    }
+}
+
+static void blockKernel(int32_t *dst)
+{
+    int24FramesToInt32(frames, FRAME_BYTES, 3, FRAMES, CHANNELS, dst, FRAMES);
+}
+
+static double run(void (*convert)(int32_t *), long blocks, bool *same)
+{
+    memset(output, 0, sizeof(output));
+    double start = seconds();
+    for (long i = 0; i < blocks; i++) {
+        convert(output);
+        __asm__ __volatile__("" : : "r"(output) : "memory"); // keep every block
+    }
+    double elapsed = seconds() - start;
+    *same = memcmp(output, reference, sizeof(output)) == 0;
+    return elapsed * 1e9 / ((double) blocks * FRAMES * CHANNELS);
+}
+
+int main(int argc, char **argv)
+{
+    long blocks = argc > 1 ? atol(argv[1]) : 20000;
+    if (blocks <= 0) {
+        fprintf(stderr, "usage: %s [BLOCKS]\n", argv[0]);
+        return 2;
+    }
+    srand(1);
+    for (size_t i = 0; i < sizeof(frames); i++) frames[i] = rand();
+    legacyBlock(reference);
+
+    bool ok = true;
+    bool same;
+    double legacyNs = run(legacyBlock, blocks, &same);
+    printf("%d frames of %d channels\n", FRAMES, CHANNELS);
+    printf("bitRead and branch    %6.3f ns/sample\n", legacyNs);
+    double ns = run(frameBlock, blocks, &same);
+    printf("int24BEToInt32        %6.3f ns/sample  %.2fx  %s\n", ns, legacyNs / ns, same ? "same output" : "OUTPUT DIFFERS");
+    ok = ok && same;
+    ns = run(blockKernel, blocks, &same);
+    printf("int24FramesToInt32    %6.3f ns/sample  %.2fx  %s\n", ns, legacyNs / ns, same ? "same output" : "OUTPUT DIFFERS");
+    ok = ok && same;
+
+    // little endian kernel, as used on BDF records
+    uint8_t le[3 * 16];
+    int32_t a[16], b[16];
+    for (int i = 0; i < 16; i++) {
+        int32_t v = (int32_t) ((uint32_t) rand() << 8) >> 8;
+        le[3 * i] = v;
+        le[3 * i + 1] = v >> 8;
+        le[3 * i + 2] = v >> 16;
+        a[i] = v;
+    }
+    int24LEToInt32(le, b, 15);
+    b[15] = int24LE(le + 45);
+    same = memcmp(a, b, sizeof(a)) == 0;
+    printf("int24LEToInt32        %s\n", same ? "same output" : "OUTPUT DIFFERS");
+    return ok && same ? 0 : 1;
+}
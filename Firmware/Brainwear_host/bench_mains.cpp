@@ -0,0 +1,124 @@
+/**
+ Host benchmark of the mains canceller of Brainwear_mains.h: synthetic EEG and MMG channels (the
+ signal, noise and the mains with its harmonics, each channel with its own amplitudes and phases)
+ go through MainsCanceller as the firmware feeds it. The mains wanders around its nominal frequency
+ and its amplitude drops by a third of the way. Over the last half of each run the interference left in the
+ output (the output minus the signal and noise put in) is compared with the interference put in;
+ without mains, the change of the output is compared with the signal. Prints the suppression, the
+ frequency the loop ended on and the time of apply() per sample of all the channels.
+
+ Usage:
+   bench_mains [SECONDS]
+**/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "Brainwear_mains.h"
+
+#define CHANNELS 4
+
+static double seconds(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+typedef struct {
+    const char *name;
+    uint16_t sampleRateHz;
+    uint16_t mainsHz;
+    double offset;      // Hz, from mainsHz to the mains
+    double drift;       // Hz, the mains wanders by this much around it, over a minute
+    double mains;       // counts, amplitude of the fundamental, the harmonics are smaller
+    double signal;      // counts, amplitude of the signal
+    double noise;       // counts, peak of the uniform noise
+    bool eeg;           // int32_t samples up to 24 bits, int16_t otherwise
+} Scenario;
+
+/**
+ * @description Runs one scenario for duration seconds
+ * @returns the suppression of the interference in dB, without mains how far below the signal
+ *  its change is
+ */
+template <typename Sample>
+static double run(const Scenario &scenario, double duration, int32_t largest)
+{
+    MainsCanceller<CHANNELS> canceller(largest);
+    canceller.configure(scenario.mainsHz, scenario.sampleRateHz);
+
+    long samples = (long) (duration * scenario.sampleRateHz);
+    uint32_t seed = 1;
+    double phase = 0;
+    double interference = 0, residual = 0, power = 0, time = 0;
+    for (long n = 0; n < samples; n++) {
+        double t = (double) n / scenario.sampleRateHz;
+        double f = scenario.mainsHz + scenario.offset + scenario.drift * sin(2 * M_PI * t / 60);
+        phase += 2 * M_PI * f / scenario.sampleRateHz;
+        double amplitude = scenario.mains * (n < samples / 3 ? 1 : 0.6);
+        Sample values[CHANNELS];
+        double clean[CHANNELS], lines[CHANNELS], offset[CHANNELS];
+        for (int c = 0; c < CHANNELS; c++) {
+            offset[c] = scenario.eeg ? 1000 * c : 1000 + 100 * c;
+            clean[c] = offset[c] + scenario.signal * sin(2 * M_PI * (10.3 + 3.1 * c) * t + c)
+                       + 0.5 * scenario.signal * sin(2 * M_PI * (23.9 + 1.7 * c) * t);
+            seed = seed * 1664525 + 1013904223;
+            clean[c] += scenario.noise * ((double) (seed >> 8) / (1 << 23) - 1);
+            lines[c] = 0;
+            for (int h = 1; h <= MAINS_HARMONICS; h++) {
+                if (2 * h * scenario.mainsHz >= scenario.sampleRateHz) break;
+                lines[c] += amplitude * (1.0 + 0.2 * c) / (h * h) * sin(h * phase + 0.7 * c * h);
+            }
+            values[c] = (Sample) lrint(clean[c] + lines[c]);
+            clean[c] = values[c] - lines[c];    // the rounding belongs to the signal
+        }
+        double start = seconds();
+        canceller.apply(values, (1 << CHANNELS) - 1);
+        time += seconds() - start;
+        if (n < samples / 2) continue;
+        for (int c = 0; c < CHANNELS; c++) {
+            interference += lines[c] * lines[c];
+            power += (clean[c] - offset[c]) * (clean[c] - offset[c]);
+            residual += (values[c] - clean[c]) * (values[c] - clean[c]);
+        }
+    }
+    double suppression = 10 * log10((interference > 0 ? interference : power) / residual);
+    printf("%-20s %5u Hz  %u lines  %s %5.1f dB  loop at %6.2f Hz  apply %6.1f ns/sample\n",
+           scenario.name, scenario.sampleRateHz, canceller.harmonics,
+           interference > 0 ? "suppression     " : "below the signal", suppression,
+           canceller.trackedFrequency(), time * 1e9 / samples);
+    return suppression;
+}
+
+int main(int argc, char **argv)
+{
+    double duration = argc > 1 ? atof(argv[1]) : 60;
+    if (duration <= 0) {
+        fprintf(stderr, "usage: %s [SECONDS]\n", argv[0]);
+        return 2;
+    }
+    // 1 count of the EEG is 0.022 uV at gain 24, of the piezo 0.125 mV
+    static const Scenario scenarios[] = {
+        {"EEG 50 Hz",            250, 50, 0.0, 0.0, 20000, 2000, 500, true},
+        {"EEG 50.4 Hz",          250, 50, 0.4, 0.0, 20000, 2000, 500, true},
+        {"EEG 50 Hz drifting",   250, 50, 0.0, 0.2, 20000, 2000, 500, true},
+        {"EEG 60 Hz drifting",  1000, 60, 0.0, 0.2, 20000, 2000, 500, true},
+        {"EEG 50 Hz drifting", 16000, 50, 0.0, 0.2, 20000, 2000, 500, true},
+        {"EEG no mains",         250, 50, 0.0, 0.0,     0, 2000, 500, true},
+        {"MMG 50 Hz",            250, 50, 0.0, 0.0,   200,  300,   3, false},
+        {"MMG 50 Hz drifting",   250, 50, 0.0, 0.2,   200,  300,   3, false},
+        {"MMG 60 Hz drifting",   250, 60, 0.0, 0.2,   200,  300,   3, false},
+    };
+    printf("%d channels, %.0f s, suppression over the last half\n", CHANNELS, duration);
+    double worst = 1000;
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        double suppression = scenarios[s].eeg ? run<int32_t>(scenarios[s], duration, 8388607L)
+                                              : run<int16_t>(scenarios[s], duration, INT16_MAX);
+        if (suppression < worst) worst = suppression;
+    }
+    return worst >= 20 ? 0 : 1;    // the interference down by 20 dB at least
+}
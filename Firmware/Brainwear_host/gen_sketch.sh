@@ -0,0 +1,21 @@
+#!/bin/sh
+# Builds one C++ file from the .ino files of the sketch, as the Arduino IDE does: the main .ino
+# first, then the others, with a prototype of every function before the first definition.
+# Usage: gen_sketch.sh MAIN.ino OTHER.ino... > sketch.cpp
+
+RAW=$(mktemp)
+trap 'rm -f "$RAW"' EXIT
+for f in "$@"; do
+    cat "$f"
+    echo
+done > "$RAW"
+
+# a function definition starts at column 0: return type, name, parameters and maybe the brace
+DEF='^[A-Za-z_][A-Za-z0-9_<>*& ]*[ *&]+[A-Za-z_][A-Za-z0-9_]*\([^;]*\)[ \t]*\{?[ \t]*$'
+SKIP='^(typedef|struct|class|enum|if|else|return|static const|const )'
+
+first=$(grep -nE "$DEF" "$RAW" | grep -vE "^[0-9]+:$SKIP" | head -n 1 | cut -d: -f1)
+echo '#include <Arduino.h>'
+head -n $((first - 1)) "$RAW"
+awk -v def="$DEF" -v skip="$SKIP" '$0 ~ def && $0 !~ skip { sub(/[ \t]*\{?[ \t]*$/, ""); print $0 ";" }' "$RAW"
+tail -n +"$first" "$RAW"
@@ -0,0 +1,162 @@
+/**
+ Host build of the Brainwear firmware. Runs the setup() and loop() of Brainwear_test against
+ simulated devices, on a virtual clock.
+
+ Usage:
+   brainwear_host [options]
+     -t SECONDS      virtual time to run (default 10)
+     -c MS:TEXT      send TEXT to the serial port at MS milliseconds, can be repeated
+     -o FILE         write the bytes sent by the firmware to FILE
+     -e FILE         EEPROM contents, loaded at start and saved at the end
+     -d DIR          copy the files of the SD card to DIR at the end
+     -n              run without SD card
+     -b              MMG inputs in bursts, as contractions, instead of continuous sines
+     -m COUNTS       50 Hz mains bleeding into the piezo inputs, amplitude in counts of the ADS1015
+
+ Example, record 1 minute of data on the SD card while streaming:
+   brainwear_host -t 70 -c 100:A -c 500:b -c 65000:s -c 65100:j -o serial.bin -d sd
+**/
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "mySD.h"
+#include "host_sim.h"
+#include "sim_ads1015.h"
+#include "sim_ads1299.h"
+#include "Brainwear_definitions.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <time.h>
+
+void setup(void);
+void loop(void);
+
+static FILE *serialOut = NULL;
+
+static void writeSerial(uint8_t c)
+{
+    fputc(c, serialOut);
+}
+
+/**
+ * @description The firmware stopped with abort() (a full arena): keeps what it sent until then
+ */
+static void firmwareAborted(int)
+{
+    if (serialOut != NULL) fflush(serialOut);
+    fprintf(stderr, "firmware aborted at %.3f s\n", (double) hostNow() / HOST_NS_PER_S);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t SECONDS] [-c MS:TEXT]... [-o FILE] [-e FILE] [-d DIR] [-n] [-b] [-m COUNTS]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 10;
+    const char *eepromFile = NULL;
+    const char *sdDir = NULL;
+    bool bursts = false;
+    double mains = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "-n") == 0) {
+            hostSDInsert(false);
+            continue;
+        }
+        if (strcmp(arg, "-b") == 0) {
+            bursts = true;
+            continue;
+        }
+        if (value == NULL || arg[0] != '-' || strlen(arg) != 2) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+        switch (arg[1]) {
+            case 't':
+                seconds = atof(value);
+                break;
+            case 'c': {
+                char *text;
+                double ms = strtod(value, &text);
+                if (*text != ':') {
+                    usage(argv[0]);
+                    return 2;
+                }
+                hostSerialInput((uint64_t) (ms * HOST_NS_PER_MS), text + 1);
+                break;
+            }
+            case 'o':
+                serialOut = fopen(value, "wb");
+                if (serialOut == NULL) {
+                    perror(value);
+                    return 1;
+                }
+                hostSerialOutput(writeSerial);
+                break;
+            case 'e':
+                eepromFile = value;
+                EEPROM.load(eepromFile);
+                break;
+            case 'd':
+                sdDir = value;
+                break;
+            case 'm':
+                mains = atof(value);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (seconds <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    SimADS1299 ads(CS, DRDY, START_PIN, ADS_CHANNELS_BOARD);
+    SimADS1015 fsr(ADS1x15_1, 1.0);
+    SimADS1015 piezo(ADS1x15_2, 10.0);
+    fsr.bursts = bursts;
+    piezo.bursts = bursts;
+    piezo.mains = mains;
+
+    signal(SIGABRT, firmwareAborted);
+    clock_t wallStart = clock();
+    uint64_t end = (uint64_t) (seconds * HOST_NS_PER_S);
+    setup();
+    uint64_t setupTime = hostNow();
+    while (hostNow() < end) {
+        loop();  // sleeps in the scheduler until the next event
+        hostStats.loops++;
+    }
+    double wall = (double) (clock() - wallStart) / CLOCKS_PER_SEC;
+
+    if (serialOut != NULL) fclose(serialOut);
+    if (eepromFile != NULL && !EEPROM.save(eepromFile)) perror(eepromFile);
+    if (sdDir != NULL && hostSDExport(sdDir) < 0) return 1;
+
+    double simulated = (double) hostNow() / HOST_NS_PER_S;
+    fprintf(stderr, "virtual time   %.3f s in %.3f s (%.0fx)\n", simulated, wall, wall > 0 ? simulated / wall : 0);
+    fprintf(stderr, "setup          %.1f ms\n", (double) setupTime / HOST_NS_PER_MS);
+    fprintf(stderr, "loops          %llu, idle %.3f s\n", (unsigned long long) hostStats.loops,
+            (double) hostStats.idleNs / HOST_NS_PER_S);
+    fprintf(stderr, "DRDY           %llu conversions, %llu interrupts\n", (unsigned long long) ads.conversions,
+            (unsigned long long) hostStats.interrupts);
+    fprintf(stderr, "ADS1299        %llu frames read, %llu missed, %llu torn\n", (unsigned long long) ads.framesRead,
+            (unsigned long long) ads.framesMissed, (unsigned long long) ads.framesTorn);
+    fprintf(stderr, "serial         %llu bytes sent, %llu received, %.3f s waiting for the FIFO\n",
+            (unsigned long long) hostStats.uartTxBytes, (unsigned long long) hostStats.uartRxBytes,
+            (double) hostStats.uartStallNs / HOST_NS_PER_S);
+    fprintf(stderr, "SPI            %llu bytes\n", (unsigned long long) hostStats.spiBytes);
+    fprintf(stderr, "I2C            %llu bytes, %llu + %llu conversions\n", (unsigned long long) hostStats.i2cBytes,
+            (unsigned long long) fsr.conversions, (unsigned long long) piezo.conversions);
+    fprintf(stderr, "SD             %llu blocks, %.3f s writing\n", (unsigned long long) hostStats.sdBlocks,
+            (double) hostStats.sdWriteNs / HOST_NS_PER_S);
+    return 0;
+}
@@ -0,0 +1,158 @@
+//
+// Virtual time, pins and buses of the host build
+//
+
+#include "host_sim.h"
+#include <map>
+#include <vector>
+
+HostStats hostStats;
+
+static uint64_t now = 0;
+static uint64_t eventOrder = 0;   // keeps events of the same time in the order they were scheduled
+static std::map<std::pair<uint64_t, uint64_t>, std::function<void()> > events;
+
+static uint8_t pinLevel[HOST_NUM_PINS];
+static void (*pinIsr[HOST_NUM_PINS])(void);
+static int pinIsrMode[HOST_NUM_PINS];
+static std::vector<std::function<void(uint8_t)> > pinWatchers[HOST_NUM_PINS];
+
+static std::vector<std::pair<uint8_t, HostSPIDevice *> > spiDevices;
+static std::map<uint8_t, HostI2CDevice *> i2cDevices;
+
+// Interrupt modes, as in Arduino.h
+#define HOST_RISING   1
+#define HOST_FALLING  2
+#define HOST_CHANGE   3
+
+/**
+ * @description Current virtual time in ns
+ */
+uint64_t hostNow(void)
+{
+    return now;
+}
+
+/**
+ * @description Moves the time forward, running the events that fall inside
+ */
+void hostAdvance(uint64_t ns)
+{
+    uint64_t target = now + ns;
+    while (!events.empty() && events.begin()->first.first <= target) {
+        std::map<std::pair<uint64_t, uint64_t>, std::function<void()> >::iterator next = events.begin();
+        if (next->first.first > now) now = next->first.first;
+        std::function<void()> event = next->second;
+        events.erase(next);
+        event();
+    }
+    now = target;
+}
+
+/**
+ * @description Jumps to the next event when the firmware has nothing to do, without passing limit
+ * @returns false if there are no events left before limit
+ */
+bool hostIdle(uint64_t limit)
+{
+    uint64_t next = events.empty() ? limit : events.begin()->first.first;
+    if (next > limit) next = limit;
+    uint64_t skipped = next > now ? next - now : 0;
+    hostStats.idleNs += skipped;
+    hostAdvance(skipped);
+    return next < limit;
+}
+
+/**
+ * @description Runs event at the given time. Events in the past run on the next advance
+ */
+void hostSchedule(uint64_t when, std::function<void()> event)
+{
+    events[std::make_pair(when, eventOrder++)] = event;
+}
+
+/**
+ * @description Sets the level of a pin, notifying its watchers and firing its interrupt
+ */
+void hostSetPin(uint8_t pin, uint8_t level)
+{
+    if (pin >= HOST_NUM_PINS) return;
+    uint8_t last = pinLevel[pin];
+    pinLevel[pin] = level ? 1 : 0;
+    if (last == pinLevel[pin]) return;
+    for (size_t i = 0; i < pinWatchers[pin].size(); i++) {
+        pinWatchers[pin][i](pinLevel[pin]);
+    }
+    if (pinIsr[pin] == NULL) return;
+    bool fire = pinIsrMode[pin] == HOST_CHANGE ||
+                (pinIsrMode[pin] == HOST_FALLING && !pinLevel[pin]) ||
+                (pinIsrMode[pin] == HOST_RISING && pinLevel[pin]);
+    if (fire) {
+        hostStats.interrupts++;
+        pinIsr[pin]();
+    }
+}
+
+/**
+ * @description Level of a pin
+ */
+uint8_t hostGetPin(uint8_t pin)
+{
+    return pin < HOST_NUM_PINS ? pinLevel[pin] : 0;
+}
+
+/**
+ * @description Calls watcher every time the level of pin changes
+ */
+void hostWatchPin(uint8_t pin, std::function<void(uint8_t)> watcher)
+{
+    if (pin < HOST_NUM_PINS) pinWatchers[pin].push_back(watcher);
+}
+
+/**
+ * @description attachInterrupt of the host build
+ */
+void hostAttachInterrupt(uint8_t pin, void (*isr)(void), int mode)
+{
+    if (pin >= HOST_NUM_PINS) return;
+    pinIsr[pin] = isr;
+    pinIsrMode[pin] = mode;
+}
+
+/**
+ * @description Connects an SPI device to a chip select pin. Pins idle high
+ */
+void hostAttachSPI(uint8_t csPin, HostSPIDevice *device)
+{
+    spiDevices.push_back(std::make_pair(csPin, device));
+    pinLevel[csPin] = 1;
+    hostWatchPin(csPin, [device](uint8_t level) { device->select(level == 0); });
+}
+
+/**
+ * @description The SPI device whose chip select is low, NULL if none
+ */
+HostSPIDevice *hostSelectedSPI(void)
+{
+    for (size_t i = 0; i < spiDevices.size(); i++) {
+        if (pinLevel[spiDevices[i].first] == 0) return spiDevices[i].second;
+    }
+    return NULL;
+}
+
+/**
+ * @description Connects an I2C device at address
+ */
+void hostAttachI2C(uint8_t address, HostI2CDevice *device)
+{
+    i2cDevices[address] = device;
+}
+
+/**
+ * @description The I2C device at address, NULL if none answers
+ */
+HostI2CDevice *hostI2C(uint8_t address)
+{
+    std::map<uint8_t, HostI2CDevice *>::iterator it = i2cDevices.find(address);
+    return it == i2cDevices.end() ? NULL : it->second;
+}
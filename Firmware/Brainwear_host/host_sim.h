@@ -0,0 +1,69 @@
+//
+// Virtual time, pins and buses of the host build. Time only advances when the firmware waits
+// (delay, bus transfers, UART back-pressure) or when loop() has nothing to do, so runs are
+// deterministic and usually much faster than real time.
+//
+
+#ifndef SOFTWARE_HOST_SIM_H
+#define SOFTWARE_HOST_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+
+#define HOST_NS_PER_US  1000ULL
+#define HOST_NS_PER_MS  1000000ULL
+#define HOST_NS_PER_S   1000000000ULL
+#define HOST_CPU_MHZ    240         // ESP32 core clock, used by ESP.getCycleCount
+#define HOST_NUM_PINS   40
+
+/** Transfers and events seen during the run */
+typedef struct {
+    uint64_t spiBytes;
+    uint64_t i2cBytes;
+    uint64_t uartTxBytes;
+    uint64_t uartRxBytes;
+    uint64_t uartStallNs;   // time the firmware waited for room in the UART FIFO
+    uint64_t sdBlocks;
+    uint64_t sdWriteNs;
+    uint64_t interrupts;
+    uint64_t loops;
+    uint64_t idleNs;        // time skipped while loop() had nothing to do
+} HostStats;
+
+extern HostStats hostStats;
+
+// Time, in ns since the start of the run
+uint64_t hostNow(void);
+void hostAdvance(uint64_t ns);
+bool hostIdle(uint64_t limit);
+void hostSchedule(uint64_t when, std::function<void()> event);
+
+// Pins. Levels written by the firmware or driven by the devices, interrupts fire on the edges
+void hostSetPin(uint8_t pin, uint8_t level);
+uint8_t hostGetPin(uint8_t pin);
+void hostWatchPin(uint8_t pin, std::function<void(uint8_t)> watcher);
+void hostAttachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+
+/** A device on the SPI bus, selected while its chip select pin is low */
+class HostSPIDevice {
+public:
+    virtual ~HostSPIDevice() {}
+    virtual void select(bool selected) { (void) selected; }
+    virtual uint8_t transfer(uint8_t out) = 0;
+};
+
+/** A device on the I2C bus. write gets the bytes of one transaction, read fills a request */
+class HostI2CDevice {
+public:
+    virtual ~HostI2CDevice() {}
+    virtual void write(const uint8_t *data, size_t length) = 0;
+    virtual void read(uint8_t *data, size_t length) = 0;
+};
+
+void hostAttachSPI(uint8_t csPin, HostSPIDevice *device);
+HostSPIDevice *hostSelectedSPI(void);
+void hostAttachI2C(uint8_t address, HostI2CDevice *device);
+HostI2CDevice *hostI2C(uint8_t address);
+
+#endif //SOFTWARE_HOST_SIM_H
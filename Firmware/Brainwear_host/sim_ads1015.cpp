@@ -0,0 +1,96 @@
+//
+// Behavioural model of the ADS1015
+//
+
+#include "sim_ads1015.h"
+#include <math.h>
+
+#define ADS1015_POINTER_CONVERT   0x00
+#define ADS1015_POINTER_CONFIG    0x01
+#define ADS1015_CONFIG_DEFAULT    0x8583
+#define ADS1015_CONFIG_OS         0x8000
+#define ADS1015_CONFIG_MUX_SHIFT  12
+#define ADS1015_CONFIG_MODE       0x0100  // 1 = single-shot
+#define ADS1015_CONFIG_DR_SHIFT   5
+
+static const unsigned int dataRates[8] = {128, 250, 490, 920, 1600, 2400, 3300, 3300};
+
+SimADS1015::SimADS1015(uint8_t address, double frequencyHz)
+{
+    frequency = frequencyHz;
+    pointer = ADS1015_POINTER_CONVERT;
+    config = ADS1015_CONFIG_DEFAULT;
+    result = 0;
+    busyUntil = 0;
+    conversions = 0;
+    bursts = false;
+    mains = 0;
+    seed = address;
+    hostAttachI2C(address, this);
+}
+
+uint64_t SimADS1015::conversionTime(void)
+{
+    return HOST_NS_PER_S / dataRates[(config >> ADS1015_CONFIG_DR_SHIFT) & 0x07];
+}
+
+/**
+ * @description Result of a conversion of the selected input, 12 bits left aligned. Single-ended
+ *  inputs are sines of half the full scale sampled at the end of the conversion, differential inputs read 0.
+ *  With bursts the sines are on for 0.5 s every 2 s, input n from 1 + 0.25 n s, over a noise of 3 counts.
+ *  The mains is added to every input with a phase of its own
+ */
+uint16_t SimADS1015::convert(uint64_t time)
+{
+    conversions++;
+    uint8_t mux = (config >> ADS1015_CONFIG_MUX_SHIFT) & 0x07;
+    if (mux < 4) return 0;
+    double t = (double) time / HOST_NS_PER_S;
+    double amplitude = 1023.0;
+    double noise = 0;
+    if (bursts) {
+        double phase = fmod(t - 0.25 * (mux - 4), 2.0);
+        if (phase < 1.0 || phase >= 1.5) amplitude = 0;
+        seed = seed * 1664525 + 1013904223;
+        noise = (int32_t) (seed >> 16) % 7 - 3;
+    }
+    int16_t value = (int16_t) (amplitude * sin(2 * M_PI * frequency * (mux - 3) * t) + noise +
+                               mains * sin(2 * M_PI * 50 * t + mux));
+    return (uint16_t) (value << 4);
+}
+
+/**
+ * @description One write transaction: the pointer, then optionally the register value
+ */
+void SimADS1015::write(const uint8_t *data, size_t length)
+{
+    if (length == 0) return;
+    pointer = data[0] & 0x03;
+    if (length < 3 || pointer != ADS1015_POINTER_CONFIG) return;
+    config = (data[1] << 8) | data[2];
+    if (!(config & ADS1015_CONFIG_MODE) || (config & ADS1015_CONFIG_OS)) {  // start a conversion
+        busyUntil = hostNow() + conversionTime();
+        config &= ~ADS1015_CONFIG_OS;
+    }
+}
+
+/**
+ * @description Reads the register selected by the pointer, MSB first
+ */
+void SimADS1015::read(uint8_t *data, size_t length)
+{
+    uint16_t value;
+    bool busy = hostNow() < busyUntil;
+    if (!busy && busyUntil != 0) { // the conversion in progress is done
+        result = convert(busyUntil);
+        busyUntil = (config & ADS1015_CONFIG_MODE) ? 0 : hostNow() + conversionTime();
+    }
+    if (pointer == ADS1015_POINTER_CONFIG) {
+        value = busy ? config : (config | ADS1015_CONFIG_OS);
+    } else {
+        value = result;
+    }
+    for (size_t i = 0; i < length; i++) {
+        data[i] = i == 0 ? value >> 8 : (i == 1 ? value & 0xFF : 0xFF);
+    }
+}
@@ -0,0 +1,34 @@
+//
+// Behavioural model of the ADS1015 used for the MMG sensors: pointer, config and conversion
+// registers, single-shot and continuous conversions with the time of each data rate.
+//
+
+#ifndef SOFTWARE_SIM_ADS1015_H
+#define SOFTWARE_SIM_ADS1015_H
+
+#include "host_sim.h"
+
+class SimADS1015 : public HostI2CDevice {
+public:
+    SimADS1015(uint8_t address, double frequencyHz);
+
+    void write(const uint8_t *data, size_t length);
+    void read(uint8_t *data, size_t length);
+
+    uint64_t conversions;
+    bool bursts;          // the inputs are contractions, bursts of the sine with a noise floor
+    double mains;         // counts of the 50 Hz mains added to the inputs
+
+private:
+    uint64_t conversionTime(void);
+    uint16_t convert(uint64_t time);
+
+    double frequency;     // of the input sine, channel n is at (n + 1) * frequency
+    uint8_t pointer;
+    uint16_t config;
+    uint16_t result;
+    uint64_t busyUntil;   // end of the conversion in progress
+    uint32_t seed;        // of the noise
+};
+
+#endif //SOFTWARE_SIM_ADS1015_H
@@ -0,0 +1,382 @@
+//
+// Behavioural model of the ADS1299, see the TI datasheet SBAS499
+//
+
+#include "sim_ads1299.h"
+#include <math.h>
+#include <string.h>
+
+#define ADS1299_FCLK        2048000ULL
+#define ADS1299_TCLK_NS     (HOST_NS_PER_S / ADS1299_FCLK)
+#define ADS1299_VREF        4.5
+#define ADS1299_FULL_SCALE  8388607
+
+// Registers
+#define REG_ID         0x00
+#define REG_CONFIG1    0x01
+#define REG_CONFIG2    0x02
+#define REG_CONFIG3    0x03
+#define REG_LOFF       0x04
+#define REG_CH1SET     0x05
+#define REG_LOFF_SENSP 0x0F
+#define REG_LOFF_SENSN 0x10
+#define REG_LOFF_STATP 0x12
+#define REG_LOFF_STATN 0x13
+#define REG_GPIO       0x14
+
+// Opcodes
+#define OP_WAKEUP   0x02
+#define OP_STANDBY  0x04
+#define OP_RESET    0x06
+#define OP_START    0x08
+#define OP_STOP     0x0A
+#define OP_RDATAC   0x10
+#define OP_SDATAC   0x11
+#define OP_RDATA    0x12
+#define OP_RREG     0x20
+#define OP_WREG     0x40
+
+static const uint8_t defaults[ADS1299_REGISTERS] = {
+    0x00, 0x96, 0xC0, 0x60, 0x00,                   // ID, CONFIG1-3, LOFF
+    0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, 0x61, // CH1SET-CH8SET
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,       // BIAS_SENSP/N, LOFF_SENSP/N, LOFF_FLIP, LOFF_STATP/N
+    0x0F, 0x00, 0x00, 0x00                          // GPIO, MISC1, MISC2, CONFIG4
+};
+
+static const uint8_t gains[8] = {1, 2, 4, 6, 8, 12, 24, 24};
+
+/**
+ * @param channels 4, 6 or 8 for the ADS1299-4, ADS1299-6 and ADS1299
+ */
+SimADS1299::SimADS1299(uint8_t csPin, uint8_t drdy, uint8_t start, uint8_t channels)
+{
+    drdyPin = drdy;
+    startPin = start;
+    numChannels = channels > ADS1299_MAX_CHANNELS ? ADS1299_MAX_CHANNELS : channels;
+    signal.offsetUv = 50;
+    signal.alphaUv = 20;
+    signal.alphaHz = 10;
+    signal.mainsUv = 10;
+    signal.mainsHz = 50;
+    signal.noiseUv = 1;
+    signal.electrodeKohm = 5;
+    conversions = framesRead = framesMissed = framesTorn = 0;
+    rng = 0x2545F491;
+    startCommand = false;
+    running = false;
+    generation = 0;
+    selected = false;
+    reset();
+    hostSetPin(drdyPin, 1);
+    hostAttachSPI(csPin, this);
+    hostWatchPin(startPin, [this](uint8_t) { updateRunning(); });
+}
+
+/**
+ * @description Power on and RESET state: default registers, SDATAC mode, conversions restart
+ */
+void SimADS1299::reset(void)
+{
+    memcpy(reg, defaults, sizeof(reg));
+    reg[REG_ID] = numChannels == 4 ? 0x3C : (numChannels == 6 ? 0x3D : 0x3E);
+    state = IDLE;
+    continuous = false;
+    singleRead = false;
+    standby = false;
+    frameUnread = false;
+    readTorn = false;
+    frameIndex = 0;
+    memset(frame, 0, sizeof(frame));
+    frame[0] = 0xC0;
+    if (running) startConversions();
+}
+
+/**
+ * @description Time between conversions, from the DR bits of CONFIG1
+ */
+uint64_t SimADS1299::dataPeriod(void)
+{
+    uint8_t dr = reg[REG_CONFIG1] & 0x07;
+    if (dr > 6) dr = 6;
+    return HOST_NS_PER_S * (1ULL << dr) / 16000;
+}
+
+/**
+ * @description Conversions run while the START pin is high or after a START command
+ */
+void SimADS1299::updateRunning(void)
+{
+    bool run = (hostGetPin(startPin) || startCommand) && !standby;
+    if (run && !running) {
+        running = true;
+        startConversions();
+    } else if (!run && running) {
+        stopConversions();
+    }
+}
+
+/**
+ * @description (Re)starts the conversions. The first one comes after the settling time of the
+ *  digital filter, 4 data periods plus 4 tCLK
+ */
+void SimADS1299::startConversions(void)
+{
+    uint64_t current = ++generation;
+    hostSchedule(hostNow() + 4 * dataPeriod() + 4 * ADS1299_TCLK_NS, [this, current]() { conversion(current); });
+}
+
+void SimADS1299::stopConversions(void)
+{
+    running = false;
+    generation++;
+    hostSetPin(drdyPin, 1);
+}
+
+/**
+ * @description A new conversion: the frame is updated and DRDY falls. DRDY goes back high
+ *  4 tCLK before the next conversion if the frame is not read
+ */
+void SimADS1299::conversion(uint64_t current)
+{
+    if (current != generation) return; // stopped or restarted since scheduled
+    uint64_t period = dataPeriod();
+    conversions++;
+    if (frameUnread && continuous) framesMissed++;
+    if (selected && frameIndex > 0 && frameIndex < 3 + 3 * numChannels && !readTorn) {
+        framesTorn++;
+        readTorn = true;
+    }
+    lastConversion = hostNow();
+    latchFrame();
+    frameUnread = true;
+    hostSetPin(drdyPin, 0);
+    hostSchedule(hostNow() + period - 4 * ADS1299_TCLK_NS, [this, current]() {
+        if (current == generation) hostSetPin(drdyPin, 1);
+    });
+    hostSchedule(hostNow() + period, [this, current]() { conversion(current); });
+}
+
+/**
+ * @description Builds the frame of the conversion: status word and one 24-bit value per channel
+ */
+void SimADS1299::latchFrame(void)
+{
+    uint32_t status = 0xC00000 | ((uint32_t) reg[REG_LOFF_STATP] << 12) |
+                      ((uint32_t) reg[REG_LOFF_STATN] << 4) | (reg[REG_GPIO] >> 4);
+    frame[0] = status >> 16;
+    frame[1] = status >> 8;
+    frame[2] = status;
+    double t = (double) hostNow() / HOST_NS_PER_S;
+    for (uint8_t ch = 0; ch < numChannels; ch++) {
+        int32_t code = sampleChannel(ch, t);
+        frame[3 + 3 * ch] = (code >> 16) & 0xFF;
+        frame[4 + 3 * ch] = (code >> 8) & 0xFF;
+        frame[5 + 3 * ch] = code & 0xFF;
+    }
+}
+
+/**
+ * @description Converts the input selected by CHnSET to a 24-bit code
+ */
+int32_t SimADS1299::sampleChannel(uint8_t channel, double t)
+{
+    uint8_t set = reg[REG_CH1SET + channel];
+    if (set & 0x80) return 0; // powered down
+    double gain = gains[(set >> 4) & 0x07];
+    double volts;
+    switch (set & 0x07) {
+        case 0: // normal electrode input
+            volts = 1e-6 * ((channel + 1) * signal.offsetUv +
+                            signal.alphaUv * sin(2 * M_PI * signal.alphaHz * t) +
+                            signal.mainsUv * sin(2 * M_PI * signal.mainsHz * t) +
+                            signal.noiseUv * noise()) + leadOffVolts(channel, t);
+            break;
+        case 1: // input shorted, only the noise of the amplifier
+            volts = 1e-6 * 0.2 * noise();
+            break;
+        case 4: // temperature sensor at 25 C
+            volts = 0.1453;
+            break;
+        case 5: { // internal test signal, square wave of fCLK / 2^21 or 2^20, or DC
+            if (!(reg[REG_CONFIG2] & 0x10)) { // external test signal, not connected
+                volts = 0;
+                break;
+            }
+            double amplitude = ((reg[REG_CONFIG2] & 0x04) ? 2.0 : 1.0) * ADS1299_VREF / 2400.0;
+            uint8_t freq = reg[REG_CONFIG2] & 0x03;
+            if (freq == 3) {
+                volts = amplitude;
+            } else {
+                double hz = (double) ADS1299_FCLK / (freq == 0 ? (1 << 21) : (1 << 20));
+                volts = fmod(t * hz, 1.0) < 0.5 ? amplitude : -amplitude;
+            }
+            break;
+        }
+        default: // bias and supply measurements, mid supply
+            volts = 0;
+            break;
+    }
+    double code = volts * gain / ADS1299_VREF * ADS1299_FULL_SCALE;
+    if (code > ADS1299_FULL_SCALE) code = ADS1299_FULL_SCALE;
+    if (code < -ADS1299_FULL_SCALE - 1) code = -ADS1299_FULL_SCALE - 1;
+    return (int32_t) lrint(code);
+}
+
+/**
+ * @description Voltage of the lead-off current across the electrodes of a channel enabled in
+ *  LOFF_SENSP or LOFF_SENSN. The AC current is a square wave, its odd harmonics go through the
+ *  sinc3 filter of the ADC
+ */
+double SimADS1299::leadOffVolts(uint8_t channel, double t)
+{
+    int electrodes = ((reg[REG_LOFF_SENSP] >> channel) & 1) + ((reg[REG_LOFF_SENSN] >> channel) & 1);
+    if (electrodes == 0) return 0;
+    static const double currents[4] = {6e-9, 24e-9, 6e-6, 24e-6};
+    double volts = currents[(reg[REG_LOFF] >> 2) & 0x03] * electrodes * (channel + 1) * signal.electrodeKohm * 1e3;
+    double dataRate = (double) HOST_NS_PER_S / dataPeriod();
+    double hz;
+    switch (reg[REG_LOFF] & 0x03) {
+        case 0: return volts; // DC lead-off
+        case 1: hz = (double) ADS1299_FCLK / (1 << 18); break;
+        case 2: hz = (double) ADS1299_FCLK / (1 << 16); break;
+        default: hz = dataRate / 4; break;
+    }
+    double wave = 0;
+    for (int m = 1; m < 32; m += 2) {
+        double x = M_PI * m * hz / dataRate;
+        wave += 4 / (M_PI * m) * pow(sin(x) / x, 3) * sin(2 * M_PI * m * hz * t);
+    }
+    return volts * wave;
+}
+
+/**
+ * @description Deterministic noise of unit RMS, sum of 12 uniform numbers (xorshift32)
+ */
+double SimADS1299::noise(void)
+{
+    double sum = 0;
+    for (int i = 0; i < 12; i++) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        sum += (double) rng / 4294967296.0;
+    }
+    return sum - 6.0;
+}
+
+/**
+ * @description Chip select. Raising CS resets the serial interface
+ */
+void SimADS1299::select(bool isSelected)
+{
+    selected = isSelected;
+    frameIndex = 0;
+    if (!isSelected) {
+        state = IDLE;
+        singleRead = false;
+    }
+}
+
+/**
+ * @description Executes a one byte command
+ */
+void SimADS1299::command(uint8_t opcode)
+{
+    switch (opcode) {
+        case OP_WAKEUP:
+            standby = false;
+            updateRunning();
+            break;
+        case OP_STANDBY:
+            standby = true;
+            updateRunning();
+            break;
+        case OP_RESET:
+            reset();
+            break;
+        case OP_START:
+            startCommand = true;
+            if (running) startConversions(); // restarts the conversions
+            else updateRunning();
+            break;
+        case OP_STOP:
+            startCommand = false;
+            updateRunning();
+            break;
+        case OP_RDATAC:
+            continuous = true;
+            break;
+        case OP_SDATAC:
+            continuous = false;
+            break;
+        case OP_RDATA:
+            if (!continuous) {
+                singleRead = true;
+                frameIndex = 0;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @description One byte in each direction. In RDATAC mode the frame is shifted out while only
+ *  the commands that stop the continuous mode are decoded, register commands are ignored
+ */
+uint8_t SimADS1299::transfer(uint8_t in)
+{
+    uint8_t out = 0;
+    uint8_t frameSize = 3 + 3 * numChannels;
+
+    if (continuous || singleRead) {
+        if (frameIndex == 0) { // the read starts, DRDY goes back high
+            memcpy(shiftOut, frame, frameSize);
+            readTorn = false;
+            if (frameUnread) framesRead++;
+            frameUnread = false;
+            hostSetPin(drdyPin, 1);
+        }
+        if (frameIndex < frameSize) out = shiftOut[frameIndex++];
+    }
+
+    switch (state) {
+        case IDLE:
+            if ((in & 0xE0) == OP_RREG && !continuous) {
+                regAddress = in & 0x1F;
+                state = RREG_COUNT;
+            } else if ((in & 0xE0) == OP_WREG && !continuous) {
+                regAddress = in & 0x1F;
+                state = WREG_COUNT;
+            } else if (in != 0) {
+                command(in);
+            }
+            break;
+        case RREG_COUNT:
+            regRemaining = (in & 0x1F) + 1;
+            state = RREG_DATA;
+            break;
+        case RREG_DATA:
+            out = regAddress < ADS1299_REGISTERS ? reg[regAddress] : 0;
+            regAddress++;
+            if (--regRemaining == 0) state = IDLE;
+            break;
+        case WREG_COUNT:
+            regRemaining = (in & 0x1F) + 1;
+            state = WREG_DATA;
+            break;
+        case WREG_DATA:
+            if (regAddress < ADS1299_REGISTERS && regAddress != REG_ID &&
+                regAddress != REG_LOFF_STATP && regAddress != REG_LOFF_STATN) {
+                uint8_t lastConfig1 = reg[REG_CONFIG1];
+                reg[regAddress] = in;
+                if (regAddress == REG_CONFIG1 && ((lastConfig1 ^ in) & 0x07) && running) {
+                    startConversions(); // new data rate
+                }
+            }
+            regAddress++;
+            if (--regRemaining == 0) state = IDLE;
+            break;
+    }
+    return out;
+}
@@ -0,0 +1,79 @@
+//
+// Behavioural model of the ADS1299: register map, SPI commands, continuous and single reads,
+// DRDY timing of each data rate and the input multiplexer (normal input, shorted input, test
+// signal, temperature and supplies). Counts the conversions the firmware did not read in time.
+//
+
+#ifndef SOFTWARE_SIM_ADS1299_H
+#define SOFTWARE_SIM_ADS1299_H
+
+#include "host_sim.h"
+
+#define ADS1299_REGISTERS   0x18
+#define ADS1299_MAX_CHANNELS 8
+
+/** Signal at the normal inputs: alpha rhythm, mains interference, white noise and the lead-off current */
+typedef struct {
+    double offsetUv;    // DC offset, channel n gets (n + 1) * offsetUv
+    double alphaUv;     // amplitude of the alpha rhythm
+    double alphaHz;
+    double mainsUv;     // amplitude of the mains interference
+    double mainsHz;
+    double noiseUv;     // RMS of the noise
+    double electrodeKohm; // impedance of each electrode, the electrodes of channel n have (n + 1) * electrodeKohm
+} SimEEGSignal;
+
+class SimADS1299 : public HostSPIDevice {
+public:
+    SimADS1299(uint8_t csPin, uint8_t drdyPin, uint8_t startPin, uint8_t channels);
+
+    void select(bool selected);
+    uint8_t transfer(uint8_t out);
+
+    SimEEGSignal signal;
+    uint64_t conversions;   // DRDY pulses
+    uint64_t framesRead;    // conversions read by the firmware
+    uint64_t framesMissed;  // conversions overwritten before being read, in RDATAC mode
+    uint64_t framesTorn;    // reads still running when the next conversion came
+
+private:
+    void reset(void);
+    void command(uint8_t opcode);
+    void startConversions(void);
+    void stopConversions(void);
+    void updateRunning(void);
+    void conversion(uint64_t generation);
+    void latchFrame(void);
+    int32_t sampleChannel(uint8_t channel, double t);
+    double leadOffVolts(uint8_t channel, double t);
+    double noise(void);
+    uint64_t dataPeriod(void);
+
+    uint8_t drdyPin;
+    uint8_t startPin;
+    uint8_t numChannels;
+    uint8_t reg[ADS1299_REGISTERS];
+
+    // serial interface
+    enum { IDLE, RREG_COUNT, RREG_DATA, WREG_COUNT, WREG_DATA } state;
+    uint8_t regAddress;
+    uint8_t regRemaining;
+    bool selected;
+    bool continuous;        // RDATAC mode
+    bool singleRead;        // RDATA issued, the next bytes are the frame
+    uint8_t frameIndex;     // next byte of the frame to shift out
+
+    // conversions
+    bool startCommand;      // START opcode received, STOP not yet
+    bool standby;
+    bool running;
+    uint64_t generation;    // invalidates the scheduled conversions on stop and reset
+    uint8_t frame[3 + 3 * ADS1299_MAX_CHANNELS];   // last conversion
+    uint8_t shiftOut[3 + 3 * ADS1299_MAX_CHANNELS]; // frame being read
+    bool frameUnread;
+    bool readTorn;          // the read in progress was already counted in framesTorn
+    uint64_t lastConversion;
+    uint32_t rng;
+};
+
+#endif //SOFTWARE_SIM_ADS1299_H
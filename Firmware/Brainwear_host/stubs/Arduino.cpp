@@ -0,0 +1,292 @@
+//
+// Arduino core of the host build
+//
+
+#include "Arduino.h"
+#include "host_sim.h"
+
+#define UART_FIFO_SIZE 128   // bytes the ESP32 UART queues before write() blocks
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static void (*serialSink)(uint8_t) = NULL;
+
+char *itoa(int value, char *buffer, int base)
+{
+    char digits[34];
+    int n = 0;
+    bool negative = value < 0 && base == 10;
+    unsigned int v = negative ? -(unsigned int) value : (unsigned int) value;
+    do {
+        digits[n++] = "0123456789abcdefghijklmnopqrstuvwxyz"[v % base];
+        v /= base;
+    } while (v != 0);
+    int i = 0;
+    if (negative) buffer[i++] = '-';
+    while (n > 0) buffer[i++] = digits[--n];
+    buffer[i] = 0;
+    return buffer;
+}
+
+void delay(uint32_t ms)
+{
+    hostAdvance(ms * HOST_NS_PER_MS);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+    hostAdvance(us * HOST_NS_PER_US);
+}
+
+unsigned long millis(void)
+{
+    return (uint32_t) (hostNow() / HOST_NS_PER_MS);
+}
+
+unsigned long micros(void)
+{
+    return (uint32_t) (hostNow() / HOST_NS_PER_US);
+}
+
+void yield(void)
+{
+}
+
+static uint32_t taskNotifications = 0;
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return (TaskHandle_t) &taskNotifications;
+}
+
+/**
+ * @description Waits for a notification, the time runs through the events until one is given
+ */
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+    uint64_t deadline = ticksToWait == portMAX_DELAY ? UINT64_MAX : hostNow() + ticksToWait * HOST_NS_PER_MS;
+    while (taskNotifications == 0 && hostIdle(deadline)) {
+    }
+    uint32_t count = taskNotifications;
+    if (count > 0) taskNotifications = clearOnExit ? 0 : count - 1;
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void) task;
+    taskNotifications++;
+    return pdTRUE;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    (void) task;
+    taskNotifications++;
+    if (higherPriorityTaskWoken != NULL) *higherPriorityTaskWoken = pdTRUE;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    (void) pin;
+    (void) mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    hostSetPin(pin, level);
+}
+
+int digitalRead(uint8_t pin)
+{
+    return hostGetPin(pin);
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode)
+{
+    hostAttachInterrupt(pin, isr, mode);
+}
+
+void detachInterrupt(uint8_t pin)
+{
+    hostAttachInterrupt(pin, NULL, 0);
+}
+
+uint32_t EspClass::getCycleCount(void)
+{
+    return (uint32_t) (hostNow() * HOST_CPU_MHZ / HOST_NS_PER_US);
+}
+
+uint32_t EspClass::getCpuFreqMHz(void)
+{
+    return HOST_CPU_MHZ;
+}
+
+//////////////////////////////////////////////
+/////////////////// Print ////////////////////
+//////////////////////////////////////////////
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+}
+
+size_t Print::print(long n, int base)
+{
+    if (base == 0) return write((uint8_t) n);
+    if (base == 10 && n < 0) {
+        size_t t = print('-');
+        return t + printNumber((uint32_t) -n, 10);
+    }
+    return printNumber((uint32_t) n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    if (base == 0) return write((uint8_t) n);
+    return printNumber((uint32_t) n, base);
+}
+
+size_t Print::print(double number, int digits)
+{
+    size_t n = 0;
+    if (isnan(number)) return print("nan");
+    if (isinf(number)) return print("inf");
+    if (number < 0.0) {
+        n += print('-');
+        number = -number;
+    }
+    double rounding = 0.5;
+    for (int i = 0; i < digits; i++) rounding /= 10.0;
+    number += rounding;
+    unsigned long whole = (unsigned long) number;
+    double remainder = number - (double) whole;
+    n += print(whole);
+    if (digits > 0) n += print('.');
+    while (digits-- > 0) {
+        remainder *= 10.0;
+        unsigned int digit = (unsigned int) remainder;
+        n += print(digit);
+        remainder -= digit;
+    }
+    return n;
+}
+
+size_t Print::printNumber(uint32_t n, uint8_t base)
+{
+    char buf[33];
+    char *str = &buf[sizeof(buf) - 1];
+    *str = 0;
+    if (base < 2) base = 10;
+    do {
+        char c = n % base;
+        n /= base;
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return write(str);
+}
+
+//////////////////////////////////////////////
+//////////////// HardwareSerial //////////////
+//////////////////////////////////////////////
+
+HardwareSerial::HardwareSerial()
+{
+    byteNs = 10 * HOST_NS_PER_S / 115200;
+    txBusyUntil = 0;
+    rxHead = rxTail = 0;
+    onReceiveCallback = NULL;
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+    byteNs = 10 * HOST_NS_PER_S / baud;  // start + 8 data + stop bits
+}
+
+int HardwareSerial::available(void)
+{
+    return (uint8_t) (rxHead - rxTail);
+}
+
+int HardwareSerial::peek(void)
+{
+    return rxHead == rxTail ? -1 : rx[rxTail];
+}
+
+int HardwareSerial::read(void)
+{
+    return rxHead == rxTail ? -1 : rx[rxTail++];
+}
+
+int HardwareSerial::availableForWrite(void)
+{
+    uint64_t t = hostNow();
+    uint64_t queued = txBusyUntil > t ? (txBusyUntil - t + byteNs - 1) / byteNs : 0;
+    return queued >= UART_FIFO_SIZE ? 0 : UART_FIFO_SIZE - queued;
+}
+
+void HardwareSerial::flush(void)
+{
+    if (txBusyUntil > hostNow()) hostAdvance(txBusyUntil - hostNow());
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    if (availableForWrite() == 0) { // wait until the oldest byte leaves the FIFO
+        uint64_t wait = txBusyUntil - (UART_FIFO_SIZE - 1) * byteNs - hostNow();
+        hostStats.uartStallNs += wait;
+        hostAdvance(wait);
+    }
+    uint64_t t = hostNow();
+    txBusyUntil = (txBusyUntil > t ? txBusyUntil : t) + byteNs;
+    hostStats.uartTxBytes++;
+    if (serialSink != NULL) serialSink(c);
+    return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++) write(buffer[i]);
+    return size;
+}
+
+/**
+ * @description A byte arrives from the host computer
+ */
+void HardwareSerial::receive(uint8_t c)
+{
+    if ((uint8_t) (rxHead + 1) == rxTail) return; // buffer full, the byte is lost
+    rx[rxHead++] = c;
+    hostStats.uartRxBytes++;
+    if (onReceiveCallback != NULL) onReceiveCallback();
+}
+
+/**
+ * @description callback is called for every byte received, like the RX callback of the ESP32 core
+ */
+void HardwareSerial::onReceive(void (*callback)(void))
+{
+    onReceiveCallback = callback;
+}
+
+/**
+ * @description Every byte sent by the firmware is passed to sink
+ */
+void hostSerialOutput(void (*sink)(uint8_t))
+{
+    serialSink = sink;
+}
+
+/**
+ * @description Schedules text to arrive at the serial port, one byte time apart, from time when
+ */
+void hostSerialInput(uint64_t when, const char *text)
+{
+    for (size_t i = 0; text[i] != 0; i++) {
+        uint8_t c = text[i];
+        hostSchedule(when + i * Serial.byteTime(), [c]() { Serial.receive(c); });
+    }
+}
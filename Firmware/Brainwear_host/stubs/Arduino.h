@@ -0,0 +1,148 @@
+//
+// Arduino core of the host build. Time, pins and the UART run on the simulation in host_sim.h
+//
+
+#ifndef SOFTWARE_HOST_ARDUINO_H
+#define SOFTWARE_HOST_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define IRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte_near(address) (*(const uint8_t *) (address))
+
+#define HIGH    1
+#define LOW     0
+#define INPUT   0x01
+#define OUTPUT  0x02
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define LED_BUILTIN 13
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define highByte(w) ((uint8_t) ((w) >> 8))
+#define lowByte(w) ((uint8_t) ((w) & 0xff))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(p) (p)
+
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+char *itoa(int value, char *buffer, int base);
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+unsigned long millis(void);
+unsigned long micros(void);
+void yield(void);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+/** Text output, same formatting as the Arduino Print class of the ESP32 core (32-bit long) */
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *) str, strlen(str)); }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+
+    size_t print(const char str[]) { return write(str); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(unsigned char b, int base = DEC) { return print((unsigned long) b, base); }
+    size_t print(int n, int base = DEC) { return print((long) n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(void) { return write("\r\n"); }
+    template <typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+    template <typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+
+private:
+    size_t printNumber(uint32_t n, uint8_t base);
+};
+
+/**
+ * UART with the timing of the real port: each byte takes 10 bit times and write() blocks while
+ * the transmit FIFO is full. Received bytes come from the script given to hostSerialInput.
+ */
+class HardwareSerial : public Print {
+public:
+    HardwareSerial();
+    void begin(unsigned long baud);
+    int available(void);
+    int peek(void);
+    int read(void);
+    int availableForWrite(void);
+    void flush(void);
+    void onReceive(void (*callback)(void));
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    using Print::write;
+
+    uint64_t byteTime(void) { return byteNs; }
+    void receive(uint8_t c);
+
+private:
+    uint64_t byteNs;      // ns to shift out one byte
+    uint64_t txBusyUntil; // time the last queued byte leaves the port
+    void (*onReceiveCallback)(void);
+    uint8_t rx[256];
+    uint8_t rxHead;
+    uint8_t rxTail;
+};
+
+extern HardwareSerial Serial;
+
+// Where the bytes sent by the firmware go, and the bytes it will receive
+void hostSerialOutput(void (*sink)(uint8_t));
+void hostSerialInput(uint64_t when, const char *text);
+
+class EspClass {
+public:
+    uint32_t getCycleCount(void);
+    uint32_t getCpuFreqMHz(void);
+    uint32_t getFreeHeap(void) { return 300000; }
+    uint32_t getMinFreeHeap(void) { return 300000; }
+};
+
+extern EspClass ESP;
+
+// FreeRTOS, the host has one task (loop) and no stack limit to watch. Waiting for a notification
+// lets the virtual time run until an interrupt or event gives it
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+#define pdFALSE             0
+#define pdTRUE              1
+#define portMAX_DELAY       0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms)   ((TickType_t) (ms))
+#define portYIELD_FROM_ISR() do {} while (0)
+inline uint32_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 8192; }
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+
+#endif //SOFTWARE_HOST_ARDUINO_H
@@ -0,0 +1,57 @@
+//
+// EEPROM of the host build
+//
+
+#include "EEPROM.h"
+#include <stdio.h>
+
+EEPROMClass EEPROM;
+
+EEPROMClass::EEPROMClass()
+{
+    memset(data, 0xFF, sizeof(data));  // erased flash
+    size = 0;
+}
+
+bool EEPROMClass::begin(size_t newSize)
+{
+    if (newSize > EEPROM_MAX_SIZE) return false;
+    size = newSize;
+    return true;
+}
+
+uint8_t EEPROMClass::read(int address)
+{
+    return address >= 0 && (size_t) address < size ? data[address] : 0;
+}
+
+void EEPROMClass::write(int address, uint8_t value)
+{
+    if (address >= 0 && (size_t) address < size) data[address] = value;
+}
+
+bool EEPROMClass::commit(void)
+{
+    return size > 0;
+}
+
+/**
+ * @description Loads the contents saved by a previous run
+ */
+bool EEPROMClass::load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return false;
+    size_t n = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    return n > 0;
+}
+
+bool EEPROMClass::save(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return false;
+    size_t n = fwrite(data, 1, sizeof(data), f);
+    fclose(f);
+    return n == sizeof(data);
+}
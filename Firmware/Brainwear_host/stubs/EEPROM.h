@@ -0,0 +1,30 @@
+//
+// EEPROM of the host build, kept in memory. host_main can load and save it to a file
+//
+
+#ifndef SOFTWARE_HOST_EEPROM_H
+#define SOFTWARE_HOST_EEPROM_H
+
+#include "Arduino.h"
+
+#define EEPROM_MAX_SIZE 4096
+
+class EEPROMClass {
+public:
+    EEPROMClass();
+    bool begin(size_t size);
+    uint8_t read(int address);
+    void write(int address, uint8_t value);
+    bool commit(void);
+
+    bool load(const char *path);
+    bool save(const char *path);
+
+private:
+    uint8_t data[EEPROM_MAX_SIZE];
+    size_t size;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif //SOFTWARE_HOST_EEPROM_H
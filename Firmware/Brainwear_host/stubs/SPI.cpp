@@ -0,0 +1,42 @@
+//
+// SPI of the host build
+//
+
+#include "SPI.h"
+#include "host_sim.h"
+
+SPIClass SPI(VSPI);
+
+SPIClass::SPIClass(uint8_t bus) : bus(bus)
+{
+    setFrequency(1000000);
+}
+
+void SPIClass::begin(int8_t sck, int8_t miso, int8_t mosi, int8_t ss)
+{
+    (void) sck;
+    (void) miso;
+    (void) mosi;
+    (void) ss;
+}
+
+void SPIClass::beginTransaction(SPISettings settings)
+{
+    setFrequency(settings.clock);
+}
+
+void SPIClass::setFrequency(uint32_t frequency)
+{
+    byteNs = 8 * HOST_NS_PER_S / frequency;
+}
+
+/**
+ * @description Exchanges one byte with the selected device. Reads 0xFF when nothing is selected
+ */
+uint8_t SPIClass::transfer(uint8_t data)
+{
+    hostAdvance(byteNs);
+    hostStats.spiBytes++;
+    HostSPIDevice *device = hostSelectedSPI();
+    return device == NULL ? 0xFF : device->transfer(data);
+}
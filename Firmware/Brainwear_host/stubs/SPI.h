@@ -0,0 +1,48 @@
+//
+// SPI of the host build. Transfers go to the device whose chip select is low (hostAttachSPI)
+// and take 8 clock periods of virtual time.
+//
+
+#ifndef SOFTWARE_HOST_SPI_H
+#define SOFTWARE_HOST_SPI_H
+
+#include "Arduino.h"
+
+#define HSPI 2
+#define VSPI 3
+
+#define SPI_MSBFIRST 1
+#define MSBFIRST     1
+#define LSBFIRST     0
+#define SPI_MODE0    0
+#define SPI_MODE1    1
+#define SPI_MODE2    2
+#define SPI_MODE3    3
+
+class SPISettings {
+public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+        : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+    uint32_t clock;
+    uint8_t bitOrder;
+    uint8_t dataMode;
+};
+
+class SPIClass {
+public:
+    SPIClass(uint8_t bus = HSPI);
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1);
+    void end(void) {}
+    void beginTransaction(SPISettings settings);
+    void endTransaction(void) {}
+    void setFrequency(uint32_t frequency);
+    uint8_t transfer(uint8_t data);
+
+private:
+    uint8_t bus;
+    uint64_t byteNs;  // ns to shift one byte
+};
+
+extern SPIClass SPI;
+
+#endif //SOFTWARE_HOST_SPI_H
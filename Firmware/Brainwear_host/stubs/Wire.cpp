@@ -0,0 +1,98 @@
+//
+// I2C of the host build
+//
+
+#include "Wire.h"
+#include "host_sim.h"
+
+TwoWire Wire;
+
+TwoWire::TwoWire()
+{
+    clock = 100000;
+    txAddress = 0;
+    txLength = rxLength = rxIndex = 0;
+}
+
+bool TwoWire::begin(int sda, int scl, uint32_t frequency)
+{
+    (void) sda;
+    (void) scl;
+    if (frequency != 0) clock = frequency;
+    return true;
+}
+
+void TwoWire::setClock(uint32_t frequency)
+{
+    clock = frequency;
+}
+
+/**
+ * @description Bus time of a transaction: start, address byte, data bytes and stop
+ */
+void TwoWire::busTime(size_t bytes)
+{
+    hostAdvance(((bytes + 1) * 9 + 2) * HOST_NS_PER_S / clock);
+    hostStats.i2cBytes += bytes + 1;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    txAddress = address;
+    txLength = 0;
+}
+
+/**
+ * @returns 0 on success, 2 when no device answers the address (as the ESP32 core)
+ */
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+    (void) sendStop;
+    busTime(txLength);
+    HostI2CDevice *device = hostI2C(txAddress);
+    if (device == NULL) return 2;
+    device->write(txBuffer, txLength);
+    return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, bool sendStop)
+{
+    (void) sendStop;
+    if (quantity > WIRE_BUFFER_SIZE) quantity = WIRE_BUFFER_SIZE;
+    rxIndex = rxLength = 0;
+    busTime(quantity);
+    HostI2CDevice *device = hostI2C(address);
+    if (device == NULL) return 0;
+    device->read(rxBuffer, quantity);
+    rxLength = quantity;
+    return quantity;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+    if (txLength >= WIRE_BUFFER_SIZE) return 0;
+    txBuffer[txLength++] = data;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t quantity)
+{
+    size_t n = 0;
+    while (n < quantity && write(data[n])) n++;
+    return n;
+}
+
+int TwoWire::available(void)
+{
+    return rxLength - rxIndex;
+}
+
+int TwoWire::read(void)
+{
+    return rxIndex < rxLength ? rxBuffer[rxIndex++] : -1;
+}
+
+int TwoWire::peek(void)
+{
+    return rxIndex < rxLength ? rxBuffer[rxIndex] : -1;
+}
@@ -0,0 +1,42 @@
+//
+// I2C of the host build. Transactions go to the device at the address (hostAttachI2C) and take
+// 9 clock periods per byte, address included, plus start and stop.
+//
+
+#ifndef SOFTWARE_HOST_WIRE_H
+#define SOFTWARE_HOST_WIRE_H
+
+#include "Arduino.h"
+
+#define WIRE_BUFFER_SIZE 128
+
+class TwoWire {
+public:
+    TwoWire();
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0);
+    void setClock(uint32_t frequency);
+    uint32_t getClock(void) { return clock; }
+    void beginTransmission(uint8_t address);
+    uint8_t endTransmission(bool sendStop = true);
+    uint8_t requestFrom(uint8_t address, uint8_t quantity, bool sendStop = true);
+    size_t write(uint8_t data);
+    size_t write(const uint8_t *data, size_t quantity);
+    int available(void);
+    int read(void);
+    int peek(void);
+
+private:
+    void busTime(size_t bytes);
+
+    uint32_t clock;
+    uint8_t txAddress;
+    uint8_t txBuffer[WIRE_BUFFER_SIZE];
+    size_t txLength;
+    uint8_t rxBuffer[WIRE_BUFFER_SIZE];
+    size_t rxLength;
+    size_t rxIndex;
+};
+
+extern TwoWire Wire;
+
+#endif //SOFTWARE_HOST_WIRE_H
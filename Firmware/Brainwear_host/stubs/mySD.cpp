@@ -0,0 +1,386 @@
+//
+// mySD (SdFat) API of the host build
+//
+
+#include "mySD.h"
+#include "host_sim.h"
+#include <stdio.h>
+#include <strings.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define SD_BLOCK                512
+#define SD_CARD_BLOCKS          (8UL * 1024 * 1024)   // 4 GB card
+#define SD_FIRST_DATA_BLOCK     8192                  // room for the FAT, never written
+#define SD_CLOCK                8000000ULL            // SPI clock of SPI_FULL_SPEED
+#define SD_BLOCK_TRANSFER_NS    ((SD_BLOCK + 3) * 8 * HOST_NS_PER_S / SD_CLOCK)  // token, data and CRC
+#define SD_PROGRAM_NS           (250 * HOST_NS_PER_US)   // card busy after each block of a multi-block write
+#define SD_SINGLE_WRITE_NS      (1500 * HOST_NS_PER_US)  // command, data and busy of writeBlock
+#define SD_STALL_INTERVAL       256                      // blocks between long busy periods (garbage collection)
+#define SD_STALL_NS             (5 * HOST_NS_PER_MS)
+#define SD_FILE_OP_NS           (2 * HOST_NS_PER_MS)     // directory and FAT access of open, create, close
+
+typedef struct {
+    uint8_t data[SD_BLOCK];
+} Block;
+
+typedef struct {
+    std::string name;
+    uint32_t firstBlock;
+    uint32_t blocks;    // allocated
+    uint32_t size;      // bytes
+    bool contiguous;
+} Entry;
+
+static bool cardInserted = true;
+static std::map<uint32_t, Block> cardBlocks;   // blocks never written read as zero
+static std::vector<Entry> directory;
+static uint32_t nextFreeBlock = SD_FIRST_DATA_BLOCK;
+static uint32_t writeBlockNumber;              // next block of the multi-block write
+static uint32_t blocksWritten;                 // for the periodic busy periods
+static uint8_t volumeCache[SD_BLOCK];
+
+/**
+ * @description Copies a block of the card, zeros if it was never written
+ */
+static void getBlock(uint32_t block, uint8_t *dst)
+{
+    std::map<uint32_t, Block>::iterator it = cardBlocks.find(block);
+    if (it == cardBlocks.end()) memset(dst, 0, SD_BLOCK);
+    else memcpy(dst, it->second.data, SD_BLOCK);
+}
+
+static void putBlock(uint32_t block, const uint8_t *src)
+{
+    memcpy(cardBlocks[block].data, src, SD_BLOCK);
+}
+
+/**
+ * @description Time of one block of a multi-block write, with a long busy period from time to time
+ */
+static void writeTime(uint64_t ns)
+{
+    blocksWritten++;
+    if (blocksWritten % SD_STALL_INTERVAL == 0) ns += SD_STALL_NS;
+    hostStats.sdBlocks++;
+    hostStats.sdWriteNs += ns;
+    hostAdvance(ns);
+}
+
+static int findEntry(const char *name)
+{
+    for (size_t i = 0; i < directory.size(); i++) {
+        if (!directory[i].name.empty() && strcasecmp(directory[i].name.c_str(), name) == 0) return i;
+    }
+    return -1;
+}
+
+static int addEntry(const char *name, uint32_t blocks, uint32_t size, bool contiguous)
+{
+    if (nextFreeBlock + blocks > SD_CARD_BLOCKS) return -1;
+    Entry e;
+    e.name = name;
+    e.firstBlock = nextFreeBlock;
+    e.blocks = blocks;
+    e.size = size;
+    e.contiguous = contiguous;
+    nextFreeBlock += blocks;
+    directory.push_back(e);
+    return directory.size() - 1;
+}
+
+//////////////////////////////////////////////
+//////////////////// Sd2Card /////////////////
+//////////////////////////////////////////////
+
+uint8_t Sd2Card::init(uint8_t sckRateID, int8_t chipSelectPin, int8_t mosiPin, int8_t misoPin, int8_t clockPin)
+{
+    (void) sckRateID;
+    (void) chipSelectPin;
+    (void) mosiPin;
+    (void) misoPin;
+    (void) clockPin;
+    hostAdvance(SD_FILE_OP_NS);
+    return cardInserted;
+}
+
+uint32_t Sd2Card::cardSize(void)
+{
+    return SD_CARD_BLOCKS;
+}
+
+uint8_t Sd2Card::erase(uint32_t firstBlock, uint32_t lastBlock)
+{
+    if (!cardInserted || lastBlock < firstBlock || lastBlock >= SD_CARD_BLOCKS) return 0;
+    cardBlocks.erase(cardBlocks.lower_bound(firstBlock), cardBlocks.upper_bound(lastBlock));
+    hostAdvance(SD_FILE_OP_NS);
+    return 1;
+}
+
+uint8_t Sd2Card::readBlock(uint32_t block, uint8_t *dst)
+{
+    if (!cardInserted || block >= SD_CARD_BLOCKS) return 0;
+    hostAdvance(SD_BLOCK_TRANSFER_NS);
+    getBlock(block, dst);
+    return 1;
+}
+
+uint8_t Sd2Card::writeBlock(uint32_t block, const uint8_t *src)
+{
+    if (!cardInserted || block >= SD_CARD_BLOCKS) return 0;
+    putBlock(block, src);
+    writeTime(SD_SINGLE_WRITE_NS);
+    return 1;
+}
+
+uint8_t Sd2Card::writeStart(uint32_t block, uint32_t eraseCount)
+{
+    if (!cardInserted || block + eraseCount > SD_CARD_BLOCKS) return 0;
+    writeBlockNumber = block;
+    return 1;
+}
+
+uint8_t Sd2Card::writeData(const uint8_t *src)
+{
+    if (!cardInserted || writeBlockNumber >= SD_CARD_BLOCKS) return 0;
+    putBlock(writeBlockNumber++, src);
+    writeTime(SD_BLOCK_TRANSFER_NS + SD_PROGRAM_NS);
+    return 1;
+}
+
+uint8_t Sd2Card::writeStop(void)
+{
+    hostAdvance(SD_PROGRAM_NS);
+    return cardInserted;
+}
+
+//////////////////////////////////////////////
+//////////////////// SdVolume ////////////////
+//////////////////////////////////////////////
+
+uint8_t SdVolume::init(Sd2Card &card)
+{
+    (void) card;
+    return cardInserted;
+}
+
+uint8_t *SdVolume::cacheClear(void)
+{
+    return volumeCache;
+}
+
+//////////////////////////////////////////////
+///////////////////// SdFile /////////////////
+//////////////////////////////////////////////
+
+SdFile::SdFile()
+{
+    entry = -1;
+    isRoot = false;
+    position = 0;
+}
+
+uint8_t SdFile::openRoot(SdVolume &volume)
+{
+    (void) volume;
+    if (isOpen() || !cardInserted) return 0;
+    isRoot = true;
+    return 1;
+}
+
+uint8_t SdFile::open(SdFile &dirFile, const char *fileName, uint8_t oflag)
+{
+    if (isOpen() || !dirFile.isRoot) return 0;
+    hostAdvance(SD_FILE_OP_NS);
+    int found = findEntry(fileName);
+    if (found >= 0 && (oflag & O_CREAT) && (oflag & O_EXCL)) return 0;
+    if (found < 0) {
+        if (!(oflag & O_CREAT)) return 0;
+        found = addEntry(fileName, 0, 0, false);
+        if (found < 0) return 0;
+    }
+    entry = found;
+    position = 0;
+    if (oflag & O_TRUNC) directory[entry].size = 0;
+    if (oflag & O_APPEND) position = directory[entry].size;
+    return 1;
+}
+
+uint8_t SdFile::createContiguous(SdFile &dirFile, const char *fileName, uint32_t size)
+{
+    if (isOpen() || !dirFile.isRoot || size == 0 || findEntry(fileName) >= 0) return 0;
+    hostAdvance(SD_FILE_OP_NS);
+    int created = addEntry(fileName, (size + SD_BLOCK - 1) / SD_BLOCK, size, true);
+    if (created < 0) return 0;
+    entry = created;
+    position = 0;
+    return 1;
+}
+
+uint8_t SdFile::contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock)
+{
+    if (entry < 0 || !directory[entry].contiguous) return 0;
+    *bgnBlock = directory[entry].firstBlock;
+    *endBlock = directory[entry].firstBlock + directory[entry].blocks - 1;
+    return 1;
+}
+
+uint8_t SdFile::close(void)
+{
+    if (entry >= 0) hostAdvance(SD_FILE_OP_NS);
+    entry = -1;
+    isRoot = false;
+    return 1;
+}
+
+int16_t SdFile::read(void *buf, uint16_t nbyte)
+{
+    if (entry < 0) return -1;
+    Entry &e = directory[entry];
+    if (position + nbyte > e.size) nbyte = e.size - position;
+    uint8_t block[SD_BLOCK];
+    uint8_t *dst = (uint8_t *) buf;
+    for (uint16_t done = 0; done < nbyte;) {
+        uint32_t offset = position % SD_BLOCK;
+        uint16_t n = SD_BLOCK - offset < (uint32_t) (nbyte - done) ? SD_BLOCK - offset : nbyte - done;
+        getBlock(e.firstBlock + position / SD_BLOCK, block);
+        memcpy(dst + done, block + offset, n);
+        hostAdvance(SD_BLOCK_TRANSFER_NS);
+        done += n;
+        position += n;
+    }
+    return nbyte;
+}
+
+int16_t SdFile::read(void)
+{
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+/**
+ * @description Writes at the current position. Files that are not contiguous move to a larger
+ *  extent when they grow, contiguous files keep their size
+ */
+size_t SdFile::write(const void *buf, uint16_t nbyte)
+{
+    if (entry < 0) return 0;
+    Entry *e = &directory[entry];
+    uint32_t needed = (position + nbyte + SD_BLOCK - 1) / SD_BLOCK;
+    if (needed > e->blocks) {
+        if (e->contiguous || nextFreeBlock + 2 * needed > SD_CARD_BLOCKS) return 0;
+        uint8_t block[SD_BLOCK];
+        for (uint32_t i = 0; i < e->blocks; i++) {
+            getBlock(e->firstBlock + i, block);
+            putBlock(nextFreeBlock + i, block);
+        }
+        e->firstBlock = nextFreeBlock;
+        e->blocks = 2 * needed;
+        nextFreeBlock += e->blocks;
+    }
+    uint8_t block[SD_BLOCK];
+    const uint8_t *src = (const uint8_t *) buf;
+    for (uint16_t done = 0; done < nbyte;) {
+        uint32_t offset = position % SD_BLOCK;
+        uint16_t n = SD_BLOCK - offset < (uint32_t) (nbyte - done) ? SD_BLOCK - offset : nbyte - done;
+        uint32_t blockNumber = e->firstBlock + position / SD_BLOCK;
+        getBlock(blockNumber, block);
+        memcpy(block + offset, src + done, n);
+        putBlock(blockNumber, block);
+        writeTime(SD_SINGLE_WRITE_NS);
+        done += n;
+        position += n;
+    }
+    if (position > e->size) e->size = position;
+    return nbyte;
+}
+
+uint8_t SdFile::seekSet(uint32_t pos)
+{
+    if (entry < 0 || pos > directory[entry].size) return 0;
+    position = pos;
+    return 1;
+}
+
+uint32_t SdFile::fileSize(void)
+{
+    return entry < 0 ? 0 : directory[entry].size;
+}
+
+uint8_t SdFile::truncate(uint32_t size)
+{
+    if (entry < 0 || size > directory[entry].size) return 0;
+    directory[entry].size = size;
+    if (position > size) position = size;
+    hostAdvance(SD_FILE_OP_NS);
+    return 1;
+}
+
+uint8_t SdFile::remove(void)
+{
+    if (entry < 0) return 0;
+    directory[entry].name.clear();  // entries keep their position, other open files point to them
+    entry = -1;
+    return 1;
+}
+
+uint8_t SdFile::remove(SdFile &dirFile, const char *fileName)
+{
+    SdFile file;
+    if (!file.open(dirFile, fileName, O_WRITE)) return 0;
+    return file.remove();
+}
+
+void SdFile::ls(uint8_t flags)
+{
+    if (!isRoot) return;
+    for (size_t i = 0; i < directory.size(); i++) {
+        if (directory[i].name.empty()) continue;
+        Serial.print(directory[i].name.c_str());
+        if (flags & LS_SIZE) {
+            Serial.print(' ');
+            Serial.print(directory[i].size);
+        }
+        Serial.println();
+    }
+}
+
+//////////////////////////////////////////////
+/////////////////// Host side ////////////////
+//////////////////////////////////////////////
+
+/**
+ * @description Inserts or removes the card, init fails without it
+ */
+void hostSDInsert(bool inserted)
+{
+    cardInserted = inserted;
+}
+
+/**
+ * @description Copies every file of the card to directory
+ * @returns the number of files copied, -1 on error
+ */
+int hostSDExport(const char *dir)
+{
+    uint8_t block[SD_BLOCK];
+    int files = 0;
+    for (size_t i = 0; i < directory.size(); i++) {
+        const Entry &e = directory[i];
+        if (e.name.empty()) continue;
+        std::string path = std::string(dir) + "/" + e.name;
+        FILE *f = fopen(path.c_str(), "wb");
+        if (f == NULL) {
+            perror(path.c_str());
+            return -1;
+        }
+        for (uint32_t done = 0; done < e.size; done += SD_BLOCK) {
+            getBlock(e.firstBlock + done / SD_BLOCK, block);
+            fwrite(block, 1, e.size - done < SD_BLOCK ? e.size - done : SD_BLOCK, f);
+        }
+        fclose(f);
+        files++;
+    }
+    return files;
+}
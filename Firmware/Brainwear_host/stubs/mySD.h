@@ -0,0 +1,90 @@
+//
+// mySD (SdFat) API of the host build. The card is kept in memory, files are extents of blocks
+// so raw block writes through Sd2Card land in the files as on the real card. The FAT itself
+// is not simulated.
+//
+
+#ifndef SOFTWARE_HOST_MYSD_H
+#define SOFTWARE_HOST_MYSD_H
+
+#include "Arduino.h"
+
+#define SPI_FULL_SPEED     0
+#define SPI_HALF_SPEED     1
+#define SPI_QUARTER_SPEED  2
+
+#define LS_DATE  1
+#define LS_SIZE  2
+#define LS_R     4
+
+#define O_READ    0x01
+#define O_RDONLY  O_READ
+#define O_WRITE   0x02
+#define O_WRONLY  O_WRITE
+#define O_RDWR    (O_READ | O_WRITE)
+#define O_APPEND  0x04
+#define O_SYNC    0x08
+#define O_CREAT   0x10
+#define O_EXCL    0x20
+#define O_TRUNC   0x40
+
+class Sd2Card {
+public:
+    uint8_t init(uint8_t sckRateID = SPI_FULL_SPEED, int8_t chipSelectPin = -1, int8_t mosiPin = -1,
+                 int8_t misoPin = -1, int8_t clockPin = -1);
+    uint32_t cardSize(void);
+    uint8_t erase(uint32_t firstBlock, uint32_t lastBlock);
+    uint8_t readBlock(uint32_t block, uint8_t *dst);
+    uint8_t writeBlock(uint32_t block, const uint8_t *src);
+    uint8_t writeStart(uint32_t block, uint32_t eraseCount);
+    uint8_t writeData(const uint8_t *src);
+    uint8_t writeStop(void);
+};
+
+class SdVolume {
+public:
+    uint8_t init(Sd2Card &card);
+    uint8_t init(Sd2Card *card) { return init(*card); }
+    uint8_t *cacheClear(void);
+};
+
+class SdFile {
+public:
+    SdFile();
+    uint8_t openRoot(SdVolume &volume);
+    uint8_t openRoot(SdVolume *volume) { return openRoot(*volume); }
+    uint8_t open(SdFile &dirFile, const char *fileName, uint8_t oflag);
+    uint8_t open(SdFile *dirFile, const char *fileName, uint8_t oflag) { return open(*dirFile, fileName, oflag); }
+    uint8_t createContiguous(SdFile &dirFile, const char *fileName, uint32_t size);
+    uint8_t createContiguous(SdFile *dirFile, const char *fileName, uint32_t size) { return createContiguous(*dirFile, fileName, size); }
+    uint8_t contiguousRange(uint32_t *bgnBlock, uint32_t *endBlock);
+    uint8_t close(void);
+    uint8_t isOpen(void) { return entry >= 0 || isRoot; }
+    int16_t read(void *buf, uint16_t nbyte);
+    int16_t read(void);
+    size_t write(const void *buf, uint16_t nbyte);
+    size_t write(uint8_t b) { return write(&b, 1); }
+    uint8_t seekSet(uint32_t pos);
+    uint32_t curPosition(void) { return position; }
+    uint32_t fileSize(void);
+    uint8_t sync(void) { return isOpen(); }
+    uint8_t truncate(uint32_t size);
+    uint8_t remove(void);
+    static uint8_t remove(SdFile &dirFile, const char *fileName);
+    static uint8_t remove(SdFile *dirFile, const char *fileName) { return remove(*dirFile, fileName); }
+    void ls(uint8_t flags = 0);
+
+private:
+    int entry;      // position in the directory, -1 when closed
+    bool isRoot;
+    uint32_t position;
+};
+
+class File {
+};
+
+// Host side of the card
+void hostSDInsert(bool inserted);
+int hostSDExport(const char *directory);
+
+#endif //SOFTWARE_HOST_MYSD_H
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Runs the firmware at every sample rate of the ADS1299 in several configurations and reports the
+# conversions it could not read in time. A configuration is sustainable while "missed" stays at 0.
+#
+#   ./sweep.sh [SECONDS]
+#
+# Configurations: EEG streamed to the serial port, EEG streamed with the serial decimation at 64,
+# EEG streamed in compressed blocks, EEG recorded on the SD card with the decimated stream, and
+# EEG + MMG (multimode).
+
+SECONDS_RUN=${1:-5}
+HOST=$(dirname "$0")/brainwear_host
+STOP_MS=$(awk "BEGIN { print ($SECONDS_RUN - 0.5) * 1000 }")
+
+run() {
+    # $1 name, $2 rate code, $3 commands before the start
+    "$HOST" -t "$SECONDS_RUN" -c "100:$3~$2b" -c "$STOP_MS:sj" 2>&1 >/dev/null | awk -v name="$1" -v rate="$2" '
+        /^DRDY/    { conversions = $2 }
+        /^ADS1299/ { read = $2; missed = $5; torn = $7 }
+        /^serial/  { stall = $7 }
+        /^SD /     { sd = $2 }
+        END {
+            hz = 16000 / 2 ^ rate
+            total = read + missed
+            printf "%-10s %6d Hz %8d %8d %8d %6d %6.1f%% %8.3f %7d\n", name, hz, conversions, read, missed, torn,
+                   (total > 0 ? 100 * missed / total : 0), stall, sd
+        }'
+}
+
+printf "%-10s %9s %8s %8s %8s %6s %7s %8s %7s\n" config rate DRDY read missed torn lost "UART s" "SD blk"
+for rate in 6 5 4 3 2 1 0; do
+    run serial $rate "N"
+    run "serial/64" $rate "N/6"
+    run "compressed" $rate "N{"
+    run "sd" $rate "N/6K"
+    run "multimode" $rate "M"
+done
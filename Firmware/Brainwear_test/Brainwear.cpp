@@ -5,14 +5,19 @@
 **/
 
 #include "Brainwear.h"
+#include "Brainwear_arena.h"
+#include "Brainwear_artifact.h"
+#include "Brainwear_SDformat.h"
+#include "Brainwear_trace.h"
+#include <EEPROM.h>
 #include <SPI.h>
 
+static_assert(sizeof(BrainwearConfig) <= EEPROM_SIZE - EEPROM_CONFIG, "BrainwearConfig does not fit in the EEPROM");
+static_assert(SD_MONTAGE_TERMS == MONTAGE_MAX_TERMS, "the super block does not hold the custom montage");
+
 
 //Constructor
 Brainwear::Brainwear(){
-    //SPI BUS for ADS1299
-    SPI0 = new SPIClass(VSPI);
-
     //Bools
     channelDataAvailable = false;
     verbosity = false;
@@ -26,6 +31,30 @@ Brainwear::Brainwear(){
     numberOfIncomingSettingsProcessedChannel = 0;
     numberOfIncomingSettingsProcessedLeadOff = 0;
     sampleCounter = 0;
+    serialDecimation = 1;
+    serialSumCount = 0;
+    serialBytes = ADS_BYTES_PER_CHAN;
+    for (int i = 0; i < ADS_NUM_CHANNELS; i++) serialShift[i] = 0;
+    activeChannels = ADS_ALL_CHANNELS;
+    featureMode = ADS_FEATURES_OFF;
+    impedanceMode = ADS_IMPEDANCE_OFF;
+    mmgOutputs = MMG_OUTPUT_RAW;
+    mmgEventMode = ADS_MMG_EVENTS_OFF;
+    artifactMode = ADS_ARTIFACTS_OFF;
+    montage = MONTAGE_AS_MEASURED;
+    montageTermCount = 0;
+    mainsMode = ADS_MAINS_OFF;
+    leadOffChannels = 0;
+    leadOffExcitation = LOFF_MAG_6NA | LOFF_FREQ_DC;
+    frameBytes = BoardFrame::FRAME_BYTES;
+    streamHeaderSent = false;
+    drdyCycles = 0;
+    drdyCount = 0;
+    sampleDrdyCycles = 0;
+    cyclesPerMicro = 240;
+    cyclesPerByte = 0;
+    adsWritten = 0;
+    restoredStreaming = false;
 
     //enums
     curSampleRate = SAMPLE_RATE_250;
@@ -43,11 +72,16 @@ boolean Brainwear::begin()
 {
     beginBoard();
     beginSerial(BAUD_RATE);
+    cyclesPerMicro = ESP.getCpuFreqMHz();
+    cyclesPerByte = cyclesPerMicro * 10000000UL / BAUD_RATE; // start, 8 data and stop bits
     beginSPI();
-    delay(10);
 
-    //Soft reset
-    boardReset();
+    //Soft reset, with the configuration of the last session
+    boardReset(true);
+    if (restoredStreaming)
+    {
+        streamStart();
+    }
 
     return true;
 }
@@ -90,6 +124,8 @@ void Brainwear::beginSerial(uint32_t baudRate)
  * @description: This function starts the SPI communication with the board
 */
 void Brainwear::beginSPI(void) {
+    //SPI BUS for ADS1299
+    if (SPI0 == NULL) SPI0 = arena.create<SPIClass>("ADS1299 SPI", VSPI);
 // start the SPI library:
     SPI0->begin();
     SPI0->beginTransaction(SPISettings(1500000, MSBFIRST, SPI_MODE1));
@@ -101,18 +137,35 @@ void Brainwear::beginSPI(void) {
 
 /**
  * @description: Soft reset of the board
+ * @param restore true at boot to write back the stored configuration, the 'v' command keeps the defaults
 */
-void Brainwear::boardReset(void)
+void Brainwear::boardReset(boolean restore)
 {
-    initialize(); //Initializes ADS board
-    delay(500);
-    configureLeadOffDetection(LOFF_MAG_6NA, LOFF_FREQ_31p2HZ);
+    boolean restored = false, verified;
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        initialize(); //Initializes ADS board
+        if (restore)
+        {
+            restored = restoreConfig();
+        }
+        verified = verifyRegisters();
+        if (verified) break; // otherwise once more from a new reset
+    }
 
     Serial.println("BrainWear board");
     Serial.print("On Board ADS1299 Device ID: ");
     printHex(getDeviceID());
     Serial.println();
     Serial.println("Firmware: v1.0");
+    if (restored)
+    {
+        Serial.println("Configuration restored");
+    }
+    if (!verified)
+    {
+        Serial.println("ADS1299 registers not verified");
+    }
 
     if (verbosity)
     {
@@ -120,7 +173,6 @@ void Brainwear::boardReset(void)
         readRegisters();
     }
     sendEOT();
-    delay(5);
     beginADSInterrupt();
 }
 
@@ -146,11 +198,12 @@ void Brainwear::initialize(void)
 */
 void Brainwear::initialize_ads(void)
 {
-    delay(50); // recommended power up sequence requiers >Tpor (~32mS)
+    if (millis() < ADS_TPOR_MS)
+    {
+        delay(ADS_TPOR_MS - millis()); // recommended power up sequence requires > tPOR since the supplies are up
+    }
     resetADS();
-    delay(10);
     WREG(CONFIG1,(DEFAULT_CONFIG1 | curSampleRate)); // tell on-board ADS to output its clk, set the data rate to 250SPS
-    delay(40);
 
     // DEFAULT CHANNEL SETTINGS FOR ADS
     defaultChannelSettings[POWER_DOWN] = NO;                  // on = NO, off = YES
@@ -173,8 +226,10 @@ void Brainwear::initialize_ads(void)
     writeChannelSettings(); // write settings to the ADS
 
     WREG(CONFIG3, 0b11101100); // pg.48, Enable internal reference buff, internal bias ref signal, bias buffer enabled
-    delay(1);
 
+    // AC lead-off, the impedance of the channels is measured at 31.2 Hz (Brainwear_impedance.h). After a
+    // change of sample rate too, the RESET sets the LOFF register back to DC lead-off
+    configureLeadOffDetection(LOFF_MAG_6NA, LOFF_FREQ_31p2HZ);
     for (int i = 0; i < ADS_NUM_CHANNELS; i++)
     { // turn off the impedance measure signal
         leadOffSettings[i][PCHAN] = OFF;
@@ -191,17 +246,56 @@ void Brainwear::initialize_ads(void)
 */
 void Brainwear::resetADS(void)
 {
-    int startChan, stopChan;
-    startChan = 1;
-    stopChan = 8;
     RESET(); // send RESET command to default all registers
     SDATAC(); // exit Read Data Continuous mode to communicate with ADS
+    adsWritten = 0;
+    if (!waitForDevice() && verbosity)
+    {
+        Serial.println("ADS1299 not answering");
+    }
     turnLED(); //Debug for GPIO
-    delay(100);
-    for (int chan = startChan; chan <= stopChan; chan++)
+    // every channel is written by initialize_ads right after
+}
+
+/**
+ * @description: Polls the ID register until the device answers, after a reset
+ * @returns true when a valid ADS1299 ID was read within ADS_ID_TIMEOUT_MS
+*/
+boolean Brainwear::waitForDevice(void)
+{
+    unsigned long start = millis();
+    do
+    {
+        if ((getDeviceID() & ADS_ID_MASK) == ADS_ID_ADS1299)
+        {
+            return true;
+        }
+    } while (millis() - start < ADS_ID_TIMEOUT_MS);
+    return false;
+}
+
+/**
+ * @description: Reads back the registers written since the last reset and compares them with
+ *  the values written, the status registers are skipped
+ * @returns true when the device answers with its ID and every register holds its value
+*/
+boolean Brainwear::verifyRegisters(void)
+{
+    byte values[ADS_REGISTERS];
+    RREG(ID_REG, ADS_REGISTERS, values);
+    if ((values[ID_REG] & ADS_ID_MASK) != ADS_ID_ADS1299)
     {
-        deactivateChannel(chan);
+        return false;
+    }
+    for (byte i = CONFIG1; i < ADS_REGISTERS; i++)
+    {
+        if (i == LOFF_STATP || i == LOFF_STATN) continue;
+        if (bitRead(adsWritten, i) && values[i] != adsRegisters[i])
+        {
+            return false;
+        }
     }
+    return true;
 }
 
 /**
@@ -210,13 +304,14 @@ void Brainwear::resetADS(void)
 void Brainwear::startADS(void)
 {
     sampleCounter = 0;
+    serialSumCount = 0;
     firstDataPacket = true;
-    digitalWrite(START_PIN, HIGH); //High to start conversion
-    delay(10);
+    drdyCount = 0;
+    drdyInterval.reset();
+    drdyLatency.reset();
+    digitalWrite(START_PIN, HIGH); //High to start conversion, the first DRDY comes after the settling time
     START(); // start the data acquisition
-    delay(1);
     RDATAC(); // enter Read Data Continuous mode
-    delay(1);
     isRunning = true;
 }
 
@@ -226,9 +321,7 @@ void Brainwear::startADS(void)
 void Brainwear::stopADS(void)
 {
     STOP(); // stop the data acquisition
-    delay(1);
     SDATAC(); // stop Read Data Continuous mode to communicate with ADS
-    delay(1);
     isRunning = false;
 }
 
@@ -260,12 +353,10 @@ void Brainwear::deactivateChannel(byte N)
     byte startChan, endChan, setting;
     startChan = 0;
     endChan = 8;
-    SDATAC();
-    delay(1); // exit Read Data Continuous mode to communicate with ADS
+    SDATAC(); // exit Read Data Continuous mode to communicate with ADS
     N = constrain(N - 1, startChan, endChan - 1); //subtracts 1 so that we're counting from 0, not 1
 
     setting = RREG(CH1SET + (N - startChan)); // get the current channel settings
-    delay(1);
     bitSet(setting,7); // set bit7 to shut down channel (pg. 50)
     bitClear(setting,3); // clear bit3 to disclude from SRB2 if used
     bitSet(setting,0);   //1
@@ -274,20 +365,16 @@ void Brainwear::deactivateChannel(byte N)
 
     // Write the new settings to the channel
     WREG(CH1SET + (N - startChan), setting);
-    delay(1);  // write the new value to disable the channel
+    channelSettings[N][POWER_DOWN] = YES;
 
     //remove the channel from the bias generation...
-    setting = RREG(BIAS_SENSP);
-    delay(1);                         //get the current bias settings
+    setting = RREG(BIAS_SENSP); //get the current bias settings
     bitClear(setting, N - startChan); //clear this channel's bit to remove from bias generation
     WREG(BIAS_SENSP, setting);
-    delay(1); //send the modified byte back to the ADS
 
-    setting = RREG(BIAS_SENSN);
-    delay(1);                         //get the current bias settings
+    setting = RREG(BIAS_SENSN); //get the current bias settings
     bitClear(setting, N - startChan); //clear this channel's bit to remove from bias generation
     WREG(BIAS_SENSN, setting);
-    delay(1); //send the modified byte back to the ADS
 
     leadOffSettings[N][0] = leadOffSettings[N][1] = NO;
     changeChannelLeadOffDetect(N + 1);
@@ -314,6 +401,7 @@ void Brainwear::activateChannel(byte N)
         bitSet(setting, 3);
     } // close this SRB2 switch
     WREG(CH1SET + (N - startChan), setting);
+    channelSettings[N][POWER_DOWN] = NO;
     // add or remove from inclusion in BIAS generation
     if (useInBias[N])
     {
@@ -336,7 +424,6 @@ void Brainwear::activateChannel(byte N)
         useInBias[N] = false;
     }
     WREG(BIAS_SENSP, setting);
-    delay(1);                             //send the modified byte back to the ADS
 
     setting = RREG(BIAS_SENSN); //get the current N bias settings
     if (channelSettings[N][BIAS_SET] == YES)
@@ -348,7 +435,6 @@ void Brainwear::activateChannel(byte N)
         bitClear(setting, N - startChan); // clear this channel's bit to remove from bias generation
     }
     WREG(BIAS_SENSN, setting);
-    delay(1); //send the modified byte back to the ADS
 
     setting = 0x00;
     if (boardUseSRB1 == true)
@@ -364,7 +450,7 @@ void Brainwear::configureLeadOffDetection(byte amplitudeCode, byte freqCode)
     amplitudeCode &= 0b00001100; //only these two bits should be used
     freqCode &= 0b00000011;      //only these two bits should be used
 
-    byte setting, targetSS;
+    byte setting;
     setting = RREG(LOFF); //get the current bias settings
     //reconfigure the byte to get what we want
     setting &= 0b11110000;    //clear out the last four bits
@@ -372,7 +458,7 @@ void Brainwear::configureLeadOffDetection(byte amplitudeCode, byte freqCode)
     setting |= freqCode;      //set the frequency
     //send the config byte back to the hardware
     WREG(LOFF, setting);
-    delay(1); //send the modified byte back to the ADS
+    leadOffExcitation = amplitudeCode | freqCode;
 }
 
 /**
@@ -380,12 +466,11 @@ void Brainwear::configureLeadOffDetection(byte amplitudeCode, byte freqCode)
 */
 void Brainwear::changeChannelLeadOffDetect(void)
 {
-    byte startChan, endChan, setting;
+    byte startChan, endChan;
     startChan = 0;
     endChan = ADS_NUM_CHANNELS;
 
-    SDATAC();
-    delay(1); // exit Read Data Continuous mode to communicate with ADS
+    SDATAC(); // exit Read Data Continuous mode to communicate with ADS
 
     byte P_setting = RREG(LOFF_SENSP);
     byte N_setting = RREG(LOFF_SENSN);
@@ -419,13 +504,12 @@ void Brainwear::changeChannelLeadOffDetect(void)
 */
 void Brainwear::changeChannelLeadOffDetect(byte N)
 {
-    byte startChan, endChan, setting;
+    byte startChan, endChan;
     startChan = 0;
     endChan = ADS_NUM_CHANNELS;
 
     N = constrain(N - 1, startChan, endChan - 1);
-    SDATAC();
-    delay(1); // exit Read Data Continuous mode to communicate with ADS
+    SDATAC(); // exit Read Data Continuous mode to communicate with ADS
 
     byte P_setting = RREG(LOFF_SENSP);
     byte N_setting = RREG(LOFF_SENSN);
@@ -462,8 +546,7 @@ void Brainwear::writeChannelSettings()
     startChan = 0;
     endChan = ADS_NUM_CHANNELS;
 
-    SDATAC();
-    delay(1); // exit Read Data Continuous mode to communicate with ADS
+    SDATAC(); // exit Read Data Continuous mode to communicate with ADS
 
     for (byte i = startChan; i < endChan; i++)
     { // write 8 channel settings
@@ -493,7 +576,6 @@ void Brainwear::writeChannelSettings()
             useInBias[i] = false; //remove this channel from bias generation
         }
         WREG(BIAS_SENSP, setting);
-        delay(1); //send the modified byte back to the ADS
 
         setting = RREG(BIAS_SENSN); //get the current N bias settings
         if (channelSettings[i][BIAS_SET] == YES)
@@ -505,7 +587,6 @@ void Brainwear::writeChannelSettings()
             bitClear(setting, i - startChan); // clear this channel's bit to remove from bias generation
         }
         WREG(BIAS_SENSN, setting);
-        delay(1); //send the modified byte back to the ADS
 
         if (channelSettings[i][SRB1_SET] == YES)
         {
@@ -543,8 +624,7 @@ void Brainwear::writeChannelSettings(byte N)
     endChan = 8;
 
     N = constrain(N - 1, startChan, endChan - 1); //subtracts 1 so that we're counting from 0, not 1
-    SDATAC();
-    delay(1); // exit Read Data Continuous mode to communicate with ADS
+    SDATAC(); // exit Read Data Continuous mode to communicate with ADS
 
     // write corresponding channel settings
     setting = 0x00;
@@ -573,7 +653,6 @@ void Brainwear::writeChannelSettings(byte N)
         useInBias[N] = false; //remove this channel from bias generation
     }
     WREG(BIAS_SENSP, setting);
-    delay(1); //send the modified byte back to the ADS
 
     setting = RREG(BIAS_SENSN); //get the current N bias settings
     if (channelSettings[N][BIAS_SET] == YES)
@@ -585,7 +664,6 @@ void Brainwear::writeChannelSettings(byte N)
         bitClear(setting, N - startChan); // clear this channel's bit to remove from bias generation
     }
     WREG(BIAS_SENSN, setting);
-    delay(1); //send the modified byte back to the ADS
 }
 
 /**
@@ -689,6 +767,18 @@ void Brainwear::changeInputType(byte inputCode)
 void Brainwear::streamStart(void)
 {
     streaming = true;
+    activeChannels = getActiveChannels();
+    leadOffChannels = activeChannels & getLeadOffChannels();
+    frameBytes = BoardFrame::STATUS_BYTES;
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (bitRead(activeChannels, i)) frameBytes = BoardFrame::STATUS_BYTES + (i + 1) * ADS_BYTES_PER_CHAN;
+    }
+    memset(boardFrame, 0, sizeof(boardFrame)); // channels after the last active one are not read
+    if (serial_stream && curTxMode == DATA_RAW && (!serialFormatIsDefault() || streamHeaderSent))
+    {
+        sendStreamHeader(); // the packets are not the OpenBCI ones, or were not in the last stream
+    }
     startADS();
     if (verbosity)
     {
@@ -716,6 +806,8 @@ void Brainwear::updateChannelData(void)
 {
     // this needs to be reset, or else it will constantly flag us
     channelDataAvailable = false;
+    sampleDrdyCycles = drdyCycles;
+    TRACE_DRDY_RECORD();
 
     lastSampleTime = millis();
     boolean downsample = true;
@@ -731,19 +823,18 @@ void Brainwear::updateData(void){
     channelDataAvailable = false;
 
     lastSampleTime = millis();
-    boolean downsample = true;
 
     byte inByte;
     digitalWrite(CS, LOW); //  open SPI
-    for (int i = 0; i < 15; i++)
+    for (int i = 0; i < BoardFrame::FRAME_BYTES; i++)
     {
         inByte = SPI0->transfer(0x00); //  read status register (1100 + LOFF_STATP + LOFF_STATN + GPIO[7:4])
-        boardData[i] = inByte;
+        boardFrame[i] = inByte;
     }
     digitalWrite(CS, HIGH); // close SPI
 
-    for (int i = 0; i < 15; i++) {
-        Serial.print(boardData[i], HEX);
+    for (int i = 0; i < BoardFrame::FRAME_BYTES; i++) {
+        Serial.print(boardFrame[i], HEX);
         Serial.print(" ");
     }
     Serial.println();
@@ -754,62 +845,36 @@ void Brainwear::updateData(void){
  */
 void Brainwear::updateBoardData(boolean downsample)
 {
-    byte inByte;
-    int byteCounter = 0;
+    TRACE_SCOPE(TRACE_UPDATE_BOARD, 0);
+    uint32_t status;
 
     if (!firstDataPacket && downsample)
     {
-        for (int i = 0; i < ADS_NUM_CHANNELS; i++)
+        for (int i = 0; i < BoardFrame::CHANNELS; i++)
         {                                                      // shift and average the byte arrays
             lastBoardChannelDataInt[i] = boardChannelDataInt[i]; // remember the last samples
         }
     }
 
     digitalWrite(CS, LOW); //  open SPI
-    for (int i = 0; i < 3; i++)
-    {
-        inByte = SPI0->transfer(0x00); //  read status register (1100 + LOFF_STATP + LOFF_STATN + GPIO[7:4])
-        boardStat = (boardStat << 8) | inByte;
-    }
-
-    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
-    {
-        for (int j = 0; j < ADS_BYTES_PER_CHAN; j++)
-        { //  read 24 bits of channel data in 8 3 byte chunks
-            inByte = SPI0->transfer(0x00);
-            boardChannelDataRaw[byteCounter] = inByte; // raw data goes here
-            byteCounter++;
-            boardChannelDataInt[i] = (boardChannelDataInt[i] << 8) | inByte; // int data goes here
-        }
+    for (int i = 0; i < frameBytes; i++)
+    { // status register (1100 + LOFF_STATP + LOFF_STATN + GPIO[7:4]) and 24 bits per channel,
+      // the read stops after the last active channel
+        boardFrame[i] = SPI0->transfer(0x00);
     }
     digitalWrite(CS, HIGH); // close SPI
-    // need to convert 24bit to 32bit
-    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
-    { // convert 3 byte 2's compliment to 4 byte 2's compliment
-        if (bitRead(boardChannelDataInt[i], 23) == 1)
-        {
-            boardChannelDataInt[i] |= 0xFF000000;
-        }
-        else
-        {
-            boardChannelDataInt[i] &= 0x00FFFFFF;
-        }
-    }
+
+    BoardFrame::decode(boardFrame, &status, boardChannelDataInt);
+    boardStat = status;
+    memcpy(boardChannelDataRaw, boardFrame + BoardFrame::STATUS_BYTES, BoardFrame::DATA_BYTES);
+
     if (!firstDataPacket && downsample)
     {
-        byteCounter = 0;
-        for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+        for (int i = 0; i < BoardFrame::CHANNELS; i++)
         { // take the average of this and the last sample
             meanBoardChannelDataInt[i] = (lastBoardChannelDataInt[i] + boardChannelDataInt[i]) / 2;
         }
-        for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
-        { // place the average values in the meanRaw array
-            for (int b = 2; b >= 0; b--)
-            {
-                meanBoardDataRaw[byteCounter] = (meanBoardChannelDataInt[i] >> (b * 8)) & 0xFF;
-                byteCounter++;
-            }
-        }
+        BoardFrame::pack(meanBoardChannelDataInt, meanBoardDataRaw); // place the average values in the meanRaw array
     }
     if (firstDataPacket == true)
     {
@@ -826,6 +891,40 @@ void Brainwear::sendEOT(void)
     Serial.print("$$$");
 }
 
+/**
+ * @description Adds the latency of the packet just sent: from the DRDY of its last sample to the
+ *  moment its last byte leaves the UART, that is now plus the bytes still waiting in the FIFO
+ */
+void Brainwear::measureLatency(void)
+{
+    measureLatency(sampleDrdyCycles);
+}
+
+/**
+ * @description Same, for a packet whose last sample was read before the one being processed, from
+ *  the DRDY cycles stamped on that sample
+ */
+void Brainwear::measureLatency(uint32_t lastDrdyCycles)
+{
+    int pending = UART_TX_FIFO_SIZE - Serial.availableForWrite();
+    if (pending < 0) pending = 0;
+    uint32_t cycles = ESP.getCycleCount() - lastDrdyCycles + pending * cyclesPerByte;
+    drdyLatency.add(cycles / cyclesPerMicro);
+}
+
+/**
+ * @description Prints the DRDY to wire latency and the DRDY interval histograms, in microseconds.
+ *  They are cleared when the stream starts, so they cover the current configuration
+ */
+void Brainwear::printLatencyReport(void)
+{
+    Serial.println("DRDY to UART latency (us)");
+    drdyLatency.print();
+    Serial.println("DRDY interval (us)");
+    drdyInterval.print();
+    sendEOT();
+}
+
 //////////////////////////////////////////////
 /////////////// Test Signals /////////////////
 //////////////////////////////////////////////
@@ -874,7 +973,6 @@ void Brainwear::configureInternalTestSignal(byte amplitudeCode, byte freqCode)
     amplitudeCode &= 0b00000100;                          //only this bit is used
     setting = 0b11010000 | freqCode | amplitudeCode; //compose the code. INT_CAL = 1 (Test signals generated internally)
     WREG(CONFIG2, setting);
-    delay(1);
 }
 
 // Configurations observed in CONFIG2 register
@@ -973,6 +1071,39 @@ boolean Brainwear::processChar(char character)
             case MULTI_CHAR_CMD_SETTINGS_SAMPLE_RATE:
                 processIncomingSampleRate(character);
                 break;
+            case MULTI_CHAR_CMD_SETTINGS_SERIAL_DECIMATION:
+                processIncomingSerialDecimation(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_SERIAL_WIDTH:
+                processIncomingSerialWidth(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_SERIAL_SHIFT:
+                processIncomingSerialShift(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_FEATURES:
+                processIncomingFeatureMode(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_IMPEDANCE:
+                processIncomingImpedanceMode(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_MMG_OUTPUTS:
+                processIncomingMMGOutputs(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_MMG_EVENTS:
+                processIncomingMMGEventMode(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_ARTIFACTS:
+                processIncomingArtifactMode(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_MONTAGE:
+                processIncomingMontage(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_MONTAGE_ROW:
+                processIncomingMontageRow(character);
+                break;
+            case MULTI_CHAR_CMD_SETTINGS_MAINS:
+                processIncomingMainsMode(character);
+                break;
             default:
                 break;
         }
@@ -1081,10 +1212,20 @@ boolean Brainwear::processChar(char character)
 
                 // STREAM DATA AND FILTER COMMANDS
             case ADS_STREAM_START: // stream data
+                if (!streaming)
+                {
+                    saveConfig(true); // the next boot streams with this configuration
+                }
                 streamStart(); // turn on the fire hose
                 break;
             case ADS_STREAM_STOP: // stop streaming data
                 streamStop();
+                saveConfig(false);
+                break;
+            case ADS_CONFIG_CLEAR:
+                clearConfig();
+                Serial.println("Stored configuration cleared");
+                sendEOT();
                 break;
 
                 //  INITIALIZE AND VERIFY
@@ -1105,6 +1246,59 @@ boolean Brainwear::processChar(char character)
                 startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_SAMPLE_RATE);
                 break;
 
+                // Serial preview decimation set
+            case ADS_SERIAL_DECIMATION_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_SERIAL_DECIMATION);
+                break;
+
+                // Precision of the serial packets
+            case ADS_SERIAL_WIDTH_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_SERIAL_WIDTH);
+                break;
+
+            case ADS_SERIAL_SHIFT_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_SERIAL_SHIFT);
+                break;
+
+                // Band power packets
+            case ADS_FEATURES_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_FEATURES);
+                break;
+
+                // Impedance packets
+            case ADS_IMPEDANCE_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_IMPEDANCE);
+                break;
+
+                // MMG values
+            case ADS_MMG_OUTPUTS_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_MMG_OUTPUTS);
+                break;
+
+                // MMG event packets
+            case ADS_MMG_EVENTS_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_MMG_EVENTS);
+                break;
+
+                // Artifact flags
+            case ADS_ARTIFACTS_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_ARTIFACTS);
+                break;
+
+                // Montage of the EEG channels
+            case ADS_MONTAGE_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_MONTAGE);
+                break;
+
+            case ADS_MONTAGE_ROW_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_MONTAGE_ROW);
+                break;
+
+                // Mains canceller
+            case ADS_MAINS_SET:
+                startMultiCharCmdTimer(MULTI_CHAR_CMD_SETTINGS_MAINS);
+                break;
+
             case ADS_TURN_ON_LED:
                 turnOnLED();
                 break;
@@ -1118,6 +1312,10 @@ boolean Brainwear::processChar(char character)
                 sendEOT();
                 break;
 
+            case ADS_LATENCY_REPORT:
+                printLatencyReport();
+                break;
+
             case ADS_ACTIVATE_SERIAL_STREAM:
                 serial_stream = true;
                 Serial.print("Stream via serial port activated");
@@ -1184,6 +1382,8 @@ void Brainwear::endMultiCharCmdTimer(void)
 {
     isMultiCharCmd = false;
     multiCharCommand = MULTI_CHAR_CMD_NONE;
+    serialShiftChannel = -1;
+    montageRowChannel = -1;
 }
 
 /**
@@ -1459,81 +1659,722 @@ void Brainwear::processIncomingSampleRate(char c)
 }
 
 /**
-* @description Converts ascii character to byte value for channel setting bytes
-* @param `asciiChar` - [char] - The ascii character to convert
-* @return [char] - Byte number value of ascii character, defaults to 0
-* @author AJ Keller (@pushtheworldllc)
+* @description changes the serial decimation with the multicommand option. The digit n
+*  averages 2^n samples for each packet sent to the serial port
 */
-char Brainwear::getChannelCommandForAsciiChar(char asciiChar)
+void Brainwear::processIncomingSerialDecimation(char c)
 {
-    switch (asciiChar)
+    if (c == ADS_SERIAL_DECIMATION_SET)
     {
-        case ADS_CHANNEL_CMD_CHANNEL_1:
-            return 0x00;
-        case ADS_CHANNEL_CMD_CHANNEL_2:
-            return 0x01;
-        case ADS_CHANNEL_CMD_CHANNEL_3:
-            return 0x02;
-        case ADS_CHANNEL_CMD_CHANNEL_4:
-            return 0x03;
-        case ADS_CHANNEL_CMD_CHANNEL_5:
-            return 0x04;
-        case ADS_CHANNEL_CMD_CHANNEL_6:
-            return 0x05;
-        case ADS_CHANNEL_CMD_CHANNEL_7:
-            return 0x06;
-        case ADS_CHANNEL_CMD_CHANNEL_8:
-            return 0x07;
-        default:
-            return 0x00;
+        Serial.print("Success: ");
+        Serial.print("Serial decimation is ");
+        Serial.print(getSerialDecimation());
+        sendEOT();
+    }
+    else if (isDigit(c) && c - '0' <= ADS_SERIAL_DECIMATION_MAX)
+    {
+        setSerialDecimation(1 << (c - '0'));
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            Serial.print("Serial decimation is ");
+            Serial.println(getSerialDecimation());
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid decimation value");
+            sendEOT();
+        }
     }
+    endMultiCharCmdTimer();
 }
 
 /**
-* @description Converts ascii character to get gain from channel settings
-* @param `asciiChar` - [char] - The ascii character to convert
-* @return [char] - Byte number value of acsii character, defaults to 0
-* @author AJ Keller (@pushtheworldllc)
+* @description changes the bytes of each channel sample in the serial packets with the multicommand
+*  option, from 1 to 3. Samples that do not fit after the shift of their channel saturate
 */
-char Brainwear::getNumberForAsciiChar(char asciiChar)
+void Brainwear::processIncomingSerialWidth(char c)
 {
-    if (asciiChar < '0' || asciiChar > '9')
+    if (c == ADS_SERIAL_WIDTH_SET)
     {
-        asciiChar = '0';
+        printSerialFormat();
     }
-
-    // Convert ascii char to number
-    asciiChar -= '0';
-
-    return asciiChar;
+    else if (c >= '1' && c - '0' <= ADS_BYTES_PER_CHAN)
+    {
+        serialBytes = c - '0';
+        serialFormatChanged();
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            printSerialFormat();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid width value");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
 }
 
 /**
-* @description Converts ascii character to get gain from channel settings
-* @param `asciiChar` - [char] - The ascii character to convert
-* @return [char] - Byte number value of acsii character, defaults to 0
-* @author AJ Keller (@pushtheworldllc)
+* @description changes the right shift of a channel in the serial packets with the multicommand
+*  option: the channel (1 to ADS_CHANNELS_BOARD, 0 for all of them), then the shift (0 to
+*  ADS_SERIAL_SHIFT_MAX). A shift of n divides the samples by 2^n, rounded
 */
-char Brainwear::getGainForAsciiChar(char asciiChar)
+void Brainwear::processIncomingSerialShift(char c)
 {
-    char output = 0x00;
-
-    if (asciiChar < '0' || asciiChar > '6')
+    if (serialShiftChannel < 0)
     {
-        asciiChar = '6'; // Default to 24
+        if (c == ADS_SERIAL_SHIFT_SET)
+        {
+            printSerialFormat();
+            endMultiCharCmdTimer();
+        }
+        else if (isDigit(c) && c - '0' <= ADS_CHANNELS_BOARD)
+        {
+            serialShiftChannel = c - '0'; // wait for the shift
+        }
+        else
+        {
+            if (!streaming)
+            {
+                Serial.print("Failure: ");
+                Serial.println("invalid channel");
+                sendEOT();
+            }
+            endMultiCharCmdTimer();
+        }
+        return;
     }
-
-    output = asciiChar - '0';
-
-    return output << 4;
+    if (isDigit(c) && c - '0' <= ADS_SERIAL_SHIFT_MAX)
+    {
+        for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+        {
+            if (serialShiftChannel == 0 || serialShiftChannel == i + 1) serialShift[i] = c - '0';
+        }
+        serialFormatChanged();
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            printSerialFormat();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid shift value");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
 }
 
 /**
-* @description gets the current sample rate in the settings
+* @description changes the band power packets with the multicommand option: 0 (none), 1 (between
+*  the sample packets) or 2 (band power packets only)
 */
-const char *Brainwear::getSampleRate(void)
+void Brainwear::processIncomingFeatureMode(char c)
 {
-    switch (curSampleRate)
+    static const char *const names[] = {"off", "on", "only"};
+    if (c == ADS_FEATURES_SET)
+    {
+        Serial.print("Success: ");
+        Serial.print("Band powers ");
+        Serial.print(names[featureMode]);
+        sendEOT();
+    }
+    else if (c >= '0' && c - '0' <= ADS_FEATURES_ONLY)
+    {
+        featureMode = c - '0';
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            Serial.print("Band powers ");
+            Serial.println(names[featureMode]);
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid band power mode");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description changes the impedance packets with the multicommand option: 0 (none), 1 (between
+*  the sample packets) or 2 (impedance packets only)
+*/
+void Brainwear::processIncomingImpedanceMode(char c)
+{
+    static const char *const names[] = {"off", "on", "only"};
+    if (c == ADS_IMPEDANCE_SET)
+    {
+        Serial.print("Success: ");
+        Serial.print("Impedance ");
+        Serial.print(names[impedanceMode]);
+        sendEOT();
+    }
+    else if (c >= '0' && c - '0' <= ADS_IMPEDANCE_ONLY)
+    {
+        impedanceMode = c - '0';
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            Serial.print("Impedance ");
+            Serial.println(names[impedanceMode]);
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid impedance mode");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description changes the MMG values of the sample packets and the SD files with the multicommand
+*  option: the sum of 1 (raw samples), 2 (envelope) and 4 (RMS). A new file takes them when it opens
+*/
+void Brainwear::processIncomingMMGOutputs(char c)
+{
+    if (c == ADS_MMG_OUTPUTS_SET)
+    {
+        Serial.print("Success: ");
+        printMMGOutputs();
+        sendEOT();
+    }
+    else if (c >= '1' && c - '0' <= MMG_OUTPUTS_ALL)
+    {
+        mmgOutputs = c - '0';
+        serialFormatChanged();
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            printMMGOutputs();
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid MMG outputs");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description changes the MMG event packets with the multicommand option: 0 (none), 1 (between the
+*  sample packets) or 2 (event packets only, the sample packets leave the MMG values out)
+*/
+void Brainwear::processIncomingMMGEventMode(char c)
+{
+    static const char *const names[] = {"off", "on", "only"};
+    if (c == ADS_MMG_EVENTS_SET)
+    {
+        Serial.print("Success: ");
+        Serial.print("MMG events ");
+        Serial.print(names[mmgEventMode]);
+        sendEOT();
+    }
+    else if (c >= '0' && c - '0' <= ADS_MMG_EVENTS_ONLY)
+    {
+        mmgEventMode = c - '0';
+        serialFormatChanged();
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            Serial.print("MMG events ");
+            Serial.println(names[mmgEventMode]);
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid MMG event mode");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description changes the artifact flags of the sample packets and the SD files with the multicommand
+*  option: 0 (none) or 1 (flags after the samples). A new file takes them when it opens
+*/
+void Brainwear::processIncomingArtifactMode(char c)
+{
+    static const char *const names[] = {"off", "on"};
+    if (c == ADS_ARTIFACTS_SET)
+    {
+        Serial.print("Success: ");
+        Serial.print("Artifact flags ");
+        Serial.print(names[artifactMode]);
+        sendEOT();
+    }
+    else if (c >= '0' && c - '0' <= ADS_ARTIFACTS_ON)
+    {
+        artifactMode = c - '0';
+        serialFormatChanged();
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            Serial.print("Artifact flags ");
+            Serial.println(names[artifactMode]);
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid artifact mode");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description Prints the MMG values of the sample packets and the SD files
+*/
+void Brainwear::printMMGOutputs(void)
+{
+    Serial.print("MMG");
+    if (mmgOutputs & MMG_OUTPUT_RAW) Serial.print(" raw");
+    if (mmgOutputs & MMG_OUTPUT_ENVELOPE) Serial.print(" envelope");
+    if (mmgOutputs & MMG_OUTPUT_RMS) Serial.print(" RMS");
+    Serial.println();
+}
+
+/**
+* @description changes the mains canceller of the EEG and MMG channels with the multicommand option:
+*  0 (off), 1 (50 Hz) or 2 (60 Hz). The canceller starts again at every change
+*/
+void Brainwear::processIncomingMainsMode(char c)
+{
+    static const char *const names[] = {"off", "50 Hz", "60 Hz"};
+    if (c == ADS_MAINS_SET)
+    {
+        Serial.print("Success: ");
+        Serial.print("Mains canceller ");
+        Serial.print(names[mainsMode]);
+        sendEOT();
+    }
+    else if (c >= '0' && c - '0' <= ADS_MAINS_60HZ)
+    {
+        mainsMode = c - '0';
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            Serial.print("Mains canceller ");
+            Serial.println(names[mainsMode]);
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid mains mode");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description changes the montage of the EEG channels with the multicommand option: 0 (as measured),
+*  1 (common average), 2 (bipolar) or 3 (the custom rows set with ADS_MONTAGE_ROW_SET)
+*/
+void Brainwear::processIncomingMontage(char c)
+{
+    if (c == ADS_MONTAGE_SET)
+    {
+        Serial.print("Success: ");
+        printMontage();
+        sendEOT();
+    }
+    else if (c >= '0' && c - '0' <= MONTAGE_CUSTOM)
+    {
+        montage = c - '0';
+        serialFormatChanged();
+        if (!streaming)
+        {
+            Serial.print("Success: ");
+            printMontage();
+            sendEOT();
+        }
+    }
+    else
+    {
+        if (!streaming)
+        {
+            Serial.print("Failure: ");
+            Serial.println("invalid montage");
+            sendEOT();
+        }
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description Sets the row of one channel in the custom montage: the channel (1 to 4), then each term
+*  as + or - and an input channel, then ADS_MONTAGE_ROW_LATCH. A term repeated adds up, o1+1+1-3-4O is
+*  channel 1 minus the mean of channels 3 and 4; a row without terms leaves the channel as measured
+*/
+void Brainwear::processIncomingMontageRow(char c)
+{
+    const char *error = NULL;
+    if (montageRowChannel < 0)
+    {
+        if (c == ADS_MONTAGE_ROW_SET)
+        {
+            Serial.print("Success: ");
+            printMontage();
+            sendEOT();
+            endMultiCharCmdTimer();
+            return;
+        }
+        if (c >= '1' && c - '1' < ADS_CHANNELS_BOARD)
+        {
+            montageRowChannel = c - '1'; // wait for the terms
+            montageRowSign = 0;
+            memset(montageRowWeights, 0, sizeof(montageRowWeights));
+            return;
+        }
+        error = "invalid channel";
+    }
+    else if (montageRowSign == 0 && (c == '+' || c == '-'))
+    {
+        montageRowSign = c == '+' ? 1 : -1; // wait for the input
+        return;
+    }
+    else if (montageRowSign != 0)
+    {
+        if (c >= '1' && c - '1' < ADS_CHANNELS_BOARD)
+        {
+            int weight = montageRowWeights[c - '1'] + montageRowSign;
+            if (weight >= -MONTAGE_MAX_WEIGHT && weight <= MONTAGE_MAX_WEIGHT)
+            {
+                montageRowWeights[c - '1'] = weight;
+                montageRowSign = 0;
+                return;
+            }
+            error = "weight too large";
+        }
+        else
+        {
+            error = "invalid channel";
+        }
+    }
+    else if (c == ADS_MONTAGE_ROW_LATCH)
+    {
+        // the terms of the other rows, then those of this one
+        MontageTerm terms[MONTAGE_MAX_TERMS];
+        byte count = 0;
+        for (int i = 0; i < montageTermCount; i++)
+        {
+            if ((montageTerms[i].channels >> 4) != montageRowChannel) terms[count++] = montageTerms[i];
+        }
+        for (int i = 0; i < ADS_CHANNELS_BOARD && error == NULL; i++)
+        {
+            if (montageRowWeights[i] == 0) continue;
+            if (count == MONTAGE_MAX_TERMS)
+            {
+                error = "too many montage terms";
+                break;
+            }
+            terms[count].channels = montageRowChannel << 4 | i;
+            terms[count++].weight = montageRowWeights[i];
+        }
+        if (error == NULL)
+        {
+            memcpy(montageTerms, terms, sizeof(terms));
+            montageTermCount = count;
+            if (montage == MONTAGE_CUSTOM) serialFormatChanged();
+            if (!streaming)
+            {
+                Serial.print("Success: ");
+                printMontage();
+                sendEOT();
+            }
+        }
+    }
+    else
+    {
+        error = "invalid montage term";
+    }
+    if (error != NULL && !streaming)
+    {
+        Serial.print("Failure: ");
+        Serial.println(error);
+        sendEOT();
+    }
+    endMultiCharCmdTimer();
+}
+
+/**
+* @description Prints the montage of the EEG channels and the rows of the custom montage, in the
+*  syntax of ADS_MONTAGE_ROW_SET, labelled as stored when another montage is in use
+*/
+void Brainwear::printMontage(void)
+{
+    static const char *const names[] = {"as measured", "common average", "bipolar", "custom"};
+    Serial.print("Montage ");
+    Serial.print(names[montage]);
+    if (montage != MONTAGE_CUSTOM && montageTermCount > 0)
+    {
+        Serial.print(", stored custom rows"); // kept for the next custom montage, not in use
+    }
+    for (int output = 0; output < ADS_CHANNELS_BOARD; output++)
+    {
+        boolean first = true;
+        for (int i = 0; i < montageTermCount; i++)
+        {
+            if ((montageTerms[i].channels >> 4) != output) continue;
+            if (first)
+            {
+                Serial.print(" ");
+                Serial.print((char) ADS_MONTAGE_ROW_SET);
+                Serial.print(output + 1);
+                first = false;
+            }
+            int weight = montageTerms[i].weight;
+            for (int n = weight < 0 ? -weight : weight; n > 0; n--)
+            {
+                Serial.print(weight < 0 ? '-' : '+');
+                Serial.print((montageTerms[i].channels & 0x0F) + 1);
+            }
+        }
+        if (!first) Serial.print((char) ADS_MONTAGE_ROW_LATCH);
+    }
+    Serial.println();
+}
+
+/**
+* @description Prints the bytes per sample and the shift of each channel of the serial packets
+*/
+void Brainwear::printSerialFormat(void)
+{
+    Serial.print("Serial samples of ");
+    Serial.print(serialBytes * 8);
+    Serial.print(" bits, shifts");
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        Serial.print(" ");
+        Serial.print(serialShift[i]);
+    }
+    Serial.print(", channels");
+    byte active = getActiveChannels();
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (!bitRead(active, i)) continue;
+        Serial.print(" ");
+        Serial.print(i + 1);
+    }
+    Serial.println();
+    sendEOT();
+}
+
+/**
+* @description Channels powered up in channelSettings, bit n for channel n + 1. The packets and
+*  the SD files leave the others out
+*/
+byte Brainwear::getActiveChannels(void)
+{
+    byte mask = 0;
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (channelSettings[i][POWER_DOWN] == NO) bitSet(mask, i);
+    }
+    return mask;
+}
+
+/**
+* @description Channels with the lead-off current enabled on the P or N input, bit n for channel n + 1
+*/
+byte Brainwear::getLeadOffChannels(void)
+{
+    byte mask = 0;
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (leadOffSettings[i][PCHAN] == ON || leadOffSettings[i][NCHAN] == ON) bitSet(mask, i);
+    }
+    return mask;
+}
+
+/**
+* @description Gets the lead-off current set by configureLeadOffDetection
+* @return [float] - The current, in A
+*/
+float Brainwear::getLeadOffCurrent(void)
+{
+    static const float currents[] = {6e-9, 24e-9, 6e-6, 24e-6};
+    return currents[(leadOffExcitation & 0b00001100) >> 2];
+}
+
+/**
+* @description Gets the frequency of the AC lead-off excitation, fCLK / 2^18 or fCLK / 2^16
+* @return [float] - The frequency in Hz, 0 for DC lead-off and for fDR / 4, which are not measured
+*/
+float Brainwear::getLeadOffFrequencyHz(void)
+{
+    switch (leadOffExcitation & 0b00000011)
+    {
+        case LOFF_FREQ_7p8HZ:
+            return 7.8125;
+        case LOFF_FREQ_31p2HZ:
+            return 31.25;
+        default:
+            return 0;
+    }
+}
+
+/**
+* @description Frequency of the mains cancelled on the EEG and MMG channels
+* @returns 0 when the canceller is off
+*/
+unsigned int Brainwear::getMainsFrequencyHz(void)
+{
+    switch (mainsMode)
+    {
+        case ADS_MAINS_50HZ:
+            return 50;
+        case ADS_MAINS_60HZ:
+            return 60;
+        default:
+            return 0;
+    }
+}
+
+/**
+* @description Gets the PGA gain of a channel from its settings
+* @param `channel` - [byte] - The channel, counting from 0
+* @return [byte] - The gain (1, 2, 4, 6, 8, 12 or 24)
+*/
+byte Brainwear::getChannelGain(byte channel)
+{
+    static const byte gains[] = {1, 2, 4, 6, 8, 12, 24, 24};
+    return gains[(channelSettings[channel][GAIN_SET] >> 4) & 0x07];
+}
+
+/**
+* @description Converts ascii character to byte value for channel setting bytes
+* @param `asciiChar` - [char] - The ascii character to convert
+* @return [char] - Byte number value of ascii character, defaults to 0
+* @author AJ Keller (@pushtheworldllc)
+*/
+char Brainwear::getChannelCommandForAsciiChar(char asciiChar)
+{
+    switch (asciiChar)
+    {
+        case ADS_CHANNEL_CMD_CHANNEL_1:
+            return 0x00;
+        case ADS_CHANNEL_CMD_CHANNEL_2:
+            return 0x01;
+        case ADS_CHANNEL_CMD_CHANNEL_3:
+            return 0x02;
+        case ADS_CHANNEL_CMD_CHANNEL_4:
+            return 0x03;
+        case ADS_CHANNEL_CMD_CHANNEL_5:
+            return 0x04;
+        case ADS_CHANNEL_CMD_CHANNEL_6:
+            return 0x05;
+        case ADS_CHANNEL_CMD_CHANNEL_7:
+            return 0x06;
+        case ADS_CHANNEL_CMD_CHANNEL_8:
+            return 0x07;
+        default:
+            return 0x00;
+    }
+}
+
+/**
+* @description Converts ascii character to get gain from channel settings
+* @param `asciiChar` - [char] - The ascii character to convert
+* @return [char] - Byte number value of acsii character, defaults to 0
+* @author AJ Keller (@pushtheworldllc)
+*/
+char Brainwear::getNumberForAsciiChar(char asciiChar)
+{
+    if (asciiChar < '0' || asciiChar > '9')
+    {
+        asciiChar = '0';
+    }
+
+    // Convert ascii char to number
+    asciiChar -= '0';
+
+    return asciiChar;
+}
+
+/**
+* @description Converts ascii character to get gain from channel settings
+* @param `asciiChar` - [char] - The ascii character to convert
+* @return [char] - Byte number value of acsii character, defaults to 0
+* @author AJ Keller (@pushtheworldllc)
+*/
+char Brainwear::getGainForAsciiChar(char asciiChar)
+{
+    char output = 0x00;
+
+    if (asciiChar < '0' || asciiChar > '6')
+    {
+        asciiChar = '6'; // Default to 24
+    }
+
+    output = asciiChar - '0';
+
+    return output << 4;
+}
+
+/**
+* @description MMG outputs of the sample packets: none when the event packets replace them
+*/
+byte Brainwear::getPacketMMGOutputs(void)
+{
+    return mmgEventMode == ADS_MMG_EVENTS_ONLY ? 0 : mmgOutputs;
+}
+
+/**
+* @description gets the current sample rate in the settings
+*/
+const char *Brainwear::getSampleRate(void)
+{
+    switch (curSampleRate)
     {
         case SAMPLE_RATE_16000:
             return "16000";
@@ -1553,6 +2394,32 @@ const char *Brainwear::getSampleRate(void)
     }
 }
 
+/**
+* @description gets the current sample rate in Hz
+*/
+unsigned int Brainwear::getSampleRateHz(void)
+{
+    return 16000 >> curSampleRate;
+}
+
+/**
+* @description gets the number of samples averaged for each serial packet
+*/
+byte Brainwear::getSerialDecimation(void)
+{
+    return serialDecimation;
+}
+
+/**
+* @description Sets the number of samples averaged for each serial packet. The SD card
+*  always records every sample, only the serial port is decimated
+*/
+void Brainwear::setSerialDecimation(byte decimation)
+{
+    serialDecimation = decimation;
+    serialSumCount = 0;
+}
+
 /**
 * @description Change the current sample rate and restarts the Brainwear module
 */
@@ -1562,6 +2429,140 @@ void Brainwear::setSampleRate(uint8_t newSampleRateCode)
     initialize_ads();
 }
 
+//////////////////////////////////////////////
+//////////// Stored configuration/////////////
+//////////////////////////////////////////////
+
+/**
+* @description Stores the configuration in the EEPROM: the register map read from the ADS1299,
+*  the channel settings behind it and whether the stream runs. Nothing is written when the
+*  stored configuration is the same. Must not be called while streaming, the flash write stalls the CPU
+* @param `streamOn` - [boolean] - Start the stream after the next boot
+*/
+void Brainwear::saveConfig(boolean streamOn)
+{
+    BrainwearConfig config;
+    memset(&config, 0, sizeof(config));
+    config.key = EEPROM_CONFIG_KEY;
+    config.version = EEPROM_CONFIG_VERSION;
+    config.sampleRate = curSampleRate;
+    config.serialDecimation = serialDecimation;
+    config.serialBytes = serialBytes;
+    memcpy(config.serialShift, serialShift, sizeof(config.serialShift));
+    config.featureMode = featureMode;
+    config.impedanceMode = impedanceMode;
+    config.mmgOutputs = mmgOutputs;
+    config.mmgEventMode = mmgEventMode;
+    config.artifactMode = artifactMode;
+    config.montage = montage;
+    config.montageTermCount = montageTermCount;
+    memcpy(config.montageTerms, montageTerms, sizeof(config.montageTerms));
+    config.mainsMode = mainsMode;
+    config.streaming = streamOn;
+    config.boardUseSRB1 = boardUseSRB1;
+    memcpy(config.channelSettings, channelSettings, sizeof(config.channelSettings));
+    memcpy(config.leadOffSettings, leadOffSettings, sizeof(config.leadOffSettings));
+    for (int i = 0; i < ADS_NUM_CHANNELS; i++)
+    {
+        config.useInBias[i] = useInBias[i];
+    }
+    RREG(ID_REG, ADS_REGISTERS, config.registers);
+    config.crc = sdCrc16((const uint8_t *) &config, offsetof(BrainwearConfig, crc), 0xFFFF);
+
+    const byte *bytes = (const byte *) &config;
+    boolean changed = false;
+    for (unsigned int i = 0; i < sizeof(config); i++)
+    {
+        if (EEPROM.read(EEPROM_CONFIG + i) != bytes[i])
+        {
+            EEPROM.write(EEPROM_CONFIG + i, bytes[i]);
+            changed = true;
+        }
+    }
+    if (changed)
+    {
+        EEPROM.commit();
+    }
+}
+
+/**
+* @description Reads the configuration stored by saveConfig
+* @returns false when there is none or it is not valid
+*/
+boolean Brainwear::loadConfig(BrainwearConfig *config)
+{
+    byte *bytes = (byte *) config;
+    for (unsigned int i = 0; i < sizeof(BrainwearConfig); i++)
+    {
+        bytes[i] = EEPROM.read(EEPROM_CONFIG + i);
+    }
+    return config->key == EEPROM_CONFIG_KEY && config->version == EEPROM_CONFIG_VERSION &&
+           config->crc == sdCrc16(bytes, offsetof(BrainwearConfig, crc), 0xFFFF) &&
+           config->sampleRate <= SAMPLE_RATE_250 && config->serialDecimation >= 1 &&
+           config->serialDecimation <= 1 << ADS_SERIAL_DECIMATION_MAX &&
+           config->serialBytes >= 1 && config->serialBytes <= ADS_BYTES_PER_CHAN &&
+           config->featureMode <= ADS_FEATURES_ONLY && config->impedanceMode <= ADS_IMPEDANCE_ONLY &&
+           config->mmgOutputs >= 1 && config->mmgOutputs <= MMG_OUTPUTS_ALL &&
+           config->mmgEventMode <= ADS_MMG_EVENTS_ONLY && config->artifactMode <= ADS_ARTIFACTS_ON &&
+           config->montage <= MONTAGE_CUSTOM && config->montageTermCount <= MONTAGE_MAX_TERMS &&
+           config->mainsMode <= ADS_MAINS_60HZ;
+}
+
+/**
+* @description Writes the stored configuration to the ADS1299 in one command, after a reset
+* @returns false when there is no stored configuration, the defaults stay
+*/
+boolean Brainwear::restoreConfig(void)
+{
+    BrainwearConfig config;
+    restoredStreaming = false;
+    if (!loadConfig(&config))
+    {
+        return false;
+    }
+    curSampleRate = (SAMPLE_RATE) config.sampleRate;
+    setSerialDecimation(config.serialDecimation);
+    serialBytes = config.serialBytes;
+    featureMode = config.featureMode;
+    impedanceMode = config.impedanceMode;
+    mmgOutputs = config.mmgOutputs;
+    mmgEventMode = config.mmgEventMode;
+    artifactMode = config.artifactMode;
+    montage = config.montage;
+    montageTermCount = 0;
+    for (int i = 0; i < config.montageTermCount; i++)
+    {
+        const MontageTerm &term = config.montageTerms[i];
+        if ((term.channels >> 4) >= ADS_CHANNELS_BOARD || (term.channels & 0x0F) >= ADS_CHANNELS_BOARD) continue;
+        if (term.weight < -MONTAGE_MAX_WEIGHT || term.weight > MONTAGE_MAX_WEIGHT) continue;
+        montageTerms[montageTermCount++] = term;
+    }
+    mainsMode = config.mainsMode;
+    for (int i = 0; i < ADS_NUM_CHANNELS; i++)
+    {
+        serialShift[i] = config.serialShift[i] <= ADS_SERIAL_SHIFT_MAX ? config.serialShift[i] : 0;
+    }
+    boardUseSRB1 = config.boardUseSRB1;
+    memcpy(channelSettings, config.channelSettings, sizeof(channelSettings));
+    memcpy(leadOffSettings, config.leadOffSettings, sizeof(leadOffSettings));
+    for (int i = 0; i < ADS_NUM_CHANNELS; i++)
+    {
+        useInBias[i] = config.useInBias[i];
+    }
+    WREG(CONFIG1, &config.registers[CONFIG1], ADS_REGISTERS - CONFIG1);
+    restoredStreaming = config.streaming;
+    return true;
+}
+
+/**
+* @description Forgets the stored configuration, the next boot starts with the defaults
+*/
+void Brainwear::clearConfig(void)
+{
+    EEPROM.write(EEPROM_CONFIG, 0xFF);
+    EEPROM.commit();
+}
+
 //////////////////////////////////////////////
 //////////// Stream-safe options//////////////
 //////////////////////////////////////////////
@@ -1581,6 +2582,13 @@ void Brainwear::streamSafeChannelSettingsForChannel(byte channelNumber, byte pow
         streamStop();
     }
 
+    channelSettings[channelNumber - 1][POWER_DOWN] = powerDown;
+    channelSettings[channelNumber - 1][GAIN_SET] = gain;
+    channelSettings[channelNumber - 1][INPUT_TYPE_SET] = inputType;
+    channelSettings[channelNumber - 1][BIAS_SET] = bias;
+    channelSettings[channelNumber - 1][SRB2_SET] = srb2;
+    channelSettings[channelNumber - 1][SRB1_SET] = srb1;
+
     writeChannelSettings(channelNumber);
 
     // Restart stream if need be
@@ -1607,6 +2615,9 @@ void Brainwear::streamSafeLeadOffSetForChannel(byte channelNumber, byte pInput,
         streamStop();
     }
 
+    leadOffSettings[channelNumber - 1][PCHAN] = pInput;
+    leadOffSettings[channelNumber - 1][NCHAN] = nInput;
+
     changeChannelLeadOffDetect(channelNumber);
 
     // Restart stream if need be
@@ -1773,6 +2784,126 @@ void Brainwear::sendChannelData(TX_MODE curTxMode)
     sampleCounter++;
 }
 
+/**
+* @description Adds the last sample to the serial packet. Every serialDecimation samples
+*  the average is placed in serialChannelDataRaw and serialChannelDataInt.
+* @returns {boolean} - `true` when a serial packet is ready to be sent
+*/
+boolean Brainwear::decimateChannelData(void)
+{
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (serialSumCount == 0) serialChannelSum[i] = 0;
+        serialChannelSum[i] += boardChannelDataInt[i];
+    }
+    serialSumCount++;
+    if (serialSumCount < serialDecimation)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    { // place the average values in the serial arrays
+        serialChannelDataInt[i] = serialChannelSum[i] / serialSumCount;
+    }
+    packSerialData();
+    serialSumCount = 0;
+    return true;
+}
+
+/**
+* @description Places serialChannelDataInt in serialChannelDataRaw with the precision of the serial
+*  packets: each active channel shifted right by its serialShift, rounded, saturated to serialBytes
+*  and written big endian. Channels powered down are left out
+*/
+void Brainwear::packSerialData(void)
+{
+    if (serialFormatIsDefault())
+    {
+        BoardFrame::pack(serialChannelDataInt, serialChannelDataRaw);
+        return;
+    }
+    int32_t max = (1L << (8 * serialBytes - 1)) - 1;
+    byte *p = serialChannelDataRaw;
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (!bitRead(activeChannels, i)) continue;
+        int32_t value = serialChannelDataInt[i];
+        if (serialShift[i] > 0) value = (value + (1L << (serialShift[i] - 1))) >> serialShift[i];
+        if (value > max) value = max;
+        if (value < -max - 1) value = -max - 1;
+        for (int b = serialBytes - 1; b >= 0; b--)
+        {
+            *p++ = (byte) (value >> (8 * b));
+        }
+    }
+}
+
+/**
+* @description True while the serial packets have the 24-bit samples of the ADS1299 and the raw MMG
+*  samples without artifact flags, every channel as measured: the layout of the OpenBCI packets
+*/
+boolean Brainwear::serialFormatIsDefault(void)
+{
+    if (serialBytes != ADS_BYTES_PER_CHAN || activeChannels != ADS_ALL_CHANNELS) return false;
+    if (getPacketMMGOutputs() != MMG_OUTPUT_RAW || artifactMode != ADS_ARTIFACTS_OFF) return false;
+    if (montage != MONTAGE_AS_MEASURED) return false;
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        if (serialShift[i] != 0) return false;
+    }
+    return true;
+}
+
+/**
+* @description The receiver learns the new layout from a stream header before the next packet
+*/
+void Brainwear::serialFormatChanged(void)
+{
+    if (streaming && serial_stream && curTxMode == DATA_RAW)
+    {
+        sendStreamHeader();
+    }
+}
+
+/**
+* @description Sends the layout of the sample packets: ADS_BOP, bytes per channel sample, number of
+*  channels, mask of the active channels (bit n for channel n + 1), the right shift of each channel,
+*  the MMG outputs, ADS_EOP_HEADER. The packets carry the active channels only, in order, and a sample
+*  n of channel c stands for n * 2^shift[c] counts of the ADS1299. For each output (raw, envelope,
+*  RMS, in that order) the packets hold the 4 values of MMG1 then the 4 of MMG2, as the SD files,
+*  none when only the MMG events are sent. Then come the bytes of the artifact flags (0 or
+*  ARTIFACT_BYTES) and the montage of the EEG channels (a MONTAGE_ mode; with MONTAGE_CUSTOM the
+*  number of terms and 2 bytes per term, output << 4 | input and the weight). Sent when the stream starts with other than the default packets (every channel as
+*  measured, 24-bit samples), when it starts again with the default ones after that and whenever the
+*  layout changes
+*/
+void Brainwear::sendStreamHeader(void)
+{
+    Serial.write(ADS_BOP);
+    Serial.write(serialBytes);
+    Serial.write((byte) ADS_CHANNELS_BOARD);
+    Serial.write(activeChannels);
+    for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
+    {
+        Serial.write(serialShift[i]);
+    }
+    Serial.write(getPacketMMGOutputs());
+    Serial.write((byte) (artifactMode == ADS_ARTIFACTS_ON ? ARTIFACT_BYTES : 0));
+    Serial.write(montage);
+    if (montage == MONTAGE_CUSTOM)
+    {
+        Serial.write(montageTermCount);
+        for (int i = 0; i < montageTermCount; i++)
+        {
+            Serial.write(montageTerms[i].channels);
+            Serial.write((byte) montageTerms[i].weight);
+        }
+    }
+    Serial.write((uint8_t) ADS_EOP_HEADER);
+    streamHeaderSent = !serialFormatIsDefault();
+}
+
 /**
 * @description Writes channel data to serial port sending chunks of 8 bytes.
 */
@@ -1787,9 +2918,10 @@ void Brainwear::sendChannelDataSerial_Raw(void)
 */
 void Brainwear::ADS_writeChannelData(void)
 {
-    for (int i = 0; i < ADS_CHANNELS_BOARD*ADS_BYTES_PER_CHAN; i++)
+    int bytes = serialFormatIsDefault() ? BoardFrame::DATA_BYTES : __builtin_popcount(activeChannels) * serialBytes;
+    for (int i = 0; i < bytes; i++)
     {
-        Serial.write(boardChannelDataRaw[i]);
+        Serial.write(serialChannelDataRaw[i]);
     }
 }
 
@@ -1800,7 +2932,7 @@ void Brainwear::sendChannelDataSerial_Ascii(void)
 {
     for (int i = 0; i < ADS_CHANNELS_BOARD; i++)
     {
-        Serial.print(boardChannelDataRaw[i]);
+        Serial.print(serialChannelDataInt[i]);
         Serial.print(" ");
     }
 }
@@ -1815,10 +2947,7 @@ void Brainwear::sendChannelDataSerial_Ascii(void)
 */
 void Brainwear::turnLED(void)
 {
-    RREG(GPIO);
     WREG(GPIO,0x00);
-    delay(100);
-    RREG(GPIO);
 }
 
 /**
@@ -1832,11 +2961,8 @@ void Brainwear::turnOffLED(void)
         streamStop();
     }
 
-    RREG(GPIO);
     SDATAC();
     WREG(GPIO,0x80);
-    delay(100);
-    RREG(GPIO);
 
     // Restart stream if need be
     if (wasStreaming)
@@ -1857,11 +2983,8 @@ void Brainwear::turnOnLED(void)
         streamStop();
     }
 
-    RREG(GPIO);
     SDATAC();
     WREG(GPIO,0x00);
-    delay(100);
-    RREG(GPIO);
 
     // Restart stream if need be
     if (wasStreaming)
@@ -1911,6 +3034,7 @@ void Brainwear::START(void)
     digitalWrite(CS, LOW);
     SPI0->transfer(_START);
     digitalWrite(CS, HIGH);
+    delayMicroseconds(3); //must wait 4 tCLK cycles before sending another command (Datasheet, pg. 40)
 }
 
 void Brainwear::STOP(void)
@@ -1918,6 +3042,7 @@ void Brainwear::STOP(void)
     digitalWrite(CS, LOW);
     SPI0->transfer(_STOP);
     digitalWrite(CS, HIGH);
+    delayMicroseconds(3); //must wait 4 tCLK cycles before sending another command (Datasheet, pg. 40)
 }
 
 void Brainwear::RDATAC(void)
@@ -1994,6 +3119,40 @@ void Brainwear::RREG(byte _address, byte _numRegistersMinusOne)
     digitalWrite(CS, HIGH); //High to end communication
 }
 
+/**
+ * @description Reads _count registers from _address into values, in one command
+ */
+void Brainwear::RREG(byte _address, byte _count, byte *values)
+{
+    digitalWrite(CS, LOW);
+    SPI0->transfer(_SDATAC);
+    SPI0->transfer(_RREG + _address);
+    SPI0->transfer(_count - 1);
+    for (byte i = 0; i < _count; i++)
+    {
+        values[i] = SPI0->transfer(0x00);
+    }
+    digitalWrite(CS, HIGH);
+}
+
+/**
+ * @description Writes _count registers from _address, in one command
+ */
+void Brainwear::WREG(byte _address, const byte *values, byte _count)
+{
+    digitalWrite(CS, LOW);
+    SPI0->transfer(_SDATAC);
+    SPI0->transfer(_WREG + _address);
+    SPI0->transfer(_count - 1);
+    for (byte i = 0; i < _count; i++)
+    {
+        SPI0->transfer(values[i]);
+        adsRegisters[_address + i] = values[i];
+        bitSet(adsWritten, _address + i);
+    }
+    digitalWrite(CS, HIGH);
+}
+
 void Brainwear::WREG(byte _address, byte _value)
 {
     byte opcode1 = _WREG + _address; //010rrrrr; _WREG = 01000000 and _address = rrrrr
@@ -2002,6 +3161,8 @@ void Brainwear::WREG(byte _address, byte _value)
     SPI0->transfer(opcode1);          //  opcode1
     SPI0->transfer(0x00);             //  opcode2 Read only one register
     SPI0->transfer(_value);          //  Value to write
+    adsRegisters[_address] = _value;  //  kept for verifyRegisters
+    bitSet(adsWritten, _address);
     if (verbosity)
     { //  verbosity output
         Serial.print("Register ");
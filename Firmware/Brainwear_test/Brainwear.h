@@ -7,31 +7,73 @@
 
 #include <Arduino.h>
 #include "Brainwear_definitions.h"
+#include "Brainwear_frame.h"
+#include "Brainwear_histogram.h"
+#include "Brainwear_montage.h"
 #include "SPI.h"
 
 void IRAM_ATTR ADS_DRDY_Service(void); //Interrupt service for ESP32
 
+typedef ADSFrame<ADS_CHANNELS_BOARD, ADS_BYTES_PER_CHAN> BoardFrame; // frame of the ADS1299 on the board
+
+/** Configuration kept in the EEPROM at EEPROM_CONFIG and restored at boot */
+typedef struct {
+    uint8_t key;                // EEPROM_CONFIG_KEY
+    uint8_t version;            // EEPROM_CONFIG_VERSION
+    uint8_t sampleRate;         // SAMPLE_RATE
+    uint8_t serialDecimation;   // samples averaged for each serial packet
+    uint8_t serialBytes;        // bytes of each channel sample in the serial packets
+    uint8_t serialShift[ADS_NUM_CHANNELS];  // right shift of each channel in the serial packets
+    uint8_t featureMode;        // ADS_FEATURES_OFF, ADS_FEATURES_ON or ADS_FEATURES_ONLY
+    uint8_t impedanceMode;      // ADS_IMPEDANCE_OFF, ADS_IMPEDANCE_ON or ADS_IMPEDANCE_ONLY
+    uint8_t mmgOutputs;         // MMG_OUTPUT_RAW, MMG_OUTPUT_ENVELOPE and MMG_OUTPUT_RMS bits
+    uint8_t mmgEventMode;       // ADS_MMG_EVENTS_OFF, ADS_MMG_EVENTS_ON or ADS_MMG_EVENTS_ONLY
+    uint8_t artifactMode;       // ADS_ARTIFACTS_OFF or ADS_ARTIFACTS_ON
+    uint8_t montage;            // MONTAGE_ mode
+    uint8_t montageTermCount;   // terms of the custom montage
+    MontageTerm montageTerms[MONTAGE_MAX_TERMS];
+    uint8_t mainsMode;          // ADS_MAINS_OFF, ADS_MAINS_50HZ or ADS_MAINS_60HZ
+    uint8_t streaming;          // the stream was running, it starts again at boot
+    uint8_t boardUseSRB1;
+    uint8_t channelSettings[ADS_NUM_CHANNELS][NUMBER_OF_CHANNEL_SETTINGS];
+    uint8_t leadOffSettings[ADS_NUM_CHANNELS][NUMBER_OF_LEAD_OFF_SETTINGS];
+    uint8_t useInBias[ADS_NUM_CHANNELS];
+    uint8_t registers[ADS_REGISTERS];  // register map of the ADS1299
+    uint16_t crc;               // sdCrc16 of the fields above
+} BrainwearConfig;
+
 class Brainwear {
 public:
     Brainwear();
 
     //ENUMS
     /**How to send data*/
-    typedef enum TX_MODE{
+    enum TX_MODE {
         DATA_RAW,
         DATA_ASCII
     };
 
     /**Commands with multiple characters*/
-    typedef enum MULTI_CHAR_COMMAND {
+    enum MULTI_CHAR_COMMAND {
         MULTI_CHAR_CMD_NONE,
         MULTI_CHAR_CMD_PROCESSING_INCOMING_SETTINGS_CHANNEL,
         MULTI_CHAR_CMD_PROCESSING_INCOMING_SETTINGS_LEADOFF,
-        MULTI_CHAR_CMD_SETTINGS_SAMPLE_RATE
+        MULTI_CHAR_CMD_SETTINGS_SAMPLE_RATE,
+        MULTI_CHAR_CMD_SETTINGS_SERIAL_DECIMATION,
+        MULTI_CHAR_CMD_SETTINGS_SERIAL_WIDTH,
+        MULTI_CHAR_CMD_SETTINGS_SERIAL_SHIFT,
+        MULTI_CHAR_CMD_SETTINGS_FEATURES,
+        MULTI_CHAR_CMD_SETTINGS_IMPEDANCE,
+        MULTI_CHAR_CMD_SETTINGS_MMG_OUTPUTS,
+        MULTI_CHAR_CMD_SETTINGS_MMG_EVENTS,
+        MULTI_CHAR_CMD_SETTINGS_ARTIFACTS,
+        MULTI_CHAR_CMD_SETTINGS_MONTAGE,
+        MULTI_CHAR_CMD_SETTINGS_MONTAGE_ROW,
+        MULTI_CHAR_CMD_SETTINGS_MAINS
     };
 
     /**Sample rate to send data*/
-    typedef enum SAMPLE_RATE {
+    enum SAMPLE_RATE {
         SAMPLE_RATE_16000,
         SAMPLE_RATE_8000,
         SAMPLE_RATE_4000,
@@ -41,7 +83,7 @@ public:
         SAMPLE_RATE_250
     };
 
-    // SPI to communicate with the ADS1299
+    // SPI to communicate with the ADS1299, in the arena
     SPIClass *SPI0 = NULL;
 
     //Functions
@@ -52,38 +94,68 @@ public:
     void beginBoard(void);
     void beginSerial(uint32_t);
     void beginSPI(void);
-    void boardReset(void);
+    void boardReset(boolean restore = false);
     void changeChannelLeadOffDetect(void);
     void changeChannelLeadOffDetect(byte);
     boolean checkMultiCharCmdTimer(void);
+    void clearConfig(void);
     void configureInternalTestSignal(byte, byte);
     void configureLeadOffDetection(byte, byte);
     void deactivateChannel(byte);
+    boolean decimateChannelData(void);
     void endMultiCharCmdTimer(void);
+    byte getActiveChannels(void);
     char getChannelCommandForAsciiChar(char);
+    byte getChannelGain(byte);
     byte getDefaultChannelSettingForSetting(byte);
     char getDefaultChannelSettingForSettingAscii(byte);
     char getGainForAsciiChar(char);
+    byte getLeadOffChannels(void);
+    float getLeadOffCurrent(void);
+    float getLeadOffFrequencyHz(void);
+    unsigned int getMainsFrequencyHz(void);
     char getMultiCharCommand(void);
     char getNumberForAsciiChar(char);
+    byte getPacketMMGOutputs(void);
     const char* getSampleRate(void);
+    unsigned int getSampleRateHz(void);
+    byte getSerialDecimation(void);
+    boolean loadConfig(BrainwearConfig *);
     void loop(void);
+    void measureLatency(void);
+    void measureLatency(uint32_t);
     void normalInputSignal(void);
     void printRegisterName(byte);
     void printHex(byte);
+    void printLatencyReport(void);
     boolean processChar(char);
+    void processIncomingArtifactMode(char);
     void processIncomingChannelSettings(char);
+    void processIncomingFeatureMode(char);
+    void processIncomingImpedanceMode(char);
     void processIncomingLeadOffSettings(char);
+    void processIncomingMMGEventMode(char);
+    void processIncomingMMGOutputs(char);
+    void processIncomingMainsMode(char);
+    void processIncomingMontage(char);
+    void processIncomingMontageRow(char);
     void processIncomingSampleRate(char);
+    void processIncomingSerialDecimation(char);
+    void processIncomingSerialShift(char);
+    void processIncomingSerialWidth(char);
     void readRegisters(void);
     void reportDefaultChannelSettings(void);
     void resetADS(void);
+    boolean restoreConfig(void);
+    void saveConfig(boolean);
     void sendChannelData(void);
     void sendChannelData(TX_MODE);
     void sendEOT(void);
+    void sendStreamHeader(void);
     void setChannelsToDefault(void);
     void setCurTxMode(TX_MODE);
     void setSampleRate(uint8_t);
+    void setSerialDecimation(byte);
     void startADS(void);
     void startMultiCharCmdTimer(char);
     void stopADS(void);
@@ -119,15 +191,40 @@ public:
     boolean useInBias[ADS_NUM_CHANNELS];        // used to remember if we were included in Bias before channel power down
     volatile boolean channelDataAvailable;
 
-    byte sampleCounter;
-    byte boardChannelDataRaw[ADS_BYTES_PER_ADS_SAMPLE];    // array to hold raw channel data
-    byte meanBoardDataRaw[ADS_BYTES_PER_ADS_SAMPLE];       // mean raw
+    // Timing of the samples, in cycles of the CPU
+    volatile uint32_t drdyCycles;       // time of the last DRDY interrupt
+    volatile uint32_t drdyCount;        // DRDY interrupts since the stream started
+    uint32_t sampleDrdyCycles;          // DRDY time of the sample being processed
+    uint32_t cyclesPerMicro;
+    uint32_t cyclesPerByte;             // time of one byte on the serial port
+    Histogram drdyInterval;             // us between consecutive DRDY interrupts
+    Histogram drdyLatency;              // us from DRDY to the last byte of the packet on the wire
 
-    byte boardData[27];
+    byte sampleCounter;                                    // counter of the packets sent to the serial port
+    byte serialDecimation;                                 // samples averaged for each serial packet
+    byte serialBytes;                                      // bytes of each channel sample in the serial packets
+    byte serialShift[ADS_NUM_CHANNELS];                    // right shift of each channel in the serial packets
+    byte activeChannels;                                   // channels powered up when the stream started, ADS_ALL_CHANNELS mask
+    byte featureMode;                                      // band power packets, ADS_FEATURES_OFF, _ON or _ONLY
+    byte impedanceMode;                                    // impedance packets, ADS_IMPEDANCE_OFF, _ON or _ONLY
+    byte mmgOutputs;                                       // MMG values in the packets and SD files, MMG_OUTPUT_ bits
+    byte mmgEventMode;                                     // MMG event packets, ADS_MMG_EVENTS_OFF, _ON or _ONLY
+    byte artifactMode;                                     // artifact flags in the packets and SD files, ADS_ARTIFACTS_OFF or _ON
+    byte montage;                                          // montage of the EEG channels, MONTAGE_ mode
+    byte montageTermCount;                                 // terms of the custom montage
+    MontageTerm montageTerms[MONTAGE_MAX_TERMS];           // rows of the custom montage, set with ADS_MONTAGE_ROW_SET
+    byte mainsMode;                                        // mains canceller of the EEG and MMG channels, ADS_MAINS_OFF, _50HZ or _60HZ
+    byte leadOffChannels;                                  // active channels with lead-off enabled when the stream started
+    byte leadOffExcitation;                                // current and frequency bits of the LOFF register
+    byte boardFrame[BoardFrame::FRAME_BYTES];             // last frame read from the ADS1299
+    byte boardChannelDataRaw[BoardFrame::DATA_BYTES];     // array to hold raw channel data
+    byte serialChannelDataRaw[BoardFrame::DATA_BYTES];    // averaged raw data sent to the serial port
+    byte meanBoardDataRaw[BoardFrame::DATA_BYTES];        // mean raw
 
-    int boardChannelDataInt[ADS_BYTES_PER_ADS_SAMPLE];    // array used when reading channel data as ints
-    int lastBoardChannelDataInt[ADS_BYTES_PER_ADS_SAMPLE]; //Keep the last values of the data
-    int meanBoardChannelDataInt[ADS_BYTES_PER_ADS_SAMPLE];
+    int32_t boardChannelDataInt[BoardFrame::CHANNELS];     // array used when reading channel data as ints
+    int32_t lastBoardChannelDataInt[BoardFrame::CHANNELS]; //Keep the last values of the data
+    int32_t meanBoardChannelDataInt[BoardFrame::CHANNELS];
+    int32_t serialChannelDataInt[BoardFrame::CHANNELS];    // averaged data sent to the serial port
 
     //Settings
     byte leadOffSettings[ADS_NUM_CHANNELS][NUMBER_OF_LEAD_OFF_SETTINGS];  // used to control on/off of impedance measure for P and N side of each channel
@@ -153,25 +250,46 @@ private:
     void RESET(void);
     void sendChannelDataSerial_Raw(void);
     void sendChannelDataSerial_Ascii(void);
+    void packSerialData(void);
+    boolean serialFormatIsDefault(void);
+    void serialFormatChanged(void);
+    void printMMGOutputs(void);
+    void printMontage(void);
+    void printSerialFormat(void);
     void START(void);
     void STOP(void);
     void RDATAC(void);
     void SDATAC(void);
     byte RREG(byte);
     void RREG(byte, byte);
+    void RREG(byte, byte, byte *);
+    boolean verifyRegisters(void);
+    boolean waitForDevice(void);
     void WREG(byte, byte);
+    void WREG(byte, const byte *, byte);
 
     int  boardStat; // used to hold the status register
+    byte adsRegisters[ADS_REGISTERS]; // last value written to each register
+    uint32_t adsWritten;              // registers written since the last reset, one bit each
+    boolean restoredStreaming;        // the restored configuration was streaming
 
     //Variables
-    char currentChannelSetting;
+    byte currentChannelSetting;
     boolean isRunning;
     boolean isMultiCharCmd;  // A multi char command is in progress
     char multiCharCommand;  // The type of command
+    int8_t serialShiftChannel;  // channel of a serial shift command, -1 until it is received
+    int8_t montageRowChannel;   // output channel of a montage row command, -1 until it is received
+    int8_t montageRowSign;      // sign of the next term of the row, 0 until it is received
+    int8_t montageRowWeights[ADS_CHANNELS_BOARD];  // weight of each input in the row
+    byte frameBytes;            // bytes of the frame read from the ADS1299, up to the last active channel
+    boolean streamHeaderSent;   // the last stream header described other than the default packets
     unsigned long multiCharCmdTimeout;  // the timeout in millis of the current multi char command
     int numberOfIncomingSettingsProcessedChannel;
     int numberOfIncomingSettingsProcessedLeadOff;
     char optionalArgBuffer7[7];
+    long serialChannelSum[BoardFrame::CHANNELS]; // sum of the samples of the current serial packet
+    byte serialSumCount;                      // samples added to serialChannelSum
 };
 
 #endif //SOFTWARE_BRAINWEAR_H
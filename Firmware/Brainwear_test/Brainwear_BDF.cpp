@@ -0,0 +1,186 @@
+//
+// BioSemi Data Format (BDF) writer, see https://www.biosemi.com/faq/file_format.htm
+//
+
+#include "Brainwear_BDF.h"
+#include <stdio.h>
+#include <string.h>
+
+// Constructor
+BDF::BDF()
+{
+    numSignals = 0;
+    sampleRate = 250;
+    recordingId = "";
+    samplesInRecord = 0;
+}
+
+/**
+ * @description Starts a new file description. Signals have to be set afterwards with setSignal
+ */
+void BDF::begin(uint8_t signalCount, unsigned int rate, const char *id)
+{
+    numSignals = signalCount > BDF_MAX_SIGNALS ? BDF_MAX_SIGNALS : signalCount;
+    sampleRate = rate;
+    recordingId = id;
+    samplesInRecord = 0;
+    memset(lastSample, 0, sizeof(lastSample));
+}
+
+/**
+ * @description Describes one signal. Physical and digital ranges define the scaling used by the readers,
+ *  prefiltering is kept as a pointer until the header is written
+ */
+void BDF::setSignal(uint8_t signal, const char *label, const char *transducer, const char *dimension,
+                    long physicalMin, long physicalMax, long digitalMin, long digitalMax, const char *prefiltering)
+{
+    if (signal >= BDF_MAX_SIGNALS) return;
+    signals[signal].label = label;
+    signals[signal].transducer = transducer;
+    signals[signal].dimension = dimension;
+    signals[signal].physicalMin = physicalMin;
+    signals[signal].physicalMax = physicalMax;
+    signals[signal].digitalMin = digitalMin;
+    signals[signal].digitalMax = digitalMax;
+    signals[signal].prefiltering = prefiltering;
+}
+
+/**
+ * @description Size of the header: 256 bytes plus 256 bytes per signal
+ */
+unsigned int BDF::headerSize(void)
+{
+    return 256 * (numSignals + 1);
+}
+
+/**
+ * @description Size of one data record
+ */
+unsigned int BDF::recordSize(void)
+{
+    return numSignals * BDF_SAMPLES_PER_RECORD * BDF_BYTES_PER_SAMPLE;
+}
+
+/**
+ * @description Streams the header one byte at a time. Use -1 records while the length is unknown
+ */
+void BDF::writeHeader(void (*putByte)(uint8_t), long numRecords)
+{
+    putByte(0xFF);
+    writeText(putByte, "BIOSEMI", 7);
+    writeText(putByte, "X X X X", 80);              // local patient identification
+    writeText(putByte, recordingId, 80);            // local recording identification
+    writeText(putByte, "01.01.00", 8);              // start date, the board has no clock
+    writeText(putByte, "00.00.00", 8);              // start time
+    writeNumber(putByte, headerSize(), 8);
+    writeText(putByte, "24BIT", 44);
+    writeNumber(putByte, numRecords, 8);
+    writeDuration(putByte);
+    writeNumber(putByte, numSignals, 4);
+
+    for (uint8_t i = 0; i < numSignals; i++) writeText(putByte, signals[i].label, 16);
+    for (uint8_t i = 0; i < numSignals; i++) writeText(putByte, signals[i].transducer, 80);
+    for (uint8_t i = 0; i < numSignals; i++) writeText(putByte, signals[i].dimension, 8);
+    for (uint8_t i = 0; i < numSignals; i++) writeNumber(putByte, signals[i].physicalMin, 8);
+    for (uint8_t i = 0; i < numSignals; i++) writeNumber(putByte, signals[i].physicalMax, 8);
+    for (uint8_t i = 0; i < numSignals; i++) writeNumber(putByte, signals[i].digitalMin, 8);
+    for (uint8_t i = 0; i < numSignals; i++) writeNumber(putByte, signals[i].digitalMax, 8);
+    for (uint8_t i = 0; i < numSignals; i++) writeText(putByte, signals[i].prefiltering, 80);
+    for (uint8_t i = 0; i < numSignals; i++) writeNumber(putByte, BDF_SAMPLES_PER_RECORD, 8);
+    for (uint8_t i = 0; i < numSignals; i++) writeText(putByte, "", 32);   // reserved
+}
+
+/**
+ * @description Fills the 8 characters of the "number of data records" field
+ */
+void BDF::formatNumberOfRecords(char *field, long numRecords)
+{
+    char buf[BDF_RECORDS_FIELD_SIZE + 1];
+    snprintf(buf, sizeof(buf), "%ld", numRecords);
+    memset(field, ' ', BDF_RECORDS_FIELD_SIZE);
+    memcpy(field, buf, strlen(buf));
+}
+
+/**
+ * @description Adds one value per signal to the current record. Records are signal-major,
+ *  each value is stored as 24-bit little-endian two's complement.
+ * @returns true when the record is complete and can be read with getRecord
+ */
+bool BDF::addSample(const int32_t *values)
+{
+    for (uint8_t i = 0; i < numSignals; i++) {
+        uint8_t *dst = &record[(i * BDF_SAMPLES_PER_RECORD + samplesInRecord) * BDF_BYTES_PER_SAMPLE];
+        dst[0] = values[i] & 0xFF;
+        dst[1] = (values[i] >> 8) & 0xFF;
+        dst[2] = (values[i] >> 16) & 0xFF;
+        lastSample[i] = values[i];
+    }
+    samplesInRecord++;
+    if (samplesInRecord == BDF_SAMPLES_PER_RECORD) {
+        samplesInRecord = 0;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @description Completes a partial record repeating the last sample
+ * @returns true if there was a partial record to complete
+ */
+bool BDF::padRecord(void)
+{
+    if (samplesInRecord == 0) return false;
+    while (!addSample(lastSample));
+    return true;
+}
+
+/**
+ * @description The last completed record, recordSize() bytes
+ */
+const uint8_t *BDF::getRecord(void)
+{
+    return record;
+}
+
+/**
+ * @description Writes text left aligned and padded with spaces to width
+ */
+void BDF::writeText(void (*putByte)(uint8_t), const char *text, uint8_t width)
+{
+    uint8_t i = 0;
+    for (; i < width && text[i] != 0; i++) putByte(text[i]);
+    for (; i < width; i++) putByte(' ');
+}
+
+/**
+ * @description Writes a number as text field
+ */
+void BDF::writeNumber(void (*putByte)(uint8_t), long number, uint8_t width)
+{
+    char buf[12];
+    snprintf(buf, sizeof(buf), "%ld", number);
+    writeText(putByte, buf, width);
+}
+
+/**
+ * @description Writes the record duration, BDF_SAMPLES_PER_RECORD / sampleRate seconds.
+ *  All the sample rates are 16000 / 2^n so the decimal expansion is exact.
+ */
+void BDF::writeDuration(void (*putByte)(uint8_t))
+{
+    char buf[9];
+    unsigned long num = BDF_SAMPLES_PER_RECORD;
+    unsigned long den = sampleRate;
+    uint8_t n = snprintf(buf, sizeof(buf), "%lu", num / den);
+    num %= den;
+    if (num != 0 && n < 7) {
+        buf[n++] = '.';
+        while (num != 0 && n < 8) {
+            num *= 10;
+            buf[n++] = '0' + num / den;
+            num %= den;
+        }
+        buf[n] = 0;
+    }
+    writeText(putByte, buf, 8);
+}
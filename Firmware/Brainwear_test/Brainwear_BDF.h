@@ -0,0 +1,60 @@
+//
+// BioSemi Data Format (BDF) writer. Builds the header and the 24-bit data records.
+// It has no Arduino dependencies so the host tools can use it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_BDF_H
+#define SOFTWARE_BRAINWEAR_BDF_H
+
+#include <stdint.h>
+
+#define BDF_MAX_SIGNALS           29    // 4 ADS1299 channels + 8 MMG channels of each MMG output + artifact flags
+#define BDF_SAMPLES_PER_RECORD    50    // record length is 50 samples at any sample rate
+#define BDF_BYTES_PER_SAMPLE      3
+#define BDF_RECORDS_FIELD_OFFSET  236   // position of "number of data records" in the header
+#define BDF_RECORDS_FIELD_SIZE    8
+
+class BDF {
+public:
+    BDF();
+
+    void begin(uint8_t numSignals, unsigned int sampleRate, const char *recordingId);
+    void setSignal(uint8_t signal, const char *label, const char *transducer, const char *dimension,
+                   long physicalMin, long physicalMax, long digitalMin, long digitalMax, const char *prefiltering = "");
+
+    unsigned int headerSize(void);
+    unsigned int recordSize(void);
+    void writeHeader(void (*putByte)(uint8_t), long numRecords);
+    static void formatNumberOfRecords(char *field, long numRecords);
+
+    bool addSample(const int32_t *values);
+    bool padRecord(void);
+    const uint8_t *getRecord(void);
+
+    uint8_t numSignals;
+    unsigned int sampleRate;
+
+private:
+    typedef struct {
+        const char *label;
+        const char *transducer;
+        const char *dimension;
+        long physicalMin;
+        long physicalMax;
+        long digitalMin;
+        long digitalMax;
+        const char *prefiltering;
+    } Signal;
+
+    void writeText(void (*putByte)(uint8_t), const char *text, uint8_t width);
+    void writeNumber(void (*putByte)(uint8_t), long number, uint8_t width);
+    void writeDuration(void (*putByte)(uint8_t));
+
+    const char *recordingId;
+    Signal signals[BDF_MAX_SIGNALS];
+    int32_t lastSample[BDF_MAX_SIGNALS];
+    unsigned int samplesInRecord;
+    uint8_t record[BDF_MAX_SIGNALS * BDF_SAMPLES_PER_RECORD * BDF_BYTES_PER_SAMPLE];
+};
+
+#endif //SOFTWARE_BRAINWEAR_BDF_H
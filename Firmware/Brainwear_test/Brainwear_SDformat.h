@@ -0,0 +1,144 @@
+//
+// Binary layout of the SD recording files. Shared with the host tools in Brainwear_tools.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_SDFORMAT_H
+#define SOFTWARE_BRAINWEAR_SDFORMAT_H
+
+#include <stdint.h>
+
+/**
+ * Every recording is a contiguous file of BLOCK_COUNT blocks:
+ *
+ *  | data blocks ... | index blocks ... | commit blocks ... | super block |
+ *
+ * The data blocks hold the sample stream. The index blocks hold one SDIndexEntry every
+ * SD_INDEX_INTERVAL samples, so entry n always describes sample n * SD_INDEX_INTERVAL.
+ * Every SD_COMMIT_INTERVAL data blocks an SDCommit is appended to the commit blocks, with the
+ * progress of the recording and the CRC of each data block since the previous commit.
+ * The super block is the last block of the file and describes where everything is. It is
+ * only marked closed on a clean close, otherwise the last valid commit tells what was written.
+ */
+#define SD_BLOCK_SIZE          512
+#define SD_SUPER_MAGIC         0x46445742UL  // "BWDF"
+#define SD_FORMAT_VERSION      5             // 2 added SDSuperBlock.channels, 3 SDSuperBlock.mmgOutputs, 4 .artifacts, 5 .montage
+#define SD_INDEX_INTERVAL      256           // samples between index entries
+#define SD_INDEX_BLOCK_RATIO   256           // one index block for each 256 file blocks (records >= 16 bytes)
+#define SD_INDEX_TAG           0x1DE5        // marks an index entry that has been written
+#define SD_INDEX_PER_BLOCK     (SD_BLOCK_SIZE / sizeof(SDIndexEntry))
+#define SD_COMMIT_MAGIC        0x544D4342UL  // "BCMT"
+#define SD_COMMIT_INTERVAL     32            // data blocks between commits
+#define SD_COMMIT_MAX_CRCS     238           // CRCs that fit in a commit block
+#define SD_MONTAGE_TERMS       16            // MONTAGE_MAX_TERMS of Brainwear_montage.h
+
+// Layout of the sample stream
+#define SD_FORMAT_TXT          0             // one line of hex values per sample
+#define SD_FORMAT_BDF          1             // BioSemi BDF, header and 24-bit records. Truncated on close
+#define SD_FORMAT_RICE         2             // compressed blocks of samples, see Brainwear_codec.h
+
+// Text lines and BDF records hold the EEG channels of SDSuperBlock.channels only, the channels
+// powered down when the file was opened are left out, then the MMG channels of each output of
+// SDSuperBlock.mmgOutputs (raw, envelope, RMS), then with SDSuperBlock.artifacts the artifact flags of
+// the EEG channels (Brainwear_artifact.h), 24 bits. The compressed blocks hold the raw MMG samples.
+// Every format holds the EEG channels of the montage of SDSuperBlock.montage (Brainwear_montage.h),
+// the one set when the file was opened (a later change is not recorded).
+// In SD_FORMAT_RICE every record is a coded block preceded by its size, little endian, and each
+// block has its own mask of EEG channels (the active channels of the stream). A size of 0
+// ends the stream. Index entry n points to the record holding sample n * SD_INDEX_INTERVAL and
+// its sample field is the first sample of that record.
+#define SD_RECORD_LENGTH_BYTES 2
+
+typedef struct {
+    uint32_t sample;    // sequence number of the sample, counted from the file start
+    uint32_t millis;    // millis() when the sample was stored
+    uint32_t block;     // data block where the sample record starts
+    uint16_t offset;    // byte offset of the record inside that block
+    uint16_t tag;       // SD_INDEX_TAG once written
+} SDIndexEntry;
+
+typedef struct {
+    uint32_t magic;         // SD_SUPER_MAGIC
+    uint16_t version;       // SD_FORMAT_VERSION
+    uint16_t closed;        // 1 once the file was closed properly
+    uint32_t blockCount;    // blocks in the file, super block included
+    uint32_t dataBlocks;    // blocks reserved for the sample stream
+    uint32_t indexStart;    // first index block
+    uint32_t indexBlocks;   // blocks reserved for the index
+    uint32_t indexInterval; // samples between index entries
+    uint32_t sampleRate;    // Hz
+    uint32_t usedBlocks;    // data blocks written, valid when closed
+    uint32_t indexEntries;  // index entries written, valid when closed
+    uint32_t totalSamples;  // samples written, valid when closed
+    uint32_t format;        // SD_FORMAT_TXT, SD_FORMAT_BDF or SD_FORMAT_RICE
+    uint32_t commitStart;   // first commit block
+    uint32_t commitBlocks;  // blocks reserved for commits
+    uint32_t commitInterval;// data blocks between commits
+    uint32_t channels;      // EEG channels stored, bit n for channel n + 1. 0 in version 1: all of them
+    uint32_t mmgOutputs;    // MMG values of the text lines and BDF records, MMG_OUTPUT_ bits. 0 before version 3: raw
+    uint32_t artifacts;     // 1 when the text lines and BDF records end with the artifact flags. 0 before version 4
+    uint32_t montage;       // MONTAGE_ mode of the EEG channels. 0 before version 5: as measured
+    uint32_t montageTerms;  // terms of montageTerm, with MONTAGE_CUSTOM
+    uint8_t montageTerm[SD_MONTAGE_TERMS][2];   // output << 4 | input and the weight (signed) of each term
+} SDSuperBlock;
+
+typedef struct {
+    uint32_t magic;         // SD_COMMIT_MAGIC
+    uint32_t sequence;      // commit n is stored in block commitStart + n
+    uint32_t usedBlocks;    // data blocks written
+    uint32_t indexEntries;  // index entries written
+    uint32_t totalSamples;  // samples written
+    uint32_t millis;        // millis() of the commit
+    uint32_t firstBlock;    // data block of crc[0]
+    uint16_t numCrc;        // data blocks covered by this commit
+    uint16_t reserved;
+    uint16_t crc[SD_COMMIT_MAX_CRCS];  // sdCrc16 of each data block
+    uint16_t commitCrc;     // sdCrc16 of all the fields above
+    uint16_t reserved2;
+} SDCommit;
+
+/**
+ * The sessions recorded on a card are listed in SD_CATALOG_NAME, in the root directory:
+ *
+ *  | SDCatalogHeader | SDCatalogRecord 0 | SDCatalogRecord 1 | ...
+ *
+ * Recordings are named with their session number in hex (0000002A.TXT, 0000002B.BDF), numbers
+ * only increase so a recording is never overwritten. nextNumber gives the next name without
+ * searching the card.
+ */
+#define SD_CATALOG_NAME        "SESSIONS.CAT"
+#define SD_CATALOG_MAGIC       0x54414342UL  // "BCAT"
+#define SD_CATALOG_VERSION     1
+
+typedef struct {
+    uint32_t magic;         // SD_CATALOG_MAGIC
+    uint32_t version;       // SD_CATALOG_VERSION
+    uint32_t nextNumber;    // number of the next session
+    uint32_t sessions;      // records in the catalog
+} SDCatalogHeader;
+
+typedef struct {
+    uint32_t number;        // session number, also the file name
+    uint32_t blockCount;    // blocks reserved for the file
+    uint32_t totalSamples;  // samples written, valid when closed
+    uint16_t sampleRate;    // Hz
+    uint8_t format;         // SD_FORMAT_TXT, SD_FORMAT_BDF or SD_FORMAT_RICE
+    uint8_t closed;         // 1 once the file was closed properly
+} SDCatalogRecord;
+
+/**
+ * CRC-16/CCITT-FALSE, used for the data blocks and the commits. Pass 0xFFFF as crc to start.
+ */
+static inline uint16_t sdCrc16(const uint8_t *data, uint32_t length, uint16_t crc)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+    };
+    for (uint32_t i = 0; i < length; i++) {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0x0F)];
+    }
+    return crc;
+}
+
+#endif //SOFTWARE_BRAINWEAR_SDFORMAT_H
@@ -0,0 +1,55 @@
+//
+// Static arena of the firmware buffers, see Brainwear_arena.h
+//
+
+#include "Brainwear_arena.h"
+#include <Arduino.h>
+#include <stdlib.h>
+
+static uint8_t arenaMemory[ARENA_SIZE] __attribute__((aligned(ARENA_ALIGN)));
+Arena arena;
+
+/**
+ * @description Takes size bytes aligned to align (a power of two) from the arena
+ * @returns the memory, zeroed. When it does not fit the report is printed and the firmware aborts
+ */
+void *Arena::allocate(size_t size, size_t align, const char *name)
+{
+    size_t start = (used + align - 1) & ~(align - 1);
+    if (start + size > ARENA_SIZE) {
+        failed += size;
+        Serial.print("Arena full, "); Serial.print(name); Serial.print(" needs "); Serial.print((uint32_t) size);
+        Serial.print(" bytes, "); Serial.print((uint32_t) (ARENA_SIZE - used)); Serial.println(" free");
+        report();
+        Serial.flush();
+        abort();    // every caller uses its buffer right away, a NULL would crash later and less clearly
+    }
+    if (numEntries < ARENA_ENTRIES) {
+        entries[numEntries].name = name;
+        entries[numEntries].size = size;
+        numEntries++;
+    }
+    used = start + size;
+    return &arenaMemory[start];
+}
+
+/**
+ * @description Prints the allocations of the arena and the high-water marks of the heap and of
+ *  the stack of the loop task
+ */
+void Arena::report(void)
+{
+    Serial.println("Arena:");
+    for (uint8_t i = 0; i < numEntries; i++) {
+        Serial.print("  "); Serial.print(entries[i].name); Serial.print(": "); Serial.println((uint32_t) entries[i].size);
+    }
+    Serial.print("  used "); Serial.print((uint32_t) used); Serial.print(" of "); Serial.print((uint32_t) ARENA_SIZE);
+    Serial.print(" bytes, "); Serial.print((uint32_t) (ARENA_SIZE - used)); Serial.println(" free");
+    if (failed > 0) {
+        Serial.print("  missing "); Serial.print((uint32_t) failed); Serial.println(" bytes, increase ARENA_SIZE");
+    }
+    Serial.print("Heap: "); Serial.print(ESP.getFreeHeap()); Serial.print(" bytes free, lowest ");
+    Serial.println(ESP.getMinFreeHeap());
+    Serial.print("Loop stack: lowest free "); Serial.print((uint32_t) uxTaskGetStackHighWaterMark(NULL));
+    Serial.println(" bytes");
+}
@@ -0,0 +1,64 @@
+//
+// Static arena for the buffers of the acquisition path. Every buffer and device object is carved
+// from one array of ARENA_SIZE bytes during setup() and lives until the next reset, nothing is
+// freed, so there is no fragmentation and the RAM cost of a deeper queue or a bigger buffer shows
+// in the memory report (ADS_MEMORY_REPORT) instead of as a failure at run time.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_ARENA_H
+#define SOFTWARE_BRAINWEAR_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+#define ARENA_SIZE      21504   // bytes, increase when the report shows the arena full
+#define ARENA_ALIGN     16      // bytes, default alignment of the allocations
+#define ARENA_ENTRIES   20      // allocations kept by name for the report
+
+/**
+ * The arena has no constructor and its storage is static, so it is already zero (empty) when
+ * the global constructors run. Allocations are bump allocations and never return NULL: one that
+ * does not fit prints the memory report and stops the firmware, at boot, before any buffer is used.
+ */
+class Arena {
+public:
+    void *allocate(size_t size, size_t align, const char *name);
+    void report(void);
+
+    /**
+     * @description Builds an object of type T in the arena with placement new
+     * @returns the object
+     */
+    template <typename T, typename... Args>
+    T *create(const char *name, Args... args)
+    {
+        void *memory = allocate(sizeof(T), alignof(T), name);
+        return memory != NULL ? new (memory) T(args...) : NULL;
+    }
+
+    /**
+     * @description Array of count elements of type T, zeroed
+     */
+    template <typename T>
+    T *createArray(size_t count, const char *name)
+    {
+        return (T *) allocate(sizeof(T) * count, alignof(T) > ARENA_ALIGN ? alignof(T) : ARENA_ALIGN, name);
+    }
+
+    size_t used;        // bytes allocated, padding included
+    size_t failed;      // bytes requested that did not fit
+
+private:
+    struct Entry {
+        const char *name;
+        size_t size;
+    };
+
+    Entry entries[ARENA_ENTRIES];
+    uint8_t numEntries;
+};
+
+extern Arena arena;
+
+#endif //SOFTWARE_BRAINWEAR_ARENA_H
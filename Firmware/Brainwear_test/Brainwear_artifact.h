@@ -0,0 +1,105 @@
+//
+// Artifact flags of the EEG channels, one check per sample and channel: a sample near the full scale
+// of the ADC (±VREF / gain is ±2^23 counts at any gain, so the ADC or the amplifier is about to
+// saturate), a step from the previous sample larger than the EEG can make (an electrode pop) and a
+// distance to a slow baseline larger than the EEG (a blink, a movement). The limits of the last two
+// are in uV, converted to counts with the gain of each channel. The flags of a sample are packed in
+// one word, a mask of the channels for each kind. It has no Arduino dependencies so the host build
+// checks it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_ARTIFACT_H
+#define SOFTWARE_BRAINWEAR_ARTIFACT_H
+
+#include <stdint.h>
+
+#define ARTIFACT_FULL_SCALE     8388608L    // counts of +VREF / gain
+#define ARTIFACT_SATURATION     (ARTIFACT_FULL_SCALE / 16 * 15)  // counts, 15/16 of the full scale
+#define ARTIFACT_STEP_UV        250     // change between two samples of an electrode pop
+#define ARTIFACT_TRANSIENT_UV   150     // distance to the baseline of a blink or a movement
+#define ARTIFACT_RATE_HZ        250     // the board rates are 250 * 2^n
+#define ARTIFACT_BASELINE_SHIFT 8       // the baseline follows the signal with a time constant of 2^8 samples at 250 Hz, 1 s
+
+// Position of the channel mask of each kind in the flags, bit c of a mask for channel c
+#define ARTIFACT_SATURATED      0
+#define ARTIFACT_STEP           8
+#define ARTIFACT_TRANSIENT      16
+#define ARTIFACT_BYTES          3       // bytes of the flags, one mask per kind
+
+/**
+ * Artifact flags of Channels channels. setLimits() takes the gains and the sample rate, check()
+ * every sample of the board
+ */
+template <uint8_t Channels>
+class ArtifactDetector {
+public:
+    ArtifactDetector()
+    {
+        uint8_t gains[Channels];
+        for (uint8_t c = 0; c < Channels; c++) gains[c] = 24;
+        sampleRate = 0;
+        setLimits(ARTIFACT_RATE_HZ, gains);
+    }
+
+    /**
+     * @description Limits of the channels with gains (1 to 24) for a stream at sampleRateHz. A new
+     *  sample rate starts the detector again
+     */
+    void setLimits(uint16_t sampleRateHz, const uint8_t *gains)
+    {
+        for (uint8_t c = 0; c < Channels; c++) {
+            // one count is 4.5 V / gain / 2^23
+            stepLimit[c] = (int32_t) ((int64_t) ARTIFACT_STEP_UV * gains[c] * ARTIFACT_FULL_SCALE / 4500000);
+            transientLimit[c] = (int32_t) ((int64_t) ARTIFACT_TRANSIENT_UV * gains[c] * ARTIFACT_FULL_SCALE / 4500000);
+        }
+        if (sampleRateHz != sampleRate) {
+            sampleRate = sampleRateHz;
+            baselineShift = ARTIFACT_BASELINE_SHIFT;
+            for (uint16_t rate = ARTIFACT_RATE_HZ; rate < sampleRateHz; rate <<= 1) baselineShift++;
+            started = false;
+        }
+    }
+
+    /**
+     * @description Flags of the sample number sample of the channels of mask. A sample that does
+     *  not follow the last one (a new stream) starts the detector again
+     * @returns the flags, a mask of the channels at ARTIFACT_SATURATED, ARTIFACT_STEP and ARTIFACT_TRANSIENT
+     */
+    uint32_t check(const int32_t *values, uint8_t mask, uint32_t sample)
+    {
+        if (!started || sample != nextSample) {
+            for (uint8_t c = 0; c < Channels; c++) {
+                last[c] = values[c];
+                baseline[c] = (int64_t) values[c] << 16;
+            }
+            started = true;
+        }
+        nextSample = sample + 1;
+        uint32_t flags = 0;
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (!(mask & (1 << c))) continue;
+            int32_t x = values[c];
+            int32_t step = x - last[c];
+            int32_t distance = x - (int32_t) (baseline[c] >> 16);
+            if (x >= ARTIFACT_SATURATION || x <= -ARTIFACT_SATURATION) flags |= 1UL << (ARTIFACT_SATURATED + c);
+            if (step > stepLimit[c] || step < -stepLimit[c]) flags |= 1UL << (ARTIFACT_STEP + c);
+            if (distance > transientLimit[c] || distance < -transientLimit[c]) flags |= 1UL << (ARTIFACT_TRANSIENT + c);
+            baseline[c] += (((int64_t) x << 16) - baseline[c]) >> baselineShift;
+            last[c] = x;
+        }
+        return flags;
+    }
+
+    uint16_t sampleRate;            // of the samples given to check
+
+private:
+    int32_t stepLimit[Channels];        // counts
+    int32_t transientLimit[Channels];   // counts
+    int64_t baseline[Channels];         // slow mean of each channel, 16 fraction bits
+    int32_t last[Channels];             // previous sample
+    uint8_t baselineShift;
+    uint32_t nextSample;
+    bool started;
+};
+
+#endif //SOFTWARE_BRAINWEAR_ARTIFACT_H
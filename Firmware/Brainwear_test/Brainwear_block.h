@@ -0,0 +1,149 @@
+//
+// Store of the samples in blocks: BLOCK_FRAMES frames of every channel in contiguous, aligned,
+// channel-major arrays, EEG and MMG side by side. Stages that work on whole blocks (filters,
+// compressors, packet builders) run one tight loop per channel instead of one call per sample.
+// It has no Arduino dependencies so the host tools and benchmarks use it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_BLOCK_H
+#define SOFTWARE_BRAINWEAR_BLOCK_H
+
+#include <stdint.h>
+
+#define BLOCK_FRAMES  32    // frames per block, a multiple of 4
+#define BLOCK_ALIGN   16    // bytes, alignment of every channel array
+
+template <uint8_t EEGChannels, uint8_t MMGChannels, uint16_t Frames>
+struct SampleBlock {
+    int32_t eeg[EEGChannels][Frames] __attribute__((aligned(BLOCK_ALIGN)));
+    int16_t mmg[MMGChannels][Frames] __attribute__((aligned(BLOCK_ALIGN)));
+    uint32_t firstSample;   // number of frame 0, counted from the start of the stream
+    uint16_t frames;        // frames stored
+    bool mmgValid;          // every frame of the block has MMG values
+};
+
+/**
+ * Two blocks used in turn. Ownership:
+ *  - the writer (the acquisition in loop()) fills the current block one frame at a time:
+ *    addEEG and addMMG, then commit. commit returns the block once it is full.
+ *  - from then on the block belongs to the reader, which keeps it while the writer fills the
+ *    other block, BLOCK_FRAMES sample periods, and gives it back with release.
+ *  - the writer never waits: if the reader still holds the block it needs, the block is taken
+ *    back and overruns is incremented. The acquisition cannot be stalled by a slow stage.
+ */
+template <uint8_t EEGChannels, uint8_t MMGChannels, uint16_t Frames>
+class BlockStore {
+public:
+    typedef SampleBlock<EEGChannels, MMGChannels, Frames> Block;
+
+    BlockStore() { reset(); }
+
+    /**
+     * @description Empties the store, at the start of a stream
+     */
+    void reset(void)
+    {
+        writing = 0;
+        held[0] = held[1] = false;
+        nextSample = 0;
+        completed = 0;
+        overruns = 0;
+        startBlock();
+    }
+
+    /**
+     * @description EEG values of the current frame, EEGChannels of them
+     */
+    void addEEG(const int32_t *values)
+    {
+        Block &block = blocks[writing];
+        for (uint8_t c = 0; c < EEGChannels; c++) block.eeg[c][block.frames] = values[c];
+    }
+
+    /**
+     * @description MMG values of the current frame, count channels starting at first
+     */
+    void addMMG(uint8_t first, const int16_t *values, uint8_t count)
+    {
+        Block &block = blocks[writing];
+        for (uint8_t c = 0; c < count && first + c < MMGChannels; c++) block.mmg[first + c][block.frames] = values[c];
+        mmgInFrame += count;
+    }
+
+    /**
+     * @description Ends the current frame
+     * @returns the block when it is full, it then belongs to the reader. NULL otherwise
+     */
+    Block *commit(void)
+    {
+        Block &block = blocks[writing];
+        if (mmgInFrame < MMGChannels) {
+            for (uint8_t c = 0; c < MMGChannels; c++) block.mmg[c][block.frames] = 0;
+            block.mmgValid = false;
+        }
+        mmgInFrame = 0;
+        nextSample++;
+        if (++block.frames < Frames) return NULL;
+        return handOver();
+    }
+
+    /**
+     * @description Hands the current block to the reader even if it is not full, when the
+     *  stream stops or a recording ends. The next block continues the sample numbers
+     * @returns the block, NULL if it has no frames
+     */
+    Block *flush(void)
+    {
+        if (blocks[writing].frames == 0) return NULL;
+        return handOver();
+    }
+
+    /**
+     * @description The reader is done with a block returned by commit
+     */
+    void release(Block *block)
+    {
+        if (block == &blocks[0]) held[0] = false;
+        if (block == &blocks[1]) held[1] = false;
+    }
+
+    /**
+     * @description Number of the frame being filled, counted from the start of the stream
+     */
+    uint32_t sampleNumber(void) const { return nextSample; }
+
+    uint32_t completed;     // blocks handed to the reader
+    uint32_t overruns;      // blocks taken back before being released
+
+private:
+    Block *handOver(void)
+    {
+        Block &block = blocks[writing];
+        held[writing] = true;
+        completed++;
+        writing ^= 1;
+        if (held[writing]) { // the reader is late, it loses the older block
+            held[writing] = false;
+            overruns++;
+        }
+        startBlock();
+        return &block;
+    }
+
+    void startBlock(void)
+    {
+        Block &block = blocks[writing];
+        block.firstSample = nextSample;
+        block.frames = 0;
+        block.mmgValid = true;
+        mmgInFrame = 0;
+    }
+
+    Block blocks[2];
+    uint8_t writing;        // block being filled
+    bool held[2];           // block owned by the reader
+    uint32_t nextSample;
+    uint8_t mmgInFrame;     // MMG values added to the current frame
+};
+
+#endif //SOFTWARE_BRAINWEAR_BLOCK_H
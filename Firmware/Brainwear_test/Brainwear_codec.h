@@ -0,0 +1,315 @@
+//
+// Lossless compression of the sample blocks, for the serial port and the SD card. Each channel of a
+// block is predicted with a fixed polynomial (order 0 to 3, chosen per channel and block) and the
+// prediction residuals are Rice coded, so a slow signal costs a few bits per sample instead of 24.
+// Blocks decode on their own: a lost serial packet or a torn SD block only loses its own frames.
+// It has no Arduino dependencies so the host decoder and the benchmark use it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_CODEC_H
+#define SOFTWARE_BRAINWEAR_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Brainwear_block.h"
+
+/**
+ * Layout of a coded block, bits are written most significant first:
+ *
+ *  | firstSample u32 LE | frames u8 | eegMask u8 | mmgChannels u8 | channel ... | padding to a byte |
+ *
+ * EEG channels come first (24-bit samples), only those of eegMask (bit n for EEG channel n) in order,
+ * then MMG channels (16-bit samples), mmgChannels is 0 when the block has no MMG values. Each channel is:
+ *
+ *  | order (2 bits) | k (5 bits) | first sample (width bits) | frames - 1 residuals |
+ *
+ * Sample n is predicted from the samples before it with the polynomial of order min(n, order). The
+ * residual is zigzag mapped to an unsigned value u and stored as u >> k in unary (ones ended by a
+ * zero) followed by the k low bits of u. A quotient of CODEC_ESCAPE or more is stored as
+ * CODEC_ESCAPE ones followed by u in 32 bits. k == CODEC_VERBATIM stores the samples as they are,
+ * width bits each, for channels that do not compress (noise at full scale).
+ */
+#define CODEC_MAX_ORDER     3
+#define CODEC_ORDER_BITS    2
+#define CODEC_K_BITS        5
+#define CODEC_VERBATIM      31      // k of a channel stored without prediction
+#define CODEC_ESCAPE        16      // quotient from which the residual is stored in 32 bits
+#define CODEC_EEG_BITS      24
+#define CODEC_MMG_BITS      16
+#define CODEC_HEADER_BYTES  7
+#define CODEC_MAX_CHANNELS  16      // EEG and MMG channels of a block, for the decoder
+#define CODEC_MAX_FRAMES    255
+
+// Largest coded block: every channel verbatim
+#define CODEC_MAX_BYTES(eeg, mmg, frames) (CODEC_HEADER_BYTES + \
+    ((eeg) * (CODEC_ORDER_BITS + CODEC_K_BITS + CODEC_EEG_BITS * (frames)) + \
+     (mmg) * (CODEC_ORDER_BITS + CODEC_K_BITS + CODEC_MMG_BITS * (frames)) + 7) / 8)
+
+typedef struct {
+    uint32_t firstSample;   // number of frame 0, counted from the start of the stream
+    uint8_t frames;
+    uint8_t eegMask;        // EEG channels of the block, bit n for channel n
+    uint8_t eegChannels;    // coded EEG channels, the bits set in eegMask
+    uint8_t mmgChannels;
+} CodecBlockInfo;
+
+/**
+ * Bits written most significant first into a byte buffer large enough for them
+ */
+struct CodecBitWriter {
+    uint8_t *out;
+    size_t bytes;
+    uint32_t acc;
+    uint8_t bits;       // bits of acc not yet written
+
+    explicit CodecBitWriter(uint8_t *buffer) : out(buffer), bytes(0), acc(0), bits(0) {}
+
+    /** The count (<= 24) low bits of value */
+    inline void put(uint32_t value, uint8_t count)
+    {
+        acc = (acc << count) | (value & ((1UL << count) - 1));
+        bits += count;
+        while (bits >= 8) {
+            bits -= 8;
+            out[bytes++] = (uint8_t) (acc >> bits);
+        }
+    }
+
+    inline void put32(uint32_t value, uint8_t count)
+    {
+        if (count > 16) {
+            put(value >> 16, count - 16);
+            count = 16;
+        }
+        put(value, count);
+    }
+
+    /** Pads the last byte with zeros */
+    inline size_t finish(void)
+    {
+        if (bits > 0) out[bytes++] = (uint8_t) (acc << (8 - bits));
+        bits = 0;
+        return bytes;
+    }
+};
+
+struct CodecBitReader {
+    const uint8_t *in;
+    size_t size;
+    size_t pos;
+    uint32_t acc;
+    uint8_t bits;       // bits of acc not yet read
+    bool overrun;       // read past the end of the buffer
+
+    CodecBitReader(const uint8_t *buffer, size_t length) : in(buffer), size(length), pos(0), acc(0), bits(0), overrun(false) {}
+
+    /** count (<= 24) bits */
+    inline uint32_t get(uint8_t count)
+    {
+        while (bits < count) {
+            acc = (acc << 8) | (pos < size ? in[pos] : 0);
+            if (pos >= size) overrun = true;
+            pos++;
+            bits += 8;
+        }
+        bits -= count;
+        return (acc >> bits) & ((1UL << count) - 1);
+    }
+
+    inline uint32_t get32(uint8_t count)
+    {
+        uint32_t high = 0;
+        if (count > 16) {
+            high = get(count - 16) << 16;
+            count = 16;
+        }
+        return high | get(count);
+    }
+
+    /** Bytes used, the padding of the last byte included */
+    inline size_t consumed(void) const { return pos - bits / 8; }
+};
+
+static inline uint32_t codecZigzag(int32_t e) { return ((uint32_t) e << 1) ^ (uint32_t) (e >> 31); }
+static inline int32_t codecUnzigzag(uint32_t u) { return (int32_t) (u >> 1) ^ -(int32_t) (u & 1); }
+
+/**
+ * @description Bits taken by the Rice codes of count residuals with parameter k
+ */
+static inline uint32_t codecRiceBits(const uint32_t *u, uint16_t count, uint8_t k)
+{
+    uint32_t bits = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t q = u[i] >> k;
+        bits += q < CODEC_ESCAPE ? q + 1 + k : CODEC_ESCAPE + 32;
+    }
+    return bits;
+}
+
+/**
+ * @description Codes one channel of frames samples of width bits. The residuals of the four
+ *  predictors are summed in one pass, the order with the smallest sum is kept. k is chosen
+ *  around log2 of the mean residual by the exact size of the codes. scratch holds frames values
+ */
+template <typename T>
+static void codecEncodeChannel(CodecBitWriter &w, const T *x, uint16_t frames, uint8_t width, uint32_t *scratch)
+{
+    uint64_t sum[CODEC_MAX_ORDER + 1] = {0, 0, 0, 0};
+    int32_t prev1 = 0, prev2 = 0;
+    for (uint16_t n = 1; n < frames; n++) {
+        int32_t d1 = (int32_t) x[n] - (int32_t) x[n - 1];
+        int32_t d2 = n >= 2 ? d1 - prev1 : d1;
+        int32_t d3 = n >= 3 ? d2 - prev2 : d2;
+        sum[0] += codecZigzag(x[n]);
+        sum[1] += codecZigzag(d1);
+        sum[2] += codecZigzag(d2);
+        sum[3] += codecZigzag(d3);
+        prev1 = d1;
+        prev2 = d2;
+    }
+    uint8_t order = 0;
+    for (uint8_t p = 1; p <= CODEC_MAX_ORDER; p++) {
+        if (sum[p] < sum[order]) order = p;
+    }
+
+    uint16_t count = frames - 1;
+    prev1 = prev2 = 0;
+    for (uint16_t n = 1; n < frames; n++) {
+        int32_t d1 = (int32_t) x[n] - (int32_t) x[n - 1];
+        int32_t d2 = n >= 2 ? d1 - prev1 : d1;
+        int32_t d3 = n >= 3 ? d2 - prev2 : d2;
+        int32_t e = order == 0 ? (int32_t) x[n] : order == 1 ? d1 : order == 2 ? d2 : d3;
+        scratch[n - 1] = codecZigzag(e);
+        prev1 = d1;
+        prev2 = d2;
+    }
+
+    uint8_t k = 0;
+    uint32_t bits = 0xFFFFFFFF;
+    if (count > 0) {
+        uint64_t mean = sum[order] / count;
+        uint8_t k0 = 0;
+        while (k0 < CODEC_VERBATIM - 1 && (2ULL << k0) <= mean) k0++;
+        for (uint8_t c = k0 > 0 ? k0 - 1 : 0; c <= k0 + 1 && c < CODEC_VERBATIM; c++) {
+            uint32_t b = codecRiceBits(scratch, count, c);
+            if (b < bits) {
+                bits = b;
+                k = c;
+            }
+        }
+    } else {
+        bits = 0;
+    }
+
+    if (bits >= (uint32_t) count * width) { // does not compress
+        w.put(0, CODEC_ORDER_BITS);
+        w.put(CODEC_VERBATIM, CODEC_K_BITS);
+        for (uint16_t n = 0; n < frames; n++) w.put((uint32_t) x[n], width);
+        return;
+    }
+    w.put(order, CODEC_ORDER_BITS);
+    w.put(k, CODEC_K_BITS);
+    w.put((uint32_t) x[0], width);
+    for (uint16_t i = 0; i < count; i++) {
+        uint32_t q = scratch[i] >> k;
+        if (q < CODEC_ESCAPE) {
+            w.put((2UL << q) - 2, q + 1);   // q ones and a zero
+            w.put32(scratch[i], k);
+        } else {
+            w.put((1UL << CODEC_ESCAPE) - 1, CODEC_ESCAPE);
+            w.put32(scratch[i], 32);
+        }
+    }
+}
+
+/**
+ * @description Decodes one channel into x, frames samples of width bits
+ * @returns false if the channel is not valid
+ */
+static inline bool codecDecodeChannel(CodecBitReader &r, int32_t *x, uint16_t frames, uint8_t width)
+{
+    uint8_t order = r.get(CODEC_ORDER_BITS);
+    uint8_t k = r.get(CODEC_K_BITS);
+    uint8_t shift = 32 - width;
+    if (k == CODEC_VERBATIM) {
+        for (uint16_t n = 0; n < frames; n++) x[n] = (int32_t) (r.get(width) << shift) >> shift;
+        return !r.overrun;
+    }
+    x[0] = (int32_t) (r.get(width) << shift) >> shift;
+    for (uint16_t n = 1; n < frames; n++) {
+        uint32_t q = 0;
+        while (q < CODEC_ESCAPE && r.get(1)) q++;
+        uint32_t u = q < CODEC_ESCAPE ? (q << k) | r.get32(k) : r.get32(32);
+        if (r.overrun) return false;
+        int32_t e = codecUnzigzag(u);
+        uint8_t p = n < order ? n : order;
+        switch (p) {
+            case 0: x[n] = e; break;
+            case 1: x[n] = e + x[n - 1]; break;
+            case 2: x[n] = e + 2 * x[n - 1] - x[n - 2]; break;
+            default: x[n] = e + 3 * x[n - 1] - 3 * x[n - 2] + x[n - 3]; break;
+        }
+    }
+    return true;
+}
+
+/**
+ * @description Codes a block of the sample store into out, which holds at least
+ *  CODEC_MAX_BYTES(EEGChannels, MMGChannels, Frames) bytes. Only the EEG channels of eegMask are
+ *  coded, the MMG channels are left out when the block has no MMG values
+ * @returns the size of the coded block
+ */
+template <uint8_t EEGChannels, uint8_t MMGChannels, uint16_t Frames>
+size_t codecEncodeBlock(const SampleBlock<EEGChannels, MMGChannels, Frames> &block, uint8_t *out,
+                        uint8_t eegMask = (1 << EEGChannels) - 1)
+{
+    static_assert(Frames <= CODEC_MAX_FRAMES, "a coded block has at most 255 frames");
+    static_assert(EEGChannels <= 8, "eegMask has one bit per EEG channel");
+    uint32_t scratch[Frames];
+    uint8_t mmgChannels = block.mmgValid ? MMGChannels : 0;
+    out[0] = block.firstSample & 0xFF;
+    out[1] = (block.firstSample >> 8) & 0xFF;
+    out[2] = (block.firstSample >> 16) & 0xFF;
+    out[3] = (block.firstSample >> 24) & 0xFF;
+    out[4] = (uint8_t) block.frames;
+    eegMask &= (1 << EEGChannels) - 1;
+    out[5] = eegMask;
+    out[6] = mmgChannels;
+    CodecBitWriter w(out + CODEC_HEADER_BYTES);
+    if (block.frames > 0) {
+        for (uint8_t c = 0; c < EEGChannels; c++) {
+            if (eegMask & (1 << c)) codecEncodeChannel(w, block.eeg[c], block.frames, CODEC_EEG_BITS, scratch);
+        }
+        for (uint8_t c = 0; c < mmgChannels; c++) codecEncodeChannel(w, block.mmg[c], block.frames, CODEC_MMG_BITS, scratch);
+    }
+    return CODEC_HEADER_BYTES + w.finish();
+}
+
+/**
+ * @description Decodes a block into values, one array of info.frames samples per channel, EEG
+ *  channels then MMG channels: channel c is at values + c * info.frames. values holds at least
+ *  CODEC_MAX_CHANNELS * CODEC_MAX_FRAMES samples
+ * @returns the size of the coded block, 0 if the block is not valid or longer than size
+ */
+static inline size_t codecDecodeBlock(const uint8_t *in, size_t size, CodecBlockInfo &info, int32_t *values)
+{
+    if (size < CODEC_HEADER_BYTES) return 0;
+    info.firstSample = in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+    info.frames = in[4];
+    info.eegMask = in[5];
+    info.eegChannels = __builtin_popcount(info.eegMask);
+    info.mmgChannels = in[6];
+    if (info.eegChannels + info.mmgChannels > CODEC_MAX_CHANNELS) return 0;
+    CodecBitReader r(in + CODEC_HEADER_BYTES, size - CODEC_HEADER_BYTES);
+    if (info.frames > 0) {
+        for (uint8_t c = 0; c < info.eegChannels + info.mmgChannels; c++) {
+            uint8_t width = c < info.eegChannels ? CODEC_EEG_BITS : CODEC_MMG_BITS;
+            if (!codecDecodeChannel(r, values + c * info.frames, info.frames, width)) return 0;
+        }
+    }
+    if (r.overrun) return 0;
+    return CODEC_HEADER_BYTES + r.consumed();
+}
+
+#endif //SOFTWARE_BRAINWEAR_CODEC_H
@@ -17,10 +17,25 @@
 
 // Baud rates
 #define BAUD_RATE 115200
+#define UART_TX_FIFO_SIZE 128   // bytes of the transmit FIFO of the ESP32 UART
 
 // File transmissions
 #define ADS_BOP 0xA0 // Beginning of stream packet
 #define ADS_EOP 0xC0 // Beginning of stream packet
+#define ADS_EOP_CODEC 0xC1 // End of a compressed block packet, see Brainwear_codec.h
+#define ADS_EOP_HEADER 0xC2 // End of a stream header packet, see Brainwear::sendStreamHeader
+#define ADS_EOP_FEATURES 0xC3 // End of a band power packet, see sendFeatures in Brainwear_test.ino
+#define ADS_EOP_IMPEDANCE 0xC4 // End of an impedance packet, see sendImpedance in Brainwear_test.ino
+#define ADS_EOP_MMG_EVENT 0xC5 // End of an MMG event packet, see sendMMGEvent in Brainwear_test.ino
+
+// EEPROM layout, mirror of the next SD session number and configuration restored at boot
+#define EEPROM_SESSION_MARK    0     // EEPROM_SESSION_KEY once a session number is stored
+#define EEPROM_SESSION_NUMBER  1     // 4 bytes, little endian
+#define EEPROM_SESSION_KEY     0xB5
+#define EEPROM_CONFIG          8     // BrainwearConfig, see Brainwear::saveConfig
+#define EEPROM_CONFIG_KEY      0xC7
+#define EEPROM_CONFIG_VERSION  9
+#define EEPROM_SIZE            256
 
 //Address od ADS1X15
 #define ADS1x15_1  0x49  // Used for FSR
@@ -64,6 +79,13 @@
 #define MISC1       0x15
 #define MISC2       0x16
 #define CONFIG4     0x17
+#define ADS_REGISTERS 0x18
+
+// Timing of the ADS1299, tCLK = 1 / 2.048 MHz (Datasheet, pg. 9 and 62)
+#define ADS_TPOR_MS        128   // power-on reset, 2^18 tCLK after the supplies are up
+#define ADS_ID_TIMEOUT_MS  10    // time given to the device to answer with its ID after RESET
+#define ADS_ID_MASK        0x1C  // bit 4 (always 1) and DEV_ID of the ID register
+#define ADS_ID_ADS1299     0x1C
 
 //Channel Settings
 #define POWER_DOWN      (0)
@@ -98,6 +120,7 @@
 //Number of channels
 #define ADS_NUM_CHANNELS         8
 #define ADS_CHANNELS_BOARD       4
+#define ADS_ALL_CHANNELS         ((1 << ADS_CHANNELS_BOARD) - 1) // channel mask, bit n for channel n + 1
 #define ADS_BYTES_PER_CHAN       3
 #define ADS_BYTES_PER_ADS_SAMPLE 24
 
@@ -193,6 +216,57 @@
 /** Set sample rate */
 #define ADS_SAMPLE_RATE_SET '~'
 
+/** Set serial decimation, 2^n samples averaged for each serial packet */
+#define ADS_SERIAL_DECIMATION_SET '/'
+#define ADS_SERIAL_DECIMATION_MAX 6
+
+/** Precision of the serial packets: bytes of each channel sample and right shift of each channel */
+#define ADS_SERIAL_WIDTH_SET '('    // followed by the bytes per sample, 1 to 3
+#define ADS_SERIAL_SHIFT_SET '^'    // followed by the channel (1 to 8, 0 for all) and the shift
+#define ADS_SERIAL_SHIFT_MAX 9
+
+/** Band power packets of the EEG channels, see Brainwear_features.h */
+#define ADS_FEATURES_SET 'f'        // followed by the mode
+#define ADS_FEATURES_OFF    0       // sample packets only
+#define ADS_FEATURES_ON     1       // band power packets between the sample packets
+#define ADS_FEATURES_ONLY   2       // band power packets, no sample packets
+
+/** Impedance packets of the channels with lead-off enabled, see Brainwear_impedance.h */
+#define ADS_IMPEDANCE_SET 'i'       // followed by the mode
+#define ADS_IMPEDANCE_OFF   0       // sample packets only
+#define ADS_IMPEDANCE_ON    1       // impedance packets between the sample packets
+#define ADS_IMPEDANCE_ONLY  2       // impedance packets, no sample packets
+
+/** Outputs of the MMG channels in the sample packets and the SD files, see MMG::updateEnvelope */
+#define ADS_MMG_OUTPUTS_SET 'm'     // followed by the sum of the outputs, 1 to 7
+#define MMG_OUTPUT_RAW      1       // samples of the ADS1015
+#define MMG_OUTPUT_ENVELOPE 2       // distance to the baseline, rectified and smoothed
+#define MMG_OUTPUT_RMS      4       // sliding RMS of the distance to the baseline
+#define MMG_OUTPUTS_ALL     7
+#define MMG_OUTPUTS         3       // bits of MMG_OUTPUTS_ALL
+
+/** Onset and offset events of the MMG channels, see Brainwear_onset.h */
+#define ADS_MMG_EVENTS_SET 'e'      // followed by the mode
+#define ADS_MMG_EVENTS_OFF  0       // MMG values in the sample packets only
+#define ADS_MMG_EVENTS_ON   1       // event packets between the sample packets
+#define ADS_MMG_EVENTS_ONLY 2       // event packets, the sample packets without MMG values
+
+/** Artifact flags of the EEG channels in the sample packets and the SD files, see Brainwear_artifact.h */
+#define ADS_ARTIFACTS_SET 'q'       // followed by the mode
+#define ADS_ARTIFACTS_OFF   0
+#define ADS_ARTIFACTS_ON    1       // ARTIFACT_BYTES of flags at the end of each sample
+
+/** Montage of the EEG channels in the packets, the compressed blocks and the SD files, see Brainwear_montage.h */
+#define ADS_MONTAGE_SET         'g' // followed by the MONTAGE_ mode, 0 to 3
+#define ADS_MONTAGE_ROW_SET     'o' // followed by the channel, the terms of its row (+ or - and a channel, repeated) and the latch
+#define ADS_MONTAGE_ROW_LATCH   'O'
+
+/** Mains canceller of the EEG and MMG channels, see Brainwear_mains.h */
+#define ADS_MAINS_SET 'c'           // followed by the mode
+#define ADS_MAINS_OFF       0
+#define ADS_MAINS_50HZ      1
+#define ADS_MAINS_60HZ      2
+
 /** Turning channels off */
 #define ADS_CHANNEL_OFF_1 '1'
 #define ADS_CHANNEL_OFF_2 '2'
@@ -241,7 +315,9 @@
 /** Miscellaneous */
 #define ADS_MISC_QUERY_REGISTER_SETTINGS '?'
 #define ADS_MISC_SOFT_RESET              'v'
+#define ADS_CONFIG_CLEAR                 '#'   // forget the configuration restored at boot
 #define ADS_GET_VERSION                  'V'
+#define ADS_LATENCY_REPORT               '%'   // DRDY latency and interval histograms
 
 /** Turn On/Off LED */
 #define ADS_TURN_ON_LED  'l'
@@ -258,12 +334,20 @@
 #define ADS_SD_1HR         'H'
 #define ADS_SD_2HR         'J'
 #define ADS_SD_4HR         'K'
+#define ADS_SD_FORMAT_TXT  'h'
+#define ADS_SD_FORMAT_BDF  'B'
+#define ADS_SD_FORMAT_RICE 'L'   // compressed blocks, see Brainwear_codec.h
 
 /** board Commands */
 #define ADS_TX_RAW         '<'
 #define ADS_TX_ASCII       '>'
 #define ADS_MULTMODE_ON    'M'
 #define ADS_MULTMODE_OFF   'N'
+#define ADS_TRACE_DUMP     '&'   // binary dump of the trace ring, see Brainwear_trace.h
+#define ADS_MEMORY_REPORT  '*'   // allocations of the arena and RAM high-water marks, see Brainwear_arena.h
+#define ADS_SCHEDULER_REPORT '@' // run time of the event handlers and idle time, see Brainwear_scheduler.h
+#define ADS_CODEC_ON       '{'   // stream compressed blocks instead of one packet per sample
+#define ADS_CODEC_OFF      '}'
 
 
 #endif //SOFTWARE_BRAINWEAR_DEFINITIONS_H
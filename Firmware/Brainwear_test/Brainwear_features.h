@@ -0,0 +1,220 @@
+//
+// Band powers of the EEG channels (delta, theta, alpha, beta, gamma), for the consumers that only
+// need them. The samples are averaged down to FEATURE_RATE_HZ and kept in a ring of FEATURE_FFT_SIZE
+// samples per channel; every FEATURE_HOP_MS the last window (1.024 s, 75% overlap) is Hann
+// windowed and transformed with a fixed-point FFT, two channels at a time, and the power of each
+// band is summed from the bins. It has no Arduino dependencies so the host benchmark uses it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_FEATURES_H
+#define SOFTWARE_BRAINWEAR_FEATURES_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define FEATURE_RATE_HZ     250     // rate of the samples transformed, the board rates are 250 * 2^n
+#define FEATURE_FFT_BITS    8
+#define FEATURE_FFT_SIZE    (1 << FEATURE_FFT_BITS)    // samples per window, 1.024 s
+#define FEATURE_HOP_MS      250     // time between two windows
+#define FEATURE_BANDS       5
+#define FEATURE_NORM_BITS   27      // the largest windowed sample is scaled to this many bits
+#define FEATURE_NO_POWER    INT16_MIN   // level of a band without power
+
+// First and last bin of each band, bins are FEATURE_RATE_HZ / FEATURE_FFT_SIZE = 0.98 Hz apart:
+// about delta 1-4 Hz, theta 4-8 Hz, alpha 8-13 Hz, beta 13-30 Hz, gamma 30-46 Hz (below the mains)
+static const uint8_t featureBandBins[FEATURE_BANDS][2] = {
+    {1, 3}, {4, 7}, {8, 12}, {13, 30}, {31, 46}
+};
+
+/**
+ * @description In-place radix-2 FFT of FEATURE_FFT_SIZE complex samples. Each stage halves its
+ *  output, so the result is the transform divided by FEATURE_FFT_SIZE and never grows past the
+ *  largest input. cosTable and sinTable hold FEATURE_FFT_SIZE / 2 values in Q15
+ */
+static inline void featureFFT(int32_t *re, int32_t *im, const int16_t *cosTable, const int16_t *sinTable)
+{
+    for (uint16_t i = 1, j = 0; i < FEATURE_FFT_SIZE; i++) { // bit reversed order
+        uint16_t bit = FEATURE_FFT_SIZE >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j |= bit;
+        if (i < j) {
+            int32_t t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (uint16_t size = 2; size <= FEATURE_FFT_SIZE; size <<= 1) {
+        uint16_t half = size >> 1;
+        uint16_t step = FEATURE_FFT_SIZE / size;
+        for (uint16_t j = 0; j < half; j++) {
+            int32_t wr = cosTable[j * step];
+            int32_t wi = -sinTable[j * step];
+            for (uint16_t a = j; a < FEATURE_FFT_SIZE; a += size) {
+                uint16_t b = a + half;
+                int32_t tr = (int32_t) (((int64_t) wr * re[b] - (int64_t) wi * im[b]) >> 15);
+                int32_t ti = (int32_t) (((int64_t) wr * im[b] + (int64_t) wi * re[b]) >> 15);
+                re[b] = (re[a] - tr) >> 1;
+                im[b] = (im[a] - ti) >> 1;
+                re[a] = (re[a] + tr) >> 1;
+                im[a] = (im[a] + ti) >> 1;
+            }
+        }
+    }
+}
+
+/**
+ * Band powers of Channels channels. add() takes every sample of the board, compute() the window
+ * when add() says one is due. Levels are in hundredths of dB relative to 1 count^2 of the input:
+ * the variance of the band, Hann window corrected
+ */
+template <uint8_t Channels>
+class BandPowers {
+public:
+    BandPowers()
+    {
+        for (uint16_t n = 0; n < FEATURE_FFT_SIZE; n++) {
+            hann[n] = (int16_t) lrint(16383.5 * (1.0 - cos(2 * M_PI * n / FEATURE_FFT_SIZE)));
+        }
+        for (uint16_t k = 0; k < FEATURE_FFT_SIZE / 2; k++) {
+            cosTable[k] = (int16_t) lrint(32767 * cos(2 * M_PI * k / FEATURE_FFT_SIZE));
+            sinTable[k] = (int16_t) lrint(32767 * sin(2 * M_PI * k / FEATURE_FFT_SIZE));
+        }
+        begin(FEATURE_RATE_HZ);
+    }
+
+    /**
+     * @description Empties the windows, for a stream at sampleRateHz
+     */
+    void begin(uint16_t sampleRateHz)
+    {
+        sampleRate = sampleRateHz;
+        decimation = sampleRateHz > FEATURE_RATE_HZ ? sampleRateHz / FEATURE_RATE_HZ : 1;
+        sumCount = 0;
+        position = 0;
+        filled = 0;
+        hop = 0;
+        memset(levels, 0, sizeof(levels));
+    }
+
+    /**
+     * @description Adds one sample of every channel
+     * @returns true when a window is due, every FEATURE_HOP_MS once the first window is full
+     */
+    bool add(const int32_t *values)
+    {
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (sumCount == 0) sums[c] = 0;
+            sums[c] += values[c];
+        }
+        if (++sumCount < decimation) return false;
+        for (uint8_t c = 0; c < Channels; c++) ring[c][position] = (int32_t) (sums[c] / sumCount);
+        sumCount = 0;
+        position = (position + 1) & (FEATURE_FFT_SIZE - 1);
+        if (filled < FEATURE_FFT_SIZE) filled++;
+        hop += 1000;   // FEATURE_HOP_MS of samples are FEATURE_RATE_HZ * FEATURE_HOP_MS / 1000 of them
+        if (hop < (uint32_t) FEATURE_RATE_HZ * FEATURE_HOP_MS) return false;
+        hop -= (uint32_t) FEATURE_RATE_HZ * FEATURE_HOP_MS;
+        return filled == FEATURE_FFT_SIZE;
+    }
+
+    /**
+     * @description Band levels of the last window for the channels of mask (bit c for channel c),
+     *  placed in levels. Two real channels go through one complex FFT
+     */
+    void compute(uint8_t mask)
+    {
+        uint8_t pair[2];
+        uint8_t count = 0;
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (!(mask & (1 << c))) continue;
+            pair[count++] = c;
+            if (count == 2) {
+                computePair(pair[0], pair[1]);
+                count = 0;
+            }
+        }
+        if (count == 1) computePair(pair[0], -1);
+    }
+
+    int16_t levels[Channels][FEATURE_BANDS];   // hundredths of dB re 1 count^2, FEATURE_NO_POWER if none
+    uint16_t sampleRate;                        // of the samples given to add
+
+private:
+    /**
+     * @description Channel a in the real part, b (if not negative) in the imaginary part. Their
+     *  spectra are split from the transform Z: A(k) = (Z(k) + Z*(N-k)) / 2, B(k) = (Z(k) - Z*(N-k)) / 2j
+     */
+    void computePair(int8_t a, int8_t b)
+    {
+        windowChannel(a, re);
+        if (b >= 0) windowChannel(b, im);
+        else memset(im, 0, sizeof(im));
+
+        uint32_t largest = 1;
+        for (uint16_t n = 0; n < FEATURE_FFT_SIZE; n++) {
+            uint32_t r = re[n] < 0 ? -re[n] : re[n];
+            uint32_t i = im[n] < 0 ? -im[n] : im[n];
+            if (r > largest) largest = r;
+            if (i > largest) largest = i;
+        }
+        int8_t shift = FEATURE_NORM_BITS - (32 - __builtin_clz(largest)); // block floating point
+        for (uint16_t n = 0; n < FEATURE_FFT_SIZE; n++) {
+            re[n] = shift >= 0 ? re[n] * (1 << shift) : re[n] >> -shift;
+            im[n] = shift >= 0 ? im[n] * (1 << shift) : im[n] >> -shift;
+        }
+        featureFFT(re, im, cosTable, sinTable);
+
+        // variance of a band: 2 |X(k)|^2 / mean(w^2) over its bins, mean(w^2) = 3/8 for Hann, and
+        // the FFT output is X(k) scaled by 2^shift. |A(k)|^2 and |B(k)|^2 are 4 times too large here
+        double offset = 100 * (10 * log10(16.0 / 3 / 4) - 20 * log10(2.0) * shift);
+        for (uint8_t band = 0; band < FEATURE_BANDS; band++) {
+            uint64_t powerA = 0, powerB = 0;
+            for (uint16_t k = featureBandBins[band][0]; k <= featureBandBins[band][1]; k++) {
+                int64_t zr = re[k], zi = im[k];
+                int64_t wr = re[FEATURE_FFT_SIZE - k], wi = im[FEATURE_FFT_SIZE - k];
+                powerA += (zr + wr) * (zr + wr) + (zi - wi) * (zi - wi);
+                powerB += (zi + wi) * (zi + wi) + (zr - wr) * (zr - wr);
+            }
+            levels[a][band] = level(powerA, offset);
+            if (b >= 0) levels[b][band] = level(powerB, offset);
+        }
+    }
+
+    /**
+     * @description The window of channel c, oldest sample first, without its mean and Hann windowed
+     */
+    void windowChannel(uint8_t c, int32_t *out)
+    {
+        int64_t sum = 0;
+        for (uint16_t n = 0; n < FEATURE_FFT_SIZE; n++) sum += ring[c][n];
+        int32_t mean = (int32_t) (sum / FEATURE_FFT_SIZE);
+        for (uint16_t n = 0; n < FEATURE_FFT_SIZE; n++) {
+            int32_t x = ring[c][(position + n) & (FEATURE_FFT_SIZE - 1)] - mean;
+            out[n] = (int32_t) (((int64_t) x * hann[n]) >> 15);
+        }
+    }
+
+    static int16_t level(uint64_t power, double offset)
+    {
+        if (power == 0) return FEATURE_NO_POWER;
+        double value = 1000 * log10((double) power) + offset;
+        if (value > INT16_MAX) return INT16_MAX;
+        if (value <= INT16_MIN) return INT16_MIN + 1;
+        return (int16_t) lrint(value);
+    }
+
+    int32_t ring[Channels][FEATURE_FFT_SIZE];   // last FEATURE_FFT_SIZE samples, oldest at position
+    int32_t re[FEATURE_FFT_SIZE];
+    int32_t im[FEATURE_FFT_SIZE];
+    int16_t hann[FEATURE_FFT_SIZE];             // Q15
+    int16_t cosTable[FEATURE_FFT_SIZE / 2];     // Q15
+    int16_t sinTable[FEATURE_FFT_SIZE / 2];
+    int64_t sums[Channels];                     // of the samples averaged for the next ring sample
+    uint16_t decimation;                        // board samples per ring sample
+    uint16_t sumCount;
+    uint16_t position;                          // next sample of the ring
+    uint16_t filled;                            // samples in the ring, up to FEATURE_FFT_SIZE
+    uint32_t hop;                               // ring samples since the last window, times 1000
+};
+
+#endif //SOFTWARE_BRAINWEAR_FEATURES_H
@@ -0,0 +1,72 @@
+//
+// Layout of the data frame of the ADS1299 read in RDATAC mode, specialised at compile time on
+// the number of channels and the bytes per channel: the loops have constant bounds and are
+// unrolled by the compiler, and the buffers declared with the constants have exact sizes.
+// Several variants can be used in the same program (4 or 8 channels, a daisy chained board).
+// It has no Arduino dependencies so the host benchmark uses it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_FRAME_H
+#define SOFTWARE_BRAINWEAR_FRAME_H
+
+#include <stdint.h>
+#include "Brainwear_int24.h"
+
+/**
+ *  | status (3 bytes) | channel 1 | channel 2 | ... | channel Channels |
+ *
+ * The status word is 1100 + LOFF_STATP + LOFF_STATN + GPIO[7:4]. Channels are big endian two's
+ * complement values of BytesPerChannel bytes.
+ */
+template <uint8_t Channels, uint8_t BytesPerChannel>
+class ADSFrame {
+public:
+    static const uint8_t CHANNELS = Channels;
+    static const uint8_t BYTES_PER_CHANNEL = BytesPerChannel;
+    static const uint8_t STATUS_BYTES = 3;
+    static const uint8_t DATA_BYTES = Channels * BytesPerChannel;
+    static const uint8_t FRAME_BYTES = STATUS_BYTES + DATA_BYTES;
+
+    /**
+     * @description Value of one channel. The bytes are placed at the top of a 32-bit word and
+     *  shifted back down, the arithmetic shift extends the sign without a branch
+     */
+    static inline int32_t channelValue(const uint8_t *bytes)
+    {
+        uint32_t word = 0;
+        for (uint8_t b = 0; b < BytesPerChannel; b++) {
+            word |= (uint32_t) bytes[b] << (24 - 8 * b);
+        }
+        return (int32_t) word >> (32 - 8 * BytesPerChannel);
+    }
+
+    /**
+     * @description Decodes a frame: status word and the value of each channel
+     */
+    static inline void decode(const uint8_t *frame, uint32_t *status, int32_t *values)
+    {
+        *status = ((uint32_t) frame[0] << 16) | ((uint32_t) frame[1] << 8) | frame[2];
+        if (BytesPerChannel == 3) {
+            int24BEToInt32(frame + STATUS_BYTES, values, Channels);
+            return;
+        }
+        for (uint8_t c = 0; c < Channels; c++) {
+            values[c] = channelValue(frame + STATUS_BYTES + c * BytesPerChannel);
+        }
+    }
+
+    /**
+     * @description Writes the values back as big endian bytes, the layout of the channel data in
+     *  the frame and in the serial packets
+     */
+    static inline void pack(const int32_t *values, uint8_t *data)
+    {
+        for (uint8_t c = 0; c < Channels; c++) {
+            for (uint8_t b = 0; b < BytesPerChannel; b++) {
+                data[c * BytesPerChannel + b] = (uint8_t) (values[c] >> (8 * (BytesPerChannel - 1 - b)));
+            }
+        }
+    }
+};
+
+#endif //SOFTWARE_BRAINWEAR_FRAME_H
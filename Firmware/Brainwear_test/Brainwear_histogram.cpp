@@ -0,0 +1,89 @@
+//
+// Histogram of times in microseconds, see Brainwear_histogram.h
+//
+
+#include "Brainwear_histogram.h"
+
+// Constructor
+Histogram::Histogram()
+{
+    reset();
+}
+
+/**
+ * @description Empties the histogram
+ */
+void Histogram::reset(void)
+{
+    count = 0;
+    min = 0xFFFFFFFF;
+    max = 0;
+    sum = 0;
+    memset(bins, 0, sizeof(bins));
+}
+
+/**
+ * @description Adds a value. Safe to call from the DRDY interrupt, it is in IRAM and only counts
+ */
+void IRAM_ATTR Histogram::add(uint32_t value)
+{
+    uint16_t bin;
+    if (value < (2UL << HISTOGRAM_SUB_BITS)) {
+        bin = value;
+    } else if (value >> HISTOGRAM_MAX_BITS) {
+        bin = HISTOGRAM_BINS;
+    } else {
+        uint8_t exponent = 31 - __builtin_clz(value);
+        uint8_t shift = exponent - HISTOGRAM_SUB_BITS;
+        bin = ((shift + 1) << HISTOGRAM_SUB_BITS) + ((value >> shift) & ((1 << HISTOGRAM_SUB_BITS) - 1));
+    }
+    bins[bin]++;
+    count++;
+    sum += value;
+    if (value < min) min = value;
+    if (value > max) max = value;
+}
+
+/**
+ * @description First value of a bin. Bin HISTOGRAM_BINS starts at 2^HISTOGRAM_MAX_BITS
+ */
+uint32_t Histogram::binStart(uint16_t bin)
+{
+    if (bin < (2 << HISTOGRAM_SUB_BITS)) return bin;
+    uint8_t shift = (bin >> HISTOGRAM_SUB_BITS) - 1;
+    return ((uint32_t) ((1 << HISTOGRAM_SUB_BITS) + (bin & ((1 << HISTOGRAM_SUB_BITS) - 1)))) << shift;
+}
+
+/**
+ * @description Prints the summary and the bins that are not empty, one per line: first value,
+ *  last value and count. Works on a copy, the DRDY interrupt keeps adding values meanwhile
+ */
+void Histogram::print(void)
+{
+    Histogram copy(*this);
+    if (copy.count == 0) {
+        Serial.println("no samples");
+        return;
+    }
+    Serial.print("count ");
+    Serial.print(copy.count);
+    Serial.print(" min ");
+    Serial.print(copy.min);
+    Serial.print(" mean ");
+    Serial.print((uint32_t) (copy.sum / copy.count));
+    Serial.print(" max ");
+    Serial.println(copy.max);
+    for (uint16_t bin = 0; bin < HISTOGRAM_BINS; bin++) {
+        if (copy.bins[bin] == 0) continue;
+        Serial.print(binStart(bin));
+        Serial.print("-");
+        Serial.print(binStart(bin + 1) - 1);
+        Serial.print(": ");
+        Serial.println(copy.bins[bin]);
+    }
+    if (copy.bins[HISTOGRAM_BINS] > 0) {
+        Serial.print(binStart(HISTOGRAM_BINS));
+        Serial.print("+: ");
+        Serial.println(copy.bins[HISTOGRAM_BINS]);
+    }
+}
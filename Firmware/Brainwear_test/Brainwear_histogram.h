@@ -0,0 +1,33 @@
+//
+// Histogram of times in microseconds with a fixed number of bins. Bins are log-linear: exact up
+// to 16 us, then 8 bins per power of two (12.5 % wide) up to 65 ms, plus an overflow bin. The
+// minimum, maximum and mean are exact.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_HISTOGRAM_H
+#define SOFTWARE_BRAINWEAR_HISTOGRAM_H
+
+#include <Arduino.h>
+
+#define HISTOGRAM_SUB_BITS   3                                  // 8 bins per power of two
+#define HISTOGRAM_MAX_BITS   16                                 // values up to 65535 us
+#define HISTOGRAM_BINS       ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)  // + overflow
+
+class Histogram {
+public:
+    Histogram();
+
+    void IRAM_ATTR add(uint32_t value);
+    void print(void);
+    void reset(void);
+
+    static uint32_t binStart(uint16_t bin);
+
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t bins[HISTOGRAM_BINS + 1];  // last one counts the values above the range
+};
+
+#endif //SOFTWARE_BRAINWEAR_HISTOGRAM_H
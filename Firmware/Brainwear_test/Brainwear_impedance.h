@@ -0,0 +1,134 @@
+//
+// Electrode impedance from the AC lead-off excitation of the ADS1299. The current source of a channel
+// with lead-off enabled injects a square wave of 7.8 or 31.2 Hz (LOFF register), the voltage it makes
+// across the electrodes shows up in the channel. The samples are decimated to IMPEDANCE_RATE_HZ by a
+// second order CIC filter, which keeps the odd harmonics of the square wave from aliasing onto it,
+// Hann windowed so the EEG and the mains do not leak into the estimate, and a Goertzel filter at the
+// excitation frequency runs on each enabled channel, one step per sample; every IMPEDANCE_BLOCK
+// samples it gives the amplitude of the excitation in the channel. It has no
+// Arduino dependencies so the host build checks it against the simulated electrodes.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_IMPEDANCE_H
+#define SOFTWARE_BRAINWEAR_IMPEDANCE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define IMPEDANCE_RATE_HZ    250     // rate of the samples filtered, the board rates are 250 * 2^n
+#define IMPEDANCE_BLOCK      64      // samples of each estimate, 0.256 s: 8 periods of 31.25 Hz, 2 of 7.8125 Hz
+#define IMPEDANCE_COEFF_BITS 28      // fraction bits of the Goertzel coefficient
+
+/**
+ * Amplitude of the lead-off excitation in Channels channels. add() takes every sample of the board
+ * and says when the estimates of a block are ready in amplitude
+ */
+template <uint8_t Channels>
+class ImpedanceMeter {
+public:
+    ImpedanceMeter()
+    {
+        for (uint16_t n = 0; n < IMPEDANCE_BLOCK; n++) {
+            hann[n] = (int16_t) lrint(16383.5 * (1.0 - cos(2 * M_PI * n / IMPEDANCE_BLOCK)));
+        }
+        begin(IMPEDANCE_RATE_HZ, 0);
+    }
+
+    /**
+     * @description Starts a new block, for a stream at sampleRateHz and an excitation at excitationHz.
+     *  The excitation must be a whole number of periods in a block; otherwise (0 for DC lead-off) add
+     *  never gives an estimate
+     */
+    void begin(uint16_t sampleRateHz, float excitationHz)
+    {
+        sampleRate = sampleRateHz;
+        frequency = excitationHz;
+        decimation = sampleRateHz > IMPEDANCE_RATE_HZ ? sampleRateHz / IMPEDANCE_RATE_HZ : 1;
+        double bin = (double) excitationHz * IMPEDANCE_BLOCK / IMPEDANCE_RATE_HZ;
+        enabled = bin >= 1 && bin < IMPEDANCE_BLOCK / 2 && bin == floor(bin);
+        double w = 2 * M_PI * bin / IMPEDANCE_BLOCK;
+        coeff = (int32_t) lrint(2 * cos(w) * (1 << IMPEDANCE_COEFF_BITS));
+        cosW = cos(w);
+        // the sinc3 filter of the ADS1299 attenuates the excitation by (sin(x) / x)^3, the CIC filter
+        // by (sin(D x) / (D sin(x)))^2, x = pi f / sampleRateHz
+        double x = M_PI * excitationHz / ((double) IMPEDANCE_RATE_HZ * decimation);
+        double attenuation = x > 0 ? pow(sin(x) / x, 3) : 1;
+        if (decimation > 1) attenuation *= pow(sin(decimation * x) / (decimation * sin(x)), 2);
+        scale = 2.0 / (0.5 * IMPEDANCE_BLOCK) / attenuation;   // 0.5, mean of the Hann window
+        memset(integrator, 0, sizeof(integrator));
+        memset(comb, 0, sizeof(comb));
+        inputs = 0;
+        count = 0;
+        blockMask = 0;
+        measured = 0;
+        memset(amplitude, 0, sizeof(amplitude));
+    }
+
+    /**
+     * @description Adds one sample of every channel, the Goertzel filters run on the channels of mask
+     *  (bit c for channel c). A change of mask takes effect at the next block
+     * @returns true when a block is complete: amplitude holds the estimates of the channels of measured
+     */
+    bool add(const int32_t *values, uint8_t mask)
+    {
+        if (!enabled) return false;
+        if (inputs == 0 && count == 0) {
+            blockMask = mask;
+            memset(s1, 0, sizeof(s1));
+            memset(s2, 0, sizeof(s2));
+        }
+        for (uint8_t c = 0; c < Channels; c++) {   // every channel, so a new one has no transient
+            integrator[c][0] += (int64_t) values[c];
+            integrator[c][1] += integrator[c][0];
+        }
+        if (++inputs < decimation) return false;
+        for (uint8_t c = 0; c < Channels; c++) {
+            // the integrators wrap around, the differences of the combs do not
+            uint64_t first = integrator[c][1] - comb[c][0];
+            uint64_t second = first - comb[c][1];
+            comb[c][0] = integrator[c][1];
+            comb[c][1] = first;
+            if (!(blockMask & (1 << c))) continue;
+            int64_t x = (((int64_t) second / ((int64_t) decimation * decimation)) * hann[count]) >> 15;
+            int64_t s = x + ((coeff * s1[c]) >> IMPEDANCE_COEFF_BITS) - s2[c]; // x[n] + 2 cos(w) s[n-1] - s[n-2]
+            s2[c] = s1[c];
+            s1[c] = s;
+        }
+        inputs = 0;
+        if (++count < IMPEDANCE_BLOCK) return false;
+        count = 0;
+
+        // |X(k)|^2 = s1^2 + s2^2 - 2 cos(w) s1 s2, a sinusoid of amplitude A gives |X(k)| = A N / 4
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (!(blockMask & (1 << c))) continue;
+            double a = (double) s1[c], b = (double) s2[c];
+            double power = a * a + b * b - 2 * cosW * a * b;
+            amplitude[c] = (float) (sqrt(power > 0 ? power : 0) * scale);
+        }
+        measured = blockMask;
+        return true;
+    }
+
+    float amplitude[Channels];  // counts, amplitude of the excitation in the last block
+    uint8_t measured;           // channels of amplitude, bit c for channel c
+    uint16_t sampleRate;        // of the samples given to add
+    float frequency;            // of the excitation, Hz
+
+private:
+    int64_t s1[Channels];       // Goertzel state, s[n-1] and s[n-2]
+    int64_t s2[Channels];
+    uint64_t integrator[Channels][2];   // CIC filter, at the board rate
+    uint64_t comb[Channels][2];         // last input of each comb, at IMPEDANCE_RATE_HZ
+    int16_t hann[IMPEDANCE_BLOCK];  // Q15
+    int64_t coeff;              // 2 cos(w), IMPEDANCE_COEFF_BITS fraction bits
+    double cosW;
+    double scale;               // from |X(k)| to amplitude, with the attenuation of the filters
+    uint16_t decimation;        // board samples per Goertzel step
+    uint16_t inputs;            // board samples since the last Goertzel step
+    uint16_t count;             // Goertzel steps of the block
+    uint8_t blockMask;          // channels filtered in the block
+    bool enabled;
+};
+
+#endif //SOFTWARE_BRAINWEAR_IMPEDANCE_H
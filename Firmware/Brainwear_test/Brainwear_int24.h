@@ -0,0 +1,77 @@
+//
+// Conversion of packed 24-bit two's complement samples to int32, for one frame or a block of
+// frames at once. The three bytes are placed at the top of a 32-bit word and shifted back down:
+// the arithmetic shift extends the sign without a branch. The loops convert 4 samples per turn.
+// It has no Arduino dependencies so the host tools use it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_INT24_H
+#define SOFTWARE_BRAINWEAR_INT24_H
+
+#include <stdint.h>
+
+/** One big endian sample, the layout of the ADS1299 frames */
+static inline int32_t int24BE(const uint8_t *p)
+{
+    return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8)) >> 8;
+}
+
+/** One little endian sample, the layout of the BDF records */
+static inline int32_t int24LE(const uint8_t *p)
+{
+    return (int32_t) (((uint32_t) p[2] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[0] << 8)) >> 8;
+}
+
+/**
+ * @description Converts count consecutive big endian samples
+ */
+static inline void int24BEToInt32(const uint8_t *src, int32_t *dst, uint32_t count)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4, src += 12) {
+        dst[i] = int24BE(src);
+        dst[i + 1] = int24BE(src + 3);
+        dst[i + 2] = int24BE(src + 6);
+        dst[i + 3] = int24BE(src + 9);
+    }
+    for (; i < count; i++, src += 3) dst[i] = int24BE(src);
+}
+
+/**
+ * @description Converts count consecutive little endian samples
+ */
+static inline void int24LEToInt32(const uint8_t *src, int32_t *dst, uint32_t count)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4, src += 12) {
+        dst[i] = int24LE(src);
+        dst[i + 1] = int24LE(src + 3);
+        dst[i + 2] = int24LE(src + 6);
+        dst[i + 3] = int24LE(src + 9);
+    }
+    for (; i < count; i++, src += 3) dst[i] = int24LE(src);
+}
+
+/**
+ * @description Converts a block of frames with interleaved big endian channels into one array
+ *  per channel. Frame f starts at src + f * frameBytes and its channels after offset bytes (the
+ *  status word). Channel c of frame f goes to dst[c * dstStride + f], dstStride >= frames
+ */
+static inline void int24FramesToInt32(const uint8_t *src, uint32_t frameBytes, uint32_t offset,
+                                      uint32_t frames, uint8_t channels, int32_t *dst, uint32_t dstStride)
+{
+    src += offset;
+    for (uint8_t c = 0; c < channels; c++, src += 3, dst += dstStride) {
+        const uint8_t *p = src;
+        uint32_t f = 0;
+        for (; f + 4 <= frames; f += 4, p += 4 * frameBytes) {
+            dst[f] = int24BE(p);
+            dst[f + 1] = int24BE(p + frameBytes);
+            dst[f + 2] = int24BE(p + 2 * frameBytes);
+            dst[f + 3] = int24BE(p + 3 * frameBytes);
+        }
+        for (; f < frames; f++, p += frameBytes) dst[f] = int24BE(p);
+    }
+}
+
+#endif //SOFTWARE_BRAINWEAR_INT24_H
@@ -0,0 +1,195 @@
+//
+// Adaptive canceller of the mains interference, for the EEG and the MMG channels. A fixed notch
+// misses the mains when its frequency drifts and leaves its harmonics in; here the board makes its
+// own reference, a sine and a cosine at the mains frequency and at each harmonic below the Nyquist
+// frequency, and an LMS filter on each channel learns the amplitude and the phase of every line and
+// subtracts them from the samples. It learns the offset of each channel too, which would otherwise
+// leak into the weights as a ripple, but leaves it in the samples. The step size gives narrow
+// notches that follow the changes of amplitude and phase in about half a second. A frequency locked
+// loop turns the reference with the rotation of the weights of the fundamental, so a mains off its
+// nominal frequency stays at the centre of the notches, the harmonics with it. The filters are in
+// fixed point, only the loop, once per block, uses floats. Time constants are in samples, the times
+// are those at 250 Hz. It has no Arduino dependencies so the host benchmark uses it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_MAINS_H
+#define SOFTWARE_BRAINWEAR_MAINS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAINS_RATE_HZ       250     // the board rates are 250 * 2^n
+#define MAINS_HARMONICS     3       // lines cancelled: the mains and its harmonics, up to the Nyquist frequency
+#define MAINS_STEP_SHIFT    6       // LMS step size 2^-6: the weights follow with a time constant of 2^7 samples, 0.5 s
+#define MAINS_WEIGHT_BITS   29      // bits of a weight: its fraction bits are these minus the bits of the samples
+#define MAINS_TRACK_SHIFT   5       // the loop runs every 2^5 samples, 128 ms
+#define MAINS_TRACK_GAIN    2       // and corrects half of the frequency error it measures
+#define MAINS_MAX_DRIFT     1       // Hz, largest distance of the reference to the nominal frequency
+#define MAINS_TRACK_SNR     16      // the loop needs a fundamental at most 12 dB below the rest of the channels
+
+// sin(pi / 2 z) = z (A - z^2 (B - C z^2)) for z from -1 to 1, in Q15: A = pi / 2, B = pi - 5 / 2, C = pi / 2 - 3 / 2
+#define MAINS_SINE_A        51472
+#define MAINS_SINE_B        21023
+#define MAINS_SINE_C        2320
+
+/**
+ * Mains canceller of Channels channels with samples up to largest. configure() takes the mains and
+ * the sample rate, apply() every sample in place
+ */
+template <uint8_t Channels>
+class MainsCanceller {
+public:
+    MainsCanceller(int32_t largest)
+    {
+        limit = largest;
+        fractionBits = MAINS_WEIGHT_BITS - (32 - __builtin_clz((uint32_t) largest));
+        frequency = 0;
+        sampleRate = 0;
+        configure(0, MAINS_RATE_HZ);
+    }
+
+    /**
+     * @description Cancels the mains at mainsHz (0 for none) for a stream at sampleRateHz. A new
+     *  frequency or sample rate starts the canceller again
+     */
+    void configure(uint16_t mainsHz, uint16_t sampleRateHz)
+    {
+        if (mainsHz == frequency && sampleRateHz == sampleRate) return;
+        frequency = mainsHz;
+        sampleRate = sampleRateHz;
+        nominal = (uint32_t) (((uint64_t) mainsHz << 32) / sampleRateHz);
+        maxOffset = (int32_t) (((uint64_t) MAINS_MAX_DRIFT << 32) / sampleRateHz);
+        harmonics = 0;
+        while (harmonics < MAINS_HARMONICS && 2 * (harmonics + 1) * mainsHz < sampleRateHz) harmonics++;
+        stepShift = MAINS_STEP_SHIFT;
+        for (uint16_t rate = MAINS_RATE_HZ; rate < sampleRateHz; rate <<= 1) stepShift++;
+        trackSamples = 1 << (MAINS_TRACK_SHIFT + stepShift - MAINS_STEP_SHIFT);
+        updateShift = 15 + stepShift - fractionBits;
+        weightScale = 1.0f / ((float) (1L << fractionBits) * (float) (1L << fractionBits));
+        phase = 0;
+        offset = 0;
+        increment = nominal;
+        trackCount = 0;
+        restPower = 0;
+        started = false;
+        memset(weights, 0, sizeof(weights));
+        memset(tracked, 0, sizeof(tracked));
+    }
+
+    /**
+     * @description Takes the lines of the mains out of the channels of mask (bit c for channel c),
+     *  the results clamped to the largest sample. The reference moves on one sample either way
+     */
+    template <typename Sample>
+    void apply(Sample *values, uint8_t mask)
+    {
+        if (frequency == 0) return;
+        int32_t ref[MAINS_HARMONICS][2];    // sine and cosine of every line, Q15
+        for (uint8_t h = 0; h < harmonics; h++) {
+            uint32_t angle = phase * (h + 1);
+            ref[h][0] = sine(angle);
+            ref[h][1] = sine(angle + 0x40000000UL);
+        }
+        phase += increment;
+        if (!started) {
+            for (uint8_t c = 0; c < Channels; c++) offsets[c] = (int32_t) values[c] << fractionBits;
+            started = true;
+        }
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (!(mask & (1 << c))) continue;
+            int64_t sum = 0;
+            for (uint8_t h = 0; h < harmonics; h++) {
+                sum += (int64_t) weights[c][h][0] * ref[h][0] + (int64_t) weights[c][h][1] * ref[h][1];
+            }
+            int32_t output = (int32_t) values[c] - (int32_t) ((sum + (1LL << (14 + fractionBits))) >> (15 + fractionBits));
+            int32_t error = output - (int32_t) ((offsets[c] + (1L << (fractionBits - 1))) >> fractionBits);
+            int64_t half = 1LL << (updateShift - 1);
+            for (uint8_t h = 0; h < harmonics; h++) {
+                weights[c][h][0] += (int32_t) (((int64_t) error * ref[h][0] + half) >> updateShift);
+                weights[c][h][1] += (int32_t) (((int64_t) error * ref[h][1] + half) >> updateShift);
+            }
+            offsets[c] += (int32_t) (((int64_t) error << fractionBits) >> stepShift);
+            restPower += (int64_t) error * error;
+            values[c] = (Sample) (output > limit ? limit : output < -limit - 1 ? -limit - 1 : output);
+        }
+        if (++trackCount == trackSamples) track(mask);
+    }
+
+    uint16_t frequency;         // of the mains, Hz, 0 when the canceller is off
+    uint16_t sampleRate;        // of the samples given to apply
+    uint8_t harmonics;          // lines cancelled
+
+    /**
+     * @description Frequency the reference follows, in Hz
+     */
+    float trackedFrequency(void) const
+    {
+        return (float) ((double) increment * sampleRate / 4294967296.0);
+    }
+
+private:
+    /**
+     * @description The frequency locked loop. Against a reference at the mains frequency the weights
+     *  of the fundamental stay put; when the mains runs faster they turn forward by the phase it gains
+     *  in a block, when it runs slower they turn back. The turn is weighted by the power of each
+     *  channel, and only measured when the fundamental stands out of the rest of the channels: the
+     *  weights of channels without mains wander with their noise
+     */
+    void track(uint8_t mask)
+    {
+        trackCount = 0;
+        float cross = 0, dot = 0, power = 0;
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (!(mask & (1 << c))) continue;
+            float aI = (float) tracked[c][0], aQ = (float) tracked[c][1];
+            float bI = (float) weights[c][0][0], bQ = (float) weights[c][0][1];
+            cross += aI * bQ - aQ * bI;
+            dot += aI * bI + aQ * bQ;
+            power += (bI * bI + bQ * bQ) / 2;
+            tracked[c][0] = weights[c][0][0];
+            tracked[c][1] = weights[c][0][1];
+        }
+        float rest = (float) restPower / trackSamples;
+        restPower = 0;
+        if (power * weightScale * MAINS_TRACK_SNR < rest || dot <= 0) return;
+        float turn = atan2f(cross, dot);    // radians in a block
+        offset += (int32_t) (turn * (float) (4294967296.0 / (2 * M_PI)) / (float) (trackSamples * MAINS_TRACK_GAIN));
+        if (offset > maxOffset) offset = maxOffset;
+        if (offset < -maxOffset) offset = -maxOffset;
+        increment = nominal + offset;
+    }
+
+    /**
+     * @description sin(2 pi angle / 2^32) in Q15, the error below 2^-11. The second and third
+     *  quarters are mirrored onto the first and the fourth
+     */
+    static int32_t sine(uint32_t angle)
+    {
+        int32_t x = (int32_t) angle;
+        if ((x ^ (x << 1)) < 0) x = (int32_t) (0x80000000UL - (uint32_t) x);
+        int32_t z = x >> 15;                // -1 to 1 for -pi / 2 to pi / 2, Q15
+        int32_t z2 = (z * z) >> 15;
+        return (z * (MAINS_SINE_A - ((z2 * (MAINS_SINE_B - ((z2 * MAINS_SINE_C) >> 15))) >> 15))) >> 15;
+    }
+
+    int32_t weights[Channels][MAINS_HARMONICS][2];  // amplitude of the sine and the cosine of each line, fractionBits fraction bits
+    int32_t offsets[Channels];      // mean of each channel, fractionBits fraction bits
+    int32_t tracked[Channels][2];   // weights of the fundamental at the last run of the loop
+    int32_t limit;                  // largest sample
+    uint8_t fractionBits;
+    uint8_t stepShift;              // LMS step size 2^-stepShift, smaller at the higher rates
+    uint8_t updateShift;            // of the product of error and reference to the weight update
+    uint32_t phase;                 // of the fundamental, a turn is 2^32
+    uint32_t nominal;               // phase increment of the nominal frequency
+    uint32_t increment;             // of the loop, nominal + offset
+    int32_t offset;
+    int32_t maxOffset;
+    uint16_t trackSamples;          // samples between two runs of the loop
+    uint16_t trackCount;
+    int64_t restPower;              // sum of the squares of the channels without the lines and the offsets, in the block
+    float weightScale;              // from a squared weight to counts^2
+    bool started;                   // the offsets start at the first sample
+};
+
+#endif //SOFTWARE_BRAINWEAR_MAINS_H
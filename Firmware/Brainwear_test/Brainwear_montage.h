@@ -0,0 +1,199 @@
+//
+// Montage of the EEG channels. Every channel is measured against SRB1; a montage replaces each
+// channel of the stream by an integer combination of the channels as measured, so the hosts get the
+// reference they want without computing it on every sample. It is a sparse matrix, a list of terms
+// (output channel, input channel, weight), and the row of an output is divided by the sum of its
+// positive weights: 2 EEG 1 - EEG 3 - EEG 4 is EEG 1 against the mean of EEG 3 and EEG 4. The common
+// average reference has its own path, one sum and one division per sample instead of a row per
+// channel. The results are clamped to the 24 bits of the ADS1299. It has no Arduino dependencies so
+// the host tools use it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_MONTAGE_H
+#define SOFTWARE_BRAINWEAR_MONTAGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MONTAGE_AS_MEASURED     0       // every channel against SRB1
+#define MONTAGE_COMMON_AVERAGE  1       // every active channel minus the mean of the active channels
+#define MONTAGE_BIPOLAR         2       // every active channel minus the next active one, the last as measured
+#define MONTAGE_CUSTOM          3       // the rows of a list of terms
+#define MONTAGE_MAX_TERMS       16      // terms of a custom montage
+#define MONTAGE_MAX_WEIGHT      9       // of a term, either sign: a row of 16 terms stays in 32 bits
+#define MONTAGE_TEXT            48      // characters of rowText, with the end
+#define MONTAGE_MAX_VALUE       8388607L    // 24 bits
+
+/** One entry of the matrix: weight times input is added to output */
+typedef struct {
+    uint8_t channels;   // output channel << 4 | input channel, from 0
+    int8_t weight;      // -MONTAGE_MAX_WEIGHT to MONTAGE_MAX_WEIGHT
+} MontageTerm;
+
+/**
+ * Montage of Channels channels. configure() takes the montage and the channels of the stream,
+ * apply() every frame in place
+ */
+template <uint8_t Channels>
+class Montage {
+public:
+    Montage()
+    {
+        configure(MONTAGE_AS_MEASURED, 0, 0, 0);
+    }
+
+    /**
+     * @description Sets one of the MONTAGE_ modes, with count terms for MONTAGE_CUSTOM, for a stream
+     *  of the channels of mask (bit c for channel c). The terms of the channels out of mask are left
+     *  out, a channel without terms stays as measured
+     */
+    void configure(uint8_t montageMode, const MontageTerm *terms, uint8_t count, uint8_t mask)
+    {
+        mode = montageMode;
+        channelMask = mask & ((1 << Channels) - 1);
+        channelCount = __builtin_popcount(channelMask);
+        rowCount = 0;
+        termCount = 0;
+        if (mode == MONTAGE_BIPOLAR) {
+            MontageTerm chain[2 * Channels];
+            uint8_t n = 0;
+            int8_t previous = -1;
+            for (uint8_t c = 0; c < Channels; c++) {
+                if (!(channelMask & (1 << c))) continue;
+                if (previous >= 0) {
+                    chain[n].channels = previous << 4 | previous;
+                    chain[n++].weight = 1;
+                    chain[n].channels = previous << 4 | c;
+                    chain[n++].weight = -1;
+                }
+                previous = c;
+            }
+            addRows(chain, n);
+        } else if (mode == MONTAGE_CUSTOM) {
+            addRows(terms, count);
+        }
+    }
+
+    /**
+     * @description Replaces the channels of values by those of the montage
+     */
+    void apply(int32_t *values) const
+    {
+        if (mode == MONTAGE_COMMON_AVERAGE) {
+            if (channelCount == 0) return;
+            int32_t sum = 0;
+            for (uint8_t c = 0; c < Channels; c++) {
+                if (channelMask & (1 << c)) sum += values[c];
+            }
+            int32_t mean = divide(sum, channelCount);
+            for (uint8_t c = 0; c < Channels; c++) {
+                if (channelMask & (1 << c)) values[c] = clamp(values[c] - mean);
+            }
+            return;
+        }
+        int32_t out[Channels];
+        for (uint8_t r = 0; r < rowCount; r++) {    // every row reads the channels as measured
+            const Row &row = rows[r];
+            int32_t sum = 0;
+            for (uint8_t t = row.first; t < row.first + row.count; t++) {
+                sum += terms[t].weight * values[terms[t].channels & 0x0F];
+            }
+            out[r] = clamp(row.divisor > 1 ? divide(sum, row.divisor) : sum);
+        }
+        for (uint8_t r = 0; r < rowCount; r++) values[rows[r].output] = out[r];
+    }
+
+    /**
+     * @description Describes channel c in text, with the channels counted from 1: "1-2", "(2*1-3-4)/2",
+     *  "1-average" for the common average, empty for a channel as measured
+     */
+    void rowText(uint8_t c, char *text) const
+    {
+        text[0] = '\0';
+        if (!(channelMask & (1 << c))) return;
+        if (mode == MONTAGE_COMMON_AVERAGE) {
+            snprintf(text, MONTAGE_TEXT, "%d-average", c + 1);
+            return;
+        }
+        for (uint8_t r = 0; r < rowCount; r++) {
+            const Row &row = rows[r];
+            if (row.output != c) continue;
+            int length = row.divisor > 1 ? snprintf(text, MONTAGE_TEXT, "(") : 0;
+            for (uint8_t t = row.first; t < row.first + row.count && length < MONTAGE_TEXT; t++) {
+                int weight = terms[t].weight;
+                const char *sign = weight < 0 ? "-" : t > row.first ? "+" : "";
+                int magnitude = weight < 0 ? -weight : weight;
+                int input = (terms[t].channels & 0x0F) + 1;
+                length += magnitude == 1 ? snprintf(text + length, MONTAGE_TEXT - length, "%s%d", sign, input)
+                                         : snprintf(text + length, MONTAGE_TEXT - length, "%s%d*%d", sign, magnitude, input);
+            }
+            if (row.divisor > 1 && length < MONTAGE_TEXT) snprintf(text + length, MONTAGE_TEXT - length, ")/%d", row.divisor);
+        }
+    }
+
+    uint8_t mode;               // MONTAGE_ mode
+    uint8_t channelMask;        // channels of the stream, bit c for channel c
+
+private:
+    /** The terms of one output channel */
+    typedef struct {
+        uint8_t output;
+        uint8_t first;          // first term of the row
+        uint8_t count;
+        uint8_t divisor;        // sum of the positive weights, at least 1
+    } Row;
+
+    enum { MAX_TERMS = MONTAGE_MAX_TERMS > 2 * Channels ? MONTAGE_MAX_TERMS : 2 * Channels };
+
+    /**
+     * @description Groups the terms of the channels of channelMask by output, the terms of the same
+     *  input added up
+     */
+    void addRows(const MontageTerm *list, uint8_t count)
+    {
+        for (uint8_t output = 0; output < Channels; output++) {
+            if (!(channelMask & (1 << output))) continue;
+            Row &row = rows[rowCount];
+            row.output = output;
+            row.first = termCount;
+            row.count = 0;
+            int16_t positive = 0;
+            for (uint8_t input = 0; input < Channels; input++) {
+                if (!(channelMask & (1 << input))) continue;
+                int16_t weight = 0;
+                for (uint8_t i = 0; i < count; i++) {
+                    if (list[i].channels == (output << 4 | input)) weight += list[i].weight;
+                }
+                if (weight == 0 || termCount == MAX_TERMS) continue;
+                if (weight > MONTAGE_MAX_WEIGHT) weight = MONTAGE_MAX_WEIGHT;
+                if (weight < -MONTAGE_MAX_WEIGHT) weight = -MONTAGE_MAX_WEIGHT;
+                terms[termCount].channels = output << 4 | input;
+                terms[termCount++].weight = (int8_t) weight;
+                row.count++;
+                if (weight > 0) positive += weight;
+            }
+            if (row.count == 0) continue;
+            row.divisor = positive > 1 ? (uint8_t) positive : 1;
+            rowCount++;
+        }
+    }
+
+    /** @description x / n rounded to the nearest integer */
+    static int32_t divide(int32_t x, int32_t n)
+    {
+        return (x >= 0 ? x + n / 2 : x - n / 2) / n;
+    }
+
+    static int32_t clamp(int32_t x)
+    {
+        return x > MONTAGE_MAX_VALUE ? MONTAGE_MAX_VALUE : x < -MONTAGE_MAX_VALUE - 1 ? -MONTAGE_MAX_VALUE - 1 : x;
+    }
+
+    MontageTerm terms[MAX_TERMS];   // of the rows, in order
+    Row rows[Channels];
+    uint8_t termCount;
+    uint8_t rowCount;
+    uint8_t channelCount;           // channels of channelMask
+};
+
+#endif //SOFTWARE_BRAINWEAR_MONTAGE_H
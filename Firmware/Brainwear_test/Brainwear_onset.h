@@ -0,0 +1,171 @@
+//
+// Onset and offset of the muscle contractions on the MMG channels, from the Teager-Kaiser energy
+// psi[n] = x[n-1]^2 - x[n] x[n-2] of the distance of each channel to a baseline. The energy follows
+// amplitude and frequency together, so the vibrations of a contraction stand well above the noise of
+// the piezo; on the FSR it comes with the force. It is summed over a short window and compared with
+// two thresholds that adapt to the noise floor of the channel: the mean of the energy at rest plus a
+// number of its mean deviations, a lower one for the offset. An onset needs the energy above the
+// first one for ONSET_ON_SAMPLES samples, an offset below the second one for ONSET_OFF_SAMPLES. The
+// baseline and the noise floor are only learnt at rest, so the end of a contraction leaves no
+// transient. Time constants are in samples, the times are those at 250 Hz. It has no Arduino
+// dependencies so the host build checks it too.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_ONSET_H
+#define SOFTWARE_BRAINWEAR_ONSET_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define ONSET_BASELINE_SHIFT 7      // the baseline follows the signal at rest with a time constant of 2^7 samples, 0.5 s
+#define ONSET_WINDOW_SHIFT   3      // the energy is the sum of the last 2^3 samples, 32 ms
+#define ONSET_WINDOW         (1 << ONSET_WINDOW_SHIFT)
+#define ONSET_NOISE_SHIFT    10     // the noise floor follows the energy at rest over 2^10 samples, 4 s
+#define ONSET_ACTIVE_SHIFT   3      // in a contraction the noise floor follows the energy 2^3 times slower
+#define ONSET_LEARN_SAMPLES  128    // no events until the noise floor has this many samples, 0.5 s
+#define ONSET_ON_DEVIATIONS  8      // onset threshold, deviations above the noise floor
+#define ONSET_OFF_DEVIATIONS 3      // offset threshold, lower so the events do not chatter
+#define ONSET_MIN_ENERGY     16     // counts^2 per sample added to both thresholds, for the channels without noise
+#define ONSET_ON_SAMPLES     5      // samples above the onset threshold for an onset, 20 ms
+#define ONSET_OFF_SAMPLES    25     // samples below the offset threshold for an offset, 100 ms
+#define ONSET_QUEUE          16     // events waiting to be sent, the next ones are dropped
+
+/** A contraction starting or ending on one channel */
+typedef struct {
+    uint32_t sample;    // first sample above the onset threshold or below the offset threshold
+    uint8_t channel;
+    bool onset;         // true at the start of the contraction, false at its end
+} OnsetEvent;
+
+/**
+ * Onset and offset detector of Channels channels. add() takes every sample and says when there are
+ * events, next() hands them over in the order they were detected
+ */
+template <uint8_t Channels>
+class OnsetDetector {
+public:
+    OnsetDetector()
+    {
+        started = false;
+        active = 0;
+        head = 0;
+        count = 0;
+    }
+
+    /**
+     * @description Adds the sample number sample of every channel. A sample that does not follow the
+     *  last one (a new stream, MMG turned off for a while) starts the detector again
+     * @returns true when the sample gave new events, for next
+     */
+    bool add(const int16_t *values, uint32_t sample)
+    {
+        if (!started || sample != nextSample) restart(values);
+        nextSample = sample + 1;
+        if (learned < (1 << ONSET_NOISE_SHIFT)) learned++;
+        uint8_t noiseShift = 31 - __builtin_clz(learned);  // a running mean until 2^ONSET_NOISE_SHIFT samples
+        bool events = false;
+        for (uint8_t c = 0; c < Channels; c++) {
+            if (!(active & (1 << c)) && run[c] == 0) {  // at rest
+                baseline[c] += ((int32_t) values[c] * 256 - baseline[c]) >> ONSET_BASELINE_SHIFT;
+            }
+            int32_t x = values[c] - (baseline[c] >> 8);
+            // not rectified, the products with the rest of the baseline cancel out in the window
+            int64_t psi = (int64_t) last[c][0] * last[c][0] - (int64_t) x * last[c][1];
+            last[c][1] = last[c][0];
+            last[c][0] = x;
+            windowSum[c] += psi - window[c][position];
+            window[c][position] = psi;
+            int64_t energy = windowSum[c] > 0 ? windowSum[c] << 8 : 0;   // as the noise floor
+
+            if (active & (1 << c)) {
+                // a channel whose noise rose during the contraction does not stay in it forever
+                noise[c] += (energy - noise[c]) >> (noiseShift + ONSET_ACTIVE_SHIFT);
+                run[c] = energy < threshold(c, ONSET_OFF_DEVIATIONS) ? run[c] + 1 : 0;
+                if (run[c] == ONSET_OFF_SAMPLES) {
+                    active &= ~(1 << c);
+                    events |= push(c, false, sample + 1 - ONSET_OFF_SAMPLES);
+                    run[c] = 0;
+                }
+            } else {
+                bool above = learned >= ONSET_LEARN_SAMPLES && energy > threshold(c, ONSET_ON_DEVIATIONS);
+                run[c] = above ? run[c] + 1 : 0;
+                if (run[c] == ONSET_ON_SAMPLES) {
+                    active |= 1 << c;
+                    events |= push(c, true, sample + 1 - ONSET_ON_SAMPLES);
+                    run[c] = 0;
+                } else if (run[c] == 0) { // at rest
+                    noise[c] += (energy - noise[c]) >> noiseShift;
+                    int64_t deviation = energy > noise[c] ? energy - noise[c] : noise[c] - energy;
+                    spread[c] += (deviation - spread[c]) >> noiseShift;
+                }
+            }
+        }
+        position = (position + 1) % ONSET_WINDOW;
+        return events;
+    }
+
+    /**
+     * @description Takes the oldest event waiting
+     * @returns false when there is none
+     */
+    bool next(OnsetEvent &event)
+    {
+        if (count == 0) return false;
+        event = queue[head];
+        head = (head + 1) % ONSET_QUEUE;
+        count--;
+        return true;
+    }
+
+    uint8_t active;             // channels in a contraction, bit c for channel c
+
+private:
+    void restart(const int16_t *values)
+    {
+        for (uint8_t c = 0; c < Channels; c++) baseline[c] = (int32_t) values[c] * 256;
+        memset(last, 0, sizeof(last));
+        memset(window, 0, sizeof(window));
+        memset(windowSum, 0, sizeof(windowSum));
+        position = 0;
+        memset(noise, 0, sizeof(noise));
+        memset(spread, 0, sizeof(spread));
+        memset(run, 0, sizeof(run));
+        learned = 0;
+        active = 0;
+        count = 0;
+        started = true;
+    }
+
+    int64_t threshold(uint8_t c, uint8_t deviations) const
+    {
+        return noise[c] + deviations * spread[c] + ((int64_t) ONSET_MIN_ENERGY << (8 + ONSET_WINDOW_SHIFT));
+    }
+
+    bool push(uint8_t c, bool onset, uint32_t sample)
+    {
+        if (count == ONSET_QUEUE) return false;
+        OnsetEvent &event = queue[(head + count) % ONSET_QUEUE];
+        event.sample = sample;
+        event.channel = c;
+        event.onset = onset;
+        count++;
+        return true;
+    }
+
+    int32_t baseline[Channels];     // slow mean of each channel, 8 fraction bits
+    int32_t last[Channels][2];      // distance to the baseline of the last two samples
+    int64_t window[Channels][ONSET_WINDOW];     // Teager-Kaiser energy of the last samples, counts^2
+    int64_t windowSum[Channels];    // the energy of the channel
+    int64_t noise[Channels];        // mean of the energy at rest, 8 fraction bits
+    int64_t spread[Channels];       // mean deviation of the energy at rest, 8 fraction bits
+    uint8_t run[Channels];          // samples past the threshold of the next event
+    uint8_t position;               // oldest entry of window
+    uint16_t learned;               // samples of the noise floor, up to 2^ONSET_NOISE_SHIFT
+    uint32_t nextSample;
+    bool started;
+    OnsetEvent queue[ONSET_QUEUE];
+    uint8_t head;                   // oldest event of queue
+    uint8_t count;                  // events in queue
+};
+
+#endif //SOFTWARE_BRAINWEAR_ONSET_H
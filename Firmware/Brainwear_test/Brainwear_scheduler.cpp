@@ -0,0 +1,171 @@
+//
+// Cooperative scheduler of the firmware, see Brainwear_scheduler.h
+//
+
+#include "Brainwear_scheduler.h"
+
+Scheduler scheduler;
+
+/**
+ * @description Takes the calling task (the one running loop()) as the one to wake
+ */
+void Scheduler::begin(void)
+{
+    task = xTaskGetCurrentTaskHandle();
+    resetStats();
+}
+
+/**
+ * @description Handler run every time the event is posted
+ */
+void Scheduler::onEvent(uint8_t event, SchedulerHandler handler, const char *name)
+{
+    if (event >= SCHEDULER_EVENTS) return;
+    handlers[event].function = handler;
+    handlers[event].name = name;
+}
+
+/**
+ * @description Handler run when the timer is due
+ */
+void Scheduler::onTimer(uint8_t timer, SchedulerHandler handler, const char *name)
+{
+    if (timer >= SCHEDULER_TIMERS) return;
+    handlers[SCHEDULER_EVENTS + timer].function = handler;
+    handlers[SCHEDULER_EVENTS + timer].name = name;
+}
+
+/**
+ * @description Posts an event from an interrupt
+ */
+void IRAM_ATTR Scheduler::postFromISR(uint8_t event)
+{
+    __atomic_fetch_or(&pending, 1UL << event, __ATOMIC_RELAXED);
+    if (task == NULL) return;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+/**
+ * @description Posts an event from a task or a callback, the loop() task included
+ */
+void Scheduler::post(uint8_t event)
+{
+    __atomic_fetch_or(&pending, 1UL << event, __ATOMIC_RELAXED);
+    if (task != NULL) xTaskNotifyGive(task);
+}
+
+/**
+ * @description Runs the handler of the timer after delayMs, then every periodMs if not 0.
+ *  Starting a running timer moves it
+ */
+void Scheduler::startTimer(uint8_t timer, uint32_t delayMs, uint32_t periodMs)
+{
+    if (timer >= SCHEDULER_TIMERS) return;
+    timers[timer].due = millis() + delayMs;
+    timers[timer].period = periodMs;
+    timers[timer].active = true;
+}
+
+void Scheduler::stopTimer(uint8_t timer)
+{
+    if (timer < SCHEDULER_TIMERS) timers[timer].active = false;
+}
+
+/**
+ * @description ms until the next timer is due, 0 if one is due already
+ */
+uint32_t Scheduler::nextTimer(uint32_t now)
+{
+    uint32_t wait = SCHEDULER_MAX_WAIT_MS;
+    for (uint8_t t = 0; t < SCHEDULER_TIMERS; t++) {
+        if (!timers[t].active) continue;
+        int32_t left = (int32_t) (timers[t].due - now);
+        if (left <= 0) return 0;
+        if ((uint32_t) left < wait) wait = left;
+    }
+    return wait;
+}
+
+/**
+ * @description One pass of loop(): sleeps while nothing is pending, then runs the handlers of the
+ *  pending events and of the timers due. Each event is taken just before its handler runs, so an
+ *  event posted by a handler is handled in the same pass by the handlers after it
+ */
+void Scheduler::run(void)
+{
+    if (pending == 0) {
+        uint32_t wait = nextTimer(millis());
+        if (wait > 0) {
+            uint32_t start = ESP.getCycleCount();
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(wait));
+            idleCycles += ESP.getCycleCount() - start;
+        }
+    }
+
+    for (uint8_t e = 0; e < SCHEDULER_EVENTS; e++) {
+        uint32_t bit = 1UL << e;
+        if (__atomic_fetch_and(&pending, ~bit, __ATOMIC_RELAXED) & bit) {
+            runHandler(e);
+        }
+    }
+
+    uint32_t now = millis();
+    for (uint8_t t = 0; t < SCHEDULER_TIMERS; t++) {
+        if (!timers[t].active || (int32_t) (timers[t].due - now) > 0) continue;
+        if (timers[t].period > 0) {
+            timers[t].due += timers[t].period;
+        } else {
+            timers[t].active = false;
+        }
+        runHandler(SCHEDULER_EVENTS + t);
+    }
+}
+
+void Scheduler::runHandler(uint8_t handler)
+{
+    Handler &h = handlers[handler];
+    if (h.function == NULL) return;
+    uint32_t start = ESP.getCycleCount();
+    h.function();
+    uint32_t cycles = ESP.getCycleCount() - start;
+    h.runs++;
+    h.cycles += cycles;
+    if (cycles > h.maxCycles) h.maxCycles = cycles;
+}
+
+/**
+ * @description Prints, since the last report, the runs and times of each handler and the share
+ *  of the CPU each one and the idle time took. The statistics start again afterwards
+ */
+void Scheduler::report(void)
+{
+    uint32_t cyclesPerMicro = ESP.getCpuFreqMHz();
+    uint64_t total = (uint64_t) (millis() - statsStart) * 1000 * cyclesPerMicro;
+    if (total == 0) total = 1;
+    Serial.println("handler, runs, mean us, max us, CPU %");
+    for (uint8_t i = 0; i < SCHEDULER_HANDLERS; i++) {
+        Handler &h = handlers[i];
+        if (h.function == NULL) continue;
+        Serial.print(h.name); Serial.print(", ");
+        Serial.print(h.runs); Serial.print(", ");
+        Serial.print(h.runs > 0 ? (uint32_t) (h.cycles / h.runs / cyclesPerMicro) : 0); Serial.print(", ");
+        Serial.print(h.maxCycles / cyclesPerMicro); Serial.print(", ");
+        Serial.println((double) h.cycles * 100 / total, 1);
+    }
+    Serial.print("idle, , , , ");
+    Serial.println((double) idleCycles * 100 / total, 1);
+    resetStats();
+}
+
+void Scheduler::resetStats(void)
+{
+    for (uint8_t i = 0; i < SCHEDULER_HANDLERS; i++) {
+        handlers[i].runs = 0;
+        handlers[i].cycles = 0;
+        handlers[i].maxCycles = 0;
+    }
+    idleCycles = 0;
+    statsStart = millis();
+}
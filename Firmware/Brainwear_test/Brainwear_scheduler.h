@@ -0,0 +1,72 @@
+//
+// Cooperative scheduler of the firmware. Interrupts and callbacks post events, loop() sleeps until
+// an event is pending or a timer is due and then runs the handler of each pending event, in the
+// order of the events, so a sample is always handled before the commands. Handlers run to
+// completion. The time of each handler and the time spent sleeping are measured, see report().
+//
+
+#ifndef SOFTWARE_BRAINWEAR_SCHEDULER_H
+#define SOFTWARE_BRAINWEAR_SCHEDULER_H
+
+#include <Arduino.h>
+
+// Events, in the order their handlers run
+#define EVENT_DRDY          0   // the ADS1299 has a sample, posted by ADS_DRDY_Service
+#define EVENT_SD            1   // the sample handled last is ready to be stored in the SD card
+#define EVENT_UART_RX       2   // bytes received on the serial port
+#define EVENT_FEATURES      3   // a window of the band powers is due
+#define EVENT_IMPEDANCE     4   // a block of the impedance estimates is ready
+#define EVENT_MMG_EVENTS    5   // onsets or offsets of the MMG channels are waiting to be sent
+#define SCHEDULER_EVENTS    6
+
+// Timers, each with its own handler
+#define TIMER_COMMAND       0   // end of a multi char command
+#define SCHEDULER_TIMERS    1
+
+#define SCHEDULER_HANDLERS  (SCHEDULER_EVENTS + SCHEDULER_TIMERS)
+#define SCHEDULER_MAX_WAIT_MS 1000  // longest sleep, keeps the idle time inside the cycle counter range
+
+typedef void (*SchedulerHandler)(void);
+
+class Scheduler {
+public:
+    void begin(void);
+    void onEvent(uint8_t event, SchedulerHandler handler, const char *name);
+    void onTimer(uint8_t timer, SchedulerHandler handler, const char *name);
+    void IRAM_ATTR postFromISR(uint8_t event);
+    void post(uint8_t event);
+    void startTimer(uint8_t timer, uint32_t delayMs, uint32_t periodMs = 0);
+    void stopTimer(uint8_t timer);
+    void run(void);
+    void report(void);
+    void resetStats(void);
+
+private:
+    struct Handler {
+        SchedulerHandler function;
+        const char *name;
+        uint32_t runs;
+        uint32_t maxCycles;
+        uint64_t cycles;
+    };
+
+    struct Timer {
+        boolean active;
+        uint32_t due;       // millis()
+        uint32_t period;    // ms, 0 for a single shot
+    };
+
+    void runHandler(uint8_t handler);
+    uint32_t nextTimer(uint32_t now);
+
+    TaskHandle_t task;          // task of loop(), woken by the notifications
+    volatile uint32_t pending;  // one bit per event
+    Handler handlers[SCHEDULER_HANDLERS];
+    Timer timers[SCHEDULER_TIMERS];
+    uint64_t idleCycles;        // spent sleeping since resetStats
+    uint32_t statsStart;        // millis() of resetStats
+};
+
+extern Scheduler scheduler;
+
+#endif //SOFTWARE_BRAINWEAR_SCHEDULER_H
@@ -8,6 +8,19 @@
 #include <mySD.h> //https://github.com/nhatuan84/esp32-micro-sdcard
 #include "SPI.h"
 #include <EEPROM.h>
+#include "Brainwear_SDformat.h"
+#include "Brainwear_BDF.h"
+#include "Brainwear_arena.h"
+#include "Brainwear_artifact.h"
+#include "Brainwear_scheduler.h"
+#include "Brainwear_trace.h"
+#include "Brainwear_block.h"
+#include "Brainwear_codec.h"
+#include "Brainwear_features.h"
+#include "Brainwear_impedance.h"
+#include "Brainwear_mains.h"
+#include "Brainwear_montage.h"
+#include "Brainwear_onset.h"
 
 // This library contains the firmware to interface the Brainwear board
 #include "Brainwear.h"
@@ -23,8 +36,45 @@ Brainwear  EEG;             // Declare an instance of the Brainwear module
 MMG        MMG1(ADS1x15_1); // Declare an instance of the MMG module, used for FSR
 MMG        MMG2(ADS1x15_2); // Declare an instance of the MMG module, used for Piezos
 
+typedef BlockStore<ADS_CHANNELS_BOARD, MMG_BOARDS*MMG_CHANNELS, BLOCK_FRAMES> SampleStore;
+SampleStore *sampleStore;   // Blocks of samples for the stages that work on whole blocks, in the arena
+
+#define CODEC_PACKET_HEADER 3   // ADS_BOP and the size of the block
+boolean codecSerial = false;    // Send compressed blocks instead of one packet per sample
+uint8_t *codecPacket;           // Serial packet of the last block coded by processBlock, in the arena
+uint8_t *codecBlock;            // The coded block, inside codecPacket
+size_t codecLength;             // Bytes of codecBlock
+size_t codecPacketLength;       // Bytes of codecPacket to send, 0 when it is not for the serial port
+size_t codecPacketSent;         // Bytes of codecPacket already sent
+uint32_t codecDrdyCycles;       // DRDY time of the last frame of the block in codecPacket
+boolean codecPending = false;   // codecBlock waits to be stored in the SD card
+
+typedef BandPowers<ADS_CHANNELS_BOARD> FeatureStage;
+FeatureStage *features;         // Band powers of the EEG channels, in the arena
+byte featureCounter;            // counter of the band power packets
+byte featureWindowMode;         // feature mode the windows were filled in, ADS_FEATURES_OFF to empty them
+
+typedef ImpedanceMeter<ADS_CHANNELS_BOARD> ImpedanceStage;
+ImpedanceStage *impedance;      // Amplitude of the lead-off excitation in the channels, in the arena
+byte impedanceCounter;          // counter of the impedance packets
+
+typedef ArtifactDetector<ADS_CHANNELS_BOARD> ArtifactStage;
+ArtifactStage *artifacts;       // Artifact flags of the EEG channels, in the arena
+uint32_t sampleArtifacts;       // flags of the last sample, for the SD card
+uint32_t packetArtifacts;       // flags of the samples of the next serial packet
+
+typedef Montage<ADS_CHANNELS_BOARD> MontageStage;
+MontageStage *montage;          // Montage of the EEG channels before the samples leave the board, in the arena
+
+typedef MainsCanceller<ADS_CHANNELS_BOARD> MainsStage;
+MainsStage *mains;              // Mains canceller of the EEG channels, the MMG boards have their own, in the arena
+
+typedef OnsetDetector<MMG_BOARDS*MMG_CHANNELS> OnsetStage;
+OnsetStage *onsets;             // Onsets and offsets of the contractions on the MMG channels, in the arena
+byte mmgEventCounter;           // counter of the MMG event packets
+
 // ENUMS
-typedef enum TX_MODE{ //How to send data
+enum TX_MODE { //How to send data
     DATA_RAW,   // Compatible with OpenBCI data visualization
     DATA_ASCII  // Compatible with Arduino serial plotter
 };
@@ -34,52 +84,226 @@ TX_MODE curTxMode;
 void setup() {
     curTxMode = DATA_RAW;   // Start sending in a mode compatible with OpenBCI
     delay(50);              //Gives time to the system to initalize
-    EEPROM.begin(2);        // Start the EEPROM to keep track of the files written in the SD card
+    EEPROM.begin(EEPROM_SIZE); // Start the EEPROM to keep track of the files written in the SD card
     EEG.begin();            // Start the Brainwear board
     MMG1.begin(GAIN_TWO,ADS1015_DR_3300SPS);        // FSR 2x gain   +/- 2.048V  1 bit = 1mV
     MMG2.begin(GAIN_SIXTEEN,ADS1015_DR_3300SPS);    // Piezo 16x gain  +/- 0.256V  1 bit = 0.125mV
+    sampleStore = arena.create<SampleStore>("Sample blocks");
+    codecPacket = arena.createArray<uint8_t>(CODEC_PACKET_HEADER + CODEC_MAX_BYTES(ADS_CHANNELS_BOARD, MMG_BOARDS*MMG_CHANNELS, BLOCK_FRAMES) + 1, "Codec packet");
+    codecBlock = codecPacket + CODEC_PACKET_HEADER;
+    features = arena.create<FeatureStage>("Band powers");
+    impedance = arena.create<ImpedanceStage>("Impedance");
+    onsets = arena.create<OnsetStage>("MMG onsets");
+    artifacts = arena.create<ArtifactStage>("Artifacts");
+    setArtifactLimits();
+    montage = arena.create<MontageStage>("Montage");
+    setMontage();
+    mains = arena.create<MainsStage>("EEG mains", (int32_t) 8388607L); // 24 bits
+    setMains();
+    beginSD();              // Buffers of the SD recording
     setCurTxMode(curTxMode);
+
+    // Everything from here on runs in the handlers of the scheduler
+    scheduler.onEvent(EVENT_DRDY, handleSample, "sample");
+    scheduler.onEvent(EVENT_SD, handleSD, "SD");
+    scheduler.onEvent(EVENT_UART_RX, handleCommand, "command");
+    scheduler.onEvent(EVENT_FEATURES, handleFeatures, "band powers");
+    scheduler.onEvent(EVENT_IMPEDANCE, handleImpedance, "impedance");
+    scheduler.onEvent(EVENT_MMG_EVENTS, handleMMGEvents, "MMG events");
+    scheduler.onTimer(TIMER_COMMAND, handleCommandTimeout, "command timeout");
+    Serial.onReceive(serialReceived);
+    scheduler.begin();
+    scheduler.post(EVENT_UART_RX); // bytes received during the setup
 }
 
 void loop(){
-    if (EEG.streaming) {
-        if(EEG.channelDataAvailable)
-        {
-            // Read from the Brainwear, store data, set channelDataAvailable flag to false
-            EEG.updateChannelData();
+    scheduler.run(); // sleeps until there is something to do
+}
 
-            // If multimode is active, update data from MMG sensors
-            if(multimode) {
-                MMG1.updateMMGData();
-                MMG2.updateMMGData();
-                addAuxtoSD = true;
-            }
+//////////////////////////////////////////////
+/////////// Event handlers ///////////////////
+//////////////////////////////////////////////
 
-            // If SD was activated, store data in SD card
-            if(SDfileOpen){
-                writeDataToSDcard(EEG.sampleCounter);
-            }
+/**
+ * @description: EVENT_DRDY, reads the sample of the Brainwear and MMG boards and sends it
+ */
+void handleSample(void){
+    if (!EEG.streaming || !EEG.channelDataAvailable) return;
+
+    // Read from the Brainwear, store data, set channelDataAvailable flag to false
+    EEG.updateChannelData();
 
-            // Send data to the serial port
+    // Flags of the sample for the SD card, those of a serial packet add up until it is sent. They
+    // are checked on the codes of the ADS1299, before the mains canceller changes them
+    if(EEG.artifactMode != ADS_ARTIFACTS_OFF) {
+        sampleArtifacts = artifacts->check(EEG.boardChannelDataInt, EEG.activeChannels, sampleStore->sampleNumber());
+        packetArtifacts |= sampleArtifacts;
+    } else {
+        sampleArtifacts = 0;
+    }
+
+    // The mains comes out of the channels before the rest, so it does not leak into the impedance.
+    // The MMG boards take it out of their samples as they read them
+    if(EEG.mainsMode != ADS_MAINS_OFF) {
+        TRACE_SCOPE(TRACE_MAINS, 0);
+        mains->apply(EEG.boardChannelDataInt, EEG.activeChannels);
+    }
+
+    // One Goertzel step per sample on the channels with lead-off, the estimates are sent in their handler
+    if(EEG.impedanceMode != ADS_IMPEDANCE_OFF) {
+        if(impedance->sampleRate != EEG.getSampleRateHz() || impedance->frequency != EEG.getLeadOffFrequencyHz()) {
+            impedance->begin(EEG.getSampleRateHz(), EEG.getLeadOffFrequencyHz());
+        }
+        if(impedance->add(EEG.boardChannelDataInt, EEG.leadOffChannels)) scheduler.post(EVENT_IMPEDANCE);
+    }
+
+    // The flags and the impedance are those of each electrode, everything after them sees the
+    // channels of the montage
+    if(EEG.montage != MONTAGE_AS_MEASURED) montage->apply(EEG.boardChannelDataInt);
+    sampleStore->addEEG(EEG.boardChannelDataInt);
+
+    // If multimode is active, update data from MMG sensors
+    if(multimode) {
+        MMG1.updateMMGData();
+        MMG2.updateMMGData();
+        sampleStore->addMMG(0, MMG1.MMGData, MMG_CHANNELS);
+        sampleStore->addMMG(MMG_CHANNELS, MMG2.MMGData, MMG_CHANNELS);
+        addAuxtoSD = true;
+
+        // The onsets and offsets are sent in their own handler, timestamped with the sample number
+        if(EEG.mmgEventMode != ADS_MMG_EVENTS_OFF) {
+            int16_t values[MMG_BOARDS*MMG_CHANNELS];
+            memcpy(values, MMG1.MMGData, sizeof(MMG1.MMGData));
+            memcpy(values + MMG_CHANNELS, MMG2.MMGData, sizeof(MMG2.MMGData));
+            if(onsets->add(values, sampleStore->sampleNumber())) scheduler.post(EVENT_MMG_EVENTS);
+        }
+    }
+
+    // If SD was activated, store every sample in the SD card, right after this handler
+    if(SDfileOpen){
+        scheduler.post(EVENT_SD);
+    }
+
+    // The band powers are computed after the SD card, in their own handler. A new stream, sample
+    // rate or mode starts with empty windows
+    if(EEG.featureMode != ADS_FEATURES_OFF) {
+        if(featureWindowMode != EEG.featureMode || features->sampleRate != EEG.getSampleRateHz()) {
+            features->begin(EEG.getSampleRateHz());
+            featureWindowMode = EEG.featureMode;
+        }
+        if(features->add(EEG.boardChannelDataInt)) scheduler.post(EVENT_FEATURES);
+    } else {
+        featureWindowMode = ADS_FEATURES_OFF;
+    }
+
+    // Send the average of the last EEG.serialDecimation samples to the serial port. Compressed
+    // blocks carry every sample, the last coded block is sent a slice at a time
+    if(EEG.featureMode == ADS_FEATURES_ONLY || EEG.impedanceMode == ADS_IMPEDANCE_ONLY) {
+        // no sample packets
+    } else if(sendsCodecBlocks()) {
+        sendCodecPacket();
+    } else {
+        if(multimode) {
+            MMG1.decimateMMGData();
+            MMG2.decimateMMGData();
+        }
+        if(EEG.decimateChannelData()) {
+            if(multimode) {
+                MMG1.averageMMGData();
+                MMG2.averageMMGData();
+            }
             sendData();
+            if (EEG.serial_stream) EEG.measureLatency();
         }
     }
 
-    // Check the serial ports for new data
-    if (hasDataSerial()){
-        char newChar = getCharSerial();
+    // Every BLOCK_FRAMES samples a block is complete
+    SampleStore::Block *block = sampleStore->commit();
+    if (block != NULL) {
+        processBlock(block);
+    }
+}
+
+/**
+ * @description: EVENT_SD, stores the sample read by handleSample. It runs before the next sample
+ *  is read and before any command, so a command that stops or closes the file comes after the
+ *  last sample
+ */
+void handleSD(void){
+    if(SDfileOpen){
+        writeDataToSDcard();
+    }
+}
 
-        // Send command to the board
-        boardProcessChar(newChar);
+/**
+ * @description: EVENT_FEATURES, band powers of the last window of the active channels
+ */
+void handleFeatures(void){
+    if(!EEG.streaming || EEG.featureMode == ADS_FEATURES_OFF) return;
+    features->compute(EEG.activeChannels);
+    if(EEG.serial_stream && curTxMode == DATA_RAW) sendFeatures();
+}
 
-        // Send command to the SD library
-        sdProcessChar(newChar);
+/**
+ * @description: EVENT_IMPEDANCE, sends the impedance of the channels measured in the last block
+ */
+void handleImpedance(void){
+    if(!EEG.streaming || EEG.impedanceMode == ADS_IMPEDANCE_OFF) return;
+    if(EEG.serial_stream && curTxMode == DATA_RAW) sendImpedance();
+}
 
-        // Send command to the Brainwear library
-        EEG.processChar(newChar);
+/**
+ * @description: EVENT_MMG_EVENTS, sends the onsets and offsets detected since the last sample
+ */
+void handleMMGEvents(void){
+    OnsetEvent event;
+    while(onsets->next(event)){
+        if(EEG.streaming && EEG.serial_stream && curTxMode == DATA_RAW) sendMMGEvent(event);
     }
+}
+
+/**
+ * @description: EVENT_UART_RX, processes one command char. The event is posted again while
+ *  chars are waiting so a sample is never delayed by more than one command
+ */
+void handleCommand(void){
+    if (!hasDataSerial()) return;
+    char newChar = getCharSerial();
+    TRACE_SCOPE(TRACE_COMMAND, newChar);
+
+    // Send command to the board
+    boardProcessChar(newChar);
+
+    // Send command to the SD library
+    sdProcessChar(newChar);
+
+    // Send command to the Brainwear library
+    EEG.processChar(newChar);
+
+    // The gains, the sample rate, the channels, the montage or the mains may have changed
+    setArtifactLimits();
+    setMontage();
+    setMains();
+
+    // The last block of a stream stopped by the command, once the ADS1299 is stopped
+    if (!EEG.streaming) finishCodecPacket();
+
+    scheduler.startTimer(TIMER_COMMAND, MULTI_CHAR_COMMAND_TIMEOUT_MS);
+    if (hasDataSerial()) scheduler.post(EVENT_UART_RX);
+}
+
+/**
+ * @description: TIMER_COMMAND, ends a multi char command that was not completed in time
+ */
+void handleCommandTimeout(void){
     EEG.loop();
+}
 
+/**
+ * @description: Called by the serial port when bytes are received
+ */
+void serialReceived(void){
+    scheduler.post(EVENT_UART_RX);
 }
 
 //////////////////////////////////////////////
@@ -90,40 +314,227 @@ void loop(){
  * @description: Changes the transmission mode in the Brainwear and MMG boards
  */
 void setCurTxMode(TX_MODE TxMode){
-    if (curTxMode == DATA_RAW){
+    if (TxMode == DATA_RAW){
         EEG.setCurTxMode(EEG.DATA_RAW);
         MMG1.setCurTxMode(MMG1.DATA_RAW);
         MMG2.setCurTxMode(MMG2.DATA_RAW);
     }
-    if (curTxMode == DATA_ASCII){
+    if (TxMode == DATA_ASCII){
         EEG.setCurTxMode(EEG.DATA_ASCII);
         MMG1.setCurTxMode(MMG1.DATA_ASCII);
         MMG2.setCurTxMode(MMG2.DATA_ASCII);
     }
 }
 
+/**
+ * @description: Gives the gains and the sample rate of the ADS1299 to the artifact detector
+ */
+void setArtifactLimits(void){
+    uint8_t gains[ADS_CHANNELS_BOARD];
+    for(int c = 0; c < ADS_CHANNELS_BOARD; c++) gains[c] = EEG.getChannelGain(c);
+    artifacts->setLimits(EEG.getSampleRateHz(), gains);
+}
+
+/**
+ * @description: Gives the montage and the channels of the stream to the montage stage
+ */
+void setMontage(void){
+    montage->configure(EEG.montage, EEG.montageTerms, EEG.montageTermCount, EEG.activeChannels);
+}
+
+/**
+ * @description: Gives the mains frequency and the sample rate to the mains cancellers of the EEG and
+ *  MMG channels, the MMG boards are read once per sample of the ADS1299
+ */
+void setMains(void){
+    unsigned int mainsHz = EEG.getMainsFrequencyHz();
+    mains->configure(mainsHz, EEG.getSampleRateHz());
+    MMG1.mains->configure(mainsHz, EEG.getSampleRateHz());
+    MMG2.mains->configure(mainsHz, EEG.getSampleRateHz());
+}
+
+/**
+ * @description: Runs the stages that work on whole blocks of samples and gives the block back to
+ *  the store. The block stays valid until it is released
+ */
+void processBlock(SampleStore::Block *block){
+    boolean toSerial = sendsCodecBlocks();
+    boolean toSD = sdStoresCodecBlocks();
+    if(toSerial || toSD){
+        finishCodecPacket(); // codecPacket is reused, the previous block has to be out
+        codecLength = codecEncodeBlock(*block, codecBlock, EEG.activeChannels); // coded once for both
+        if(toSerial){
+            codecPacket[0] = ADS_BOP;
+            codecPacket[1] = codecLength & 0xFF;
+            codecPacket[2] = codecLength >> 8;
+            codecBlock[codecLength] = ADS_EOP_CODEC;
+            codecPacketLength = CODEC_PACKET_HEADER + codecLength + 1;
+            codecPacketSent = 0;
+            codecDrdyCycles = EEG.sampleDrdyCycles; // the block ends with the sample just read
+            sendCodecPacket();
+        }
+        codecPending = toSD;
+    }
+    sampleStore->release(block);
+}
+
+/**
+ * @description: Hands the frames of the block being filled to processBlock, when the stream stops
+ *  or the recording ends
+ */
+void flushBlock(void){
+    SampleStore::Block *block = sampleStore->flush();
+    if (block != NULL) {
+        processBlock(block);
+    }
+    if (!EEG.streaming) finishCodecPacket(); // no sample will send the rest
+}
+
+/**
+ * @description: True when the serial port gets compressed blocks instead of sample packets
+ */
+boolean sendsCodecBlocks(void){
+    return codecSerial && curTxMode == DATA_RAW && EEG.serial_stream;
+}
+
+/**
+ * @description: Sends what fits in the transmit FIFO of the packet of the coded block: ADS_BOP,
+ *  size (2 bytes, little endian), block, ADS_EOP_CODEC. Called on every sample, so a block goes
+ *  out during the next one without waiting for the UART
+ */
+void sendCodecPacket(void){
+    if(codecPacketSent >= codecPacketLength) return;
+    TRACE_SCOPE(TRACE_SEND, 1);
+    size_t room = Serial.availableForWrite();
+    size_t count = codecPacketLength - codecPacketSent;
+    if(count > room) count = room;
+    Serial.write(codecPacket + codecPacketSent, count);
+    codecPacketSent += count;
+    if(codecPacketSent >= codecPacketLength) codecPacketDone();
+}
+
+/**
+ * @description: Sends the rest of the packet of the coded block, waiting for the UART
+ */
+void finishCodecPacket(void){
+    if(codecPacketSent >= codecPacketLength) return;
+    Serial.write(codecPacket + codecPacketSent, codecPacketLength - codecPacketSent);
+    codecPacketSent = codecPacketLength;
+    codecPacketDone();
+}
+
+/**
+ * @description: The last byte of the packet of the coded block is queued, adds its latency from the
+ *  DRDY of the last frame of the block
+ */
+void codecPacketDone(void){
+    if (EEG.serial_stream) EEG.measureLatency(codecDrdyCycles);
+}
+
+/**
+ * @description: Sends the band powers: ADS_BOP, packet counter, mask of the active channels, then
+ *  for each active channel the levels of its FEATURE_BANDS bands (delta, theta, alpha, beta, gamma)
+ *  in hundredths of dB re 1 uV^2, 16 bits big endian, and ADS_EOP_FEATURES. FEATURE_NO_POWER
+ *  marks a band without power
+ */
+void sendFeatures(void){
+    TRACE_SCOPE(TRACE_SEND, 2);
+    Serial.write(ADS_BOP);
+    Serial.write(featureCounter++);
+    Serial.write(EEG.activeChannels);
+    for(int c = 0; c < ADS_CHANNELS_BOARD; c++){
+        if(!bitRead(EEG.activeChannels, c)) continue;
+        // one count is 4.5 V / gain / 2^23
+        int32_t offset = lrint(2000 * log10(4500000.0 / EEG.getChannelGain(c) / 8388608.0));
+        for(int band = 0; band < FEATURE_BANDS; band++){
+            int32_t level = features->levels[c][band];
+            if(level != FEATURE_NO_POWER) level = constrain(level + offset, INT16_MIN + 1, INT16_MAX);
+            Serial.write((uint8_t)(level >> 8));
+            Serial.write((uint8_t)(level & 0xFF));
+        }
+    }
+    Serial.write((uint8_t)(ADS_EOP_FEATURES));
+}
+
+/**
+ * @description: Sends the impedances: ADS_BOP, packet counter, mask of the channels measured (active,
+ *  with lead-off enabled), then for each of them the impedance in units of 100 ohm, 16 bits big endian
+ *  (0xFFFF for 6.5 Mohm or more), and ADS_EOP_IMPEDANCE. With lead-off on the P and N inputs of a
+ *  channel it is the sum of both electrodes
+ */
+void sendImpedance(void){
+    TRACE_SCOPE(TRACE_SEND, 3);
+    Serial.write(ADS_BOP);
+    Serial.write(impedanceCounter++);
+    Serial.write(impedance->measured);
+    // the fundamental of the square wave current is 4 / pi times its amplitude
+    float current = EEG.getLeadOffCurrent() * 4 / (float) M_PI;
+    for(int c = 0; c < ADS_CHANNELS_BOARD; c++){
+        if(!bitRead(impedance->measured, c)) continue;
+        // one count is 4.5 V / gain / 2^23
+        float ohms = impedance->amplitude[c] * (4.5f / EEG.getChannelGain(c) / 8388608.0f) / current;
+        uint16_t value = ohms < 6553450.0f ? (uint16_t) lrintf(ohms / 100) : 0xFFFF;
+        Serial.write((uint8_t)(value >> 8));
+        Serial.write((uint8_t)(value & 0xFF));
+    }
+    Serial.write((uint8_t)(ADS_EOP_IMPEDANCE));
+}
+
+/**
+ * @description: Sends an MMG event: ADS_BOP, packet counter, the channel (0 to 3 for the FSR, 4 to 7
+ *  for the piezos) with bit 7 set for an onset and clear for an offset, the number of its first
+ *  sample counted from the start of the stream (32 bits, big endian) and ADS_EOP_MMG_EVENT
+ */
+void sendMMGEvent(const OnsetEvent &event){
+    TRACE_SCOPE(TRACE_SEND, 4);
+    Serial.write(ADS_BOP);
+    Serial.write(mmgEventCounter++);
+    Serial.write((uint8_t)(event.channel | (event.onset ? 0x80 : 0)));
+    for(int shift = 24; shift >= 0; shift -= 8){
+        Serial.write((uint8_t)(event.sample >> shift));
+    }
+    Serial.write((uint8_t)(ADS_EOP_MMG_EVENT));
+}
+
+/**
+ * @description: Sends the MMG values of the packet: for each output of the packets (raw, envelope,
+ *  RMS) the channels of MMG1 then those of MMG2, in the order of the SD files
+ */
+void sendMMGData(void){
+    for(int output = 0; output < MMG_OUTPUTS; output++){
+        if(!bitRead(EEG.getPacketMMGOutputs(), output)) continue;
+        MMG1.sendMMGData(EEG.serial_stream, 1 << output);
+        MMG2.sendMMGData(EEG.serial_stream, 1 << output);
+    }
+}
+
 /**
  * @description: Sends data to serial port
  */
 void sendData(void){
+    TRACE_SCOPE(TRACE_SEND, 0);
     if (curTxMode == DATA_RAW){
         Serial.write(ADS_BOP); // 1 byte
         Serial.write(EEG.sampleCounter); // 1 byte
         EEG.sendChannelData(); //compatible with OpenBCI data visualize (24 bytes or less (12 for 4 channels)
         if(multimode) {
-            MMG1.sendMMGData(EEG.serial_stream); // (8 bytes)
-            MMG2.sendMMGData(EEG.serial_stream); // (8 bytes)
+            sendMMGData(); // (16 bytes for each output)
+        }
+        if(EEG.artifactMode != ADS_ARTIFACTS_OFF) {
+            for(int kind = ARTIFACT_SATURATED; kind <= ARTIFACT_TRANSIENT; kind += 8) {
+                Serial.write((uint8_t)(packetArtifacts >> kind)); // (3 bytes, a mask of the channels for each kind)
+            }
         }
         Serial.write((uint8_t)(ADS_EOP)); //(1 byte)
     }
     if (curTxMode == DATA_ASCII){
         EEG.sendChannelData(); //compatible with Arduino serial plotter
         if(multimode){
-            MMG1.sendMMGData(EEG.serial_stream);
-            MMG2.sendMMGData(EEG.serial_stream);
+            sendMMGData();
         }
         Serial.println();
     }
+    packetArtifacts = 0;
 }
 
 /**
@@ -150,6 +561,35 @@ char boardProcessChar(char character) {
             multimode = false;
             Serial.println("Multimode deactivated");
             break;
+        case ADS_STREAM_START:
+            sampleStore->reset(); // blocks start with the stream
+            packetArtifacts = 0;
+            featureWindowMode = ADS_FEATURES_OFF; // and the band power windows
+            codecPending = false;
+            break;
+        case ADS_STREAM_STOP:
+            flushBlock();
+            break;
+        case ADS_CODEC_ON:
+            codecSerial = true;
+            Serial.println("Compressed stream on");
+            break;
+        case ADS_CODEC_OFF:
+            finishCodecPacket();
+            codecSerial = false;
+            Serial.println("Compressed stream off");
+            break;
+        case ADS_TRACE_DUMP:
+            traceDump();
+            break;
+        case ADS_SCHEDULER_REPORT:
+            scheduler.report();
+            break;
+        case ADS_MEMORY_REPORT:
+            arena.report();
+            Serial.print("Sample blocks: "); Serial.print(sampleStore->completed);
+            Serial.print(" completed, "); Serial.print(sampleStore->overruns); Serial.println(" overruns");
+            break;
         default:
             break;
     }
@@ -186,5 +626,13 @@ char getCharSerial(void)
 //////////////////////////////////////////////
 void IRAM_ATTR ADS_DRDY_Service()
 {
+    TRACE_DRDY_ISR();
+    uint32_t now = ESP.getCycleCount();
+    if (EEG.drdyCount > 0) {
+        EEG.drdyInterval.add((now - EEG.drdyCycles) / EEG.cyclesPerMicro);
+    }
+    EEG.drdyCycles = now;
+    EEG.drdyCount++;
     EEG.channelDataAvailable = true;
+    scheduler.postFromISR(EVENT_DRDY);
 }
\ No newline at end of file
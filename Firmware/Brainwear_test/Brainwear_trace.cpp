@@ -0,0 +1,40 @@
+//
+// Trace ring of the acquisition path, see Brainwear_trace.h
+//
+
+#include "Brainwear_trace.h"
+#include <Arduino.h>
+
+#if BRAINWEAR_TRACE
+TraceEvent traceRing[TRACE_RING_SIZE];
+uint32_t traceHead = 0;
+boolean traceEnabled = true;
+volatile uint32_t traceDrdyCycles = 0;
+#endif
+
+/**
+ * @description Sends the events of the ring to the serial port in binary, oldest first, and
+ *  empties it. Nothing is recorded during the dump
+ */
+void traceDump(void)
+{
+#if BRAINWEAR_TRACE
+    traceEnabled = false;
+    uint32_t count = traceHead < TRACE_RING_SIZE ? traceHead : TRACE_RING_SIZE;
+    TraceDumpHeader header;
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.cpuMHz = ESP.getCpuFreqMHz();
+    header.count = count;
+    header.lost = traceHead - count;
+    Serial.write((const uint8_t *) &header, sizeof(header));
+    for (uint32_t i = traceHead - count; i != traceHead; i++) {
+        Serial.write((const uint8_t *) &traceRing[i & (TRACE_RING_SIZE - 1)], sizeof(TraceEvent));
+    }
+    traceHead = 0;
+    traceEnabled = true;
+#else
+    Serial.println("Trace disabled, set BRAINWEAR_TRACE to 1 in Brainwear_trace.h");
+#endif
+    Serial.print("$$$");
+}
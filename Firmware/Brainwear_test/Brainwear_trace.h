@@ -0,0 +1,115 @@
+//
+// Trace of the acquisition path. Stages record their begin and end with the cycle counter of the
+// ESP32 into a ring in RAM, that is dumped to the serial port on command. The dump layout is
+// shared with trace_to_chrome in Brainwear_tools.
+//
+
+#ifndef SOFTWARE_BRAINWEAR_TRACE_H
+#define SOFTWARE_BRAINWEAR_TRACE_H
+
+#include <stdint.h>
+
+/**
+ * Dump layout, little endian:
+ *
+ *  | TraceDumpHeader | TraceEvent 0 | ... | TraceEvent count-1 | "$$$"
+ *
+ * Events are sent oldest first. lost counts the events overwritten in the ring since the previous
+ * dump. cycles wraps around every 2^32 cycles (17.9 s at 240 MHz).
+ */
+#define TRACE_MAGIC            0x52545742UL  // "BWTR"
+#define TRACE_VERSION          1
+#define TRACE_RING_SIZE        1024          // events, power of two (8 KB)
+
+// Stages
+#define TRACE_DRDY             0    // DRDY interrupt, instant
+#define TRACE_UPDATE_BOARD     1    // updateBoardData
+#define TRACE_UPDATE_MMG       2    // MMG::updateMMGData, arg is the I2C address
+#define TRACE_SD_SAMPLE        3    // writeDataToSDcard
+#define TRACE_SD_BLOCK         4    // writeCache, arg is the block number (low 16 bits)
+#define TRACE_SEND             5    // sendData
+#define TRACE_COMMAND          6    // processing of a serial command, arg is the character
+#define TRACE_MAINS            7    // mains canceller, arg is 0 for the EEG, the I2C address for the MMG
+#define TRACE_STAGES           8
+
+// Phases
+#define TRACE_BEGIN            0
+#define TRACE_END              1
+#define TRACE_INSTANT          2
+
+typedef struct {
+    uint32_t cycles;    // ESP.getCycleCount()
+    uint8_t stage;      // TRACE_DRDY ... TRACE_COMMAND
+    uint8_t phase;      // TRACE_BEGIN, TRACE_END or TRACE_INSTANT
+    uint16_t arg;       // depends on the stage
+} TraceEvent;
+
+typedef struct {
+    uint32_t magic;     // TRACE_MAGIC
+    uint16_t version;   // TRACE_VERSION
+    uint16_t cpuMHz;    // cycles per microsecond
+    uint32_t count;     // events that follow
+    uint32_t lost;      // events overwritten before this dump
+} TraceDumpHeader;
+
+#ifdef ARDUINO
+
+// Set to 1 to record the trace. At 0 the trace points compile to nothing
+#ifndef BRAINWEAR_TRACE
+#define BRAINWEAR_TRACE 0
+#endif
+
+void traceDump(void);
+
+#if BRAINWEAR_TRACE
+
+#include <Arduino.h>
+
+extern TraceEvent traceRing[TRACE_RING_SIZE];
+extern uint32_t traceHead;                  // events recorded since the last dump
+extern boolean traceEnabled;                // false while dumping
+extern volatile uint32_t traceDrdyCycles;   // time of the last DRDY interrupt
+
+/**
+ * @description Adds an event to the ring. Only called from loop(), the interrupt just stores
+ *  its time in traceDrdyCycles so the ring needs no locking
+ */
+static inline void traceRecord(uint8_t stage, uint8_t phase, uint16_t arg, uint32_t cycles)
+{
+    if (!traceEnabled) return;
+    TraceEvent *event = &traceRing[traceHead & (TRACE_RING_SIZE - 1)];
+    event->cycles = cycles;
+    event->stage = stage;
+    event->phase = phase;
+    event->arg = arg;
+    traceHead++;
+}
+
+/** Records the begin of a stage on construction and its end when it goes out of scope */
+class TraceScope {
+public:
+    TraceScope(uint8_t traceStage, uint16_t traceArg) : stage(traceStage), arg(traceArg) {
+        traceRecord(stage, TRACE_BEGIN, arg, ESP.getCycleCount());
+    }
+    ~TraceScope() {
+        traceRecord(stage, TRACE_END, arg, ESP.getCycleCount());
+    }
+private:
+    uint8_t stage;
+    uint16_t arg;
+};
+
+#define TRACE_SCOPE(stage, arg)  TraceScope traceScope(stage, arg)
+#define TRACE_DRDY_ISR()         (traceDrdyCycles = ESP.getCycleCount())
+#define TRACE_DRDY_RECORD()      traceRecord(TRACE_DRDY, TRACE_INSTANT, 0, traceDrdyCycles)
+
+#else
+
+#define TRACE_SCOPE(stage, arg)
+#define TRACE_DRDY_ISR()
+#define TRACE_DRDY_RECORD()
+
+#endif // BRAINWEAR_TRACE
+#endif // ARDUINO
+
+#endif //SOFTWARE_BRAINWEAR_TRACE_H
@@ -3,62 +3,195 @@
 //
 
 #include "MMG.h"
+#include "Brainwear_arena.h"
+#include "Brainwear_definitions.h"
+#include "Brainwear_trace.h"
 
 // Constructor
 MMG::MMG(uint8_t i2cAddress){
-    MMG_ads = new Adafruit_ADS1115(i2cAddress);
+    MMG_ads = NULL;
+    mains = NULL;
+    address = i2cAddress;
     curTxMode = DATA_RAW;
+    MMGSumCount = 0;
+    for (int chan = 0; chan < MMG_CHANNELS; chan++){
+        MMGSerialData[chan] = 0;
+    }
+    envelopeStarted = false;
+    squareIndex = 0;
 };
 
 /**
  * @description: This function starts the ADS1015 module setting gain and Sample rate
 */
 void MMG::begin(adsGain_t GAIN, adsSPS_t SAMPLE_RATE){
+    if (MMG_ads == NULL) MMG_ads = arena.create<Adafruit_ADS1115>("ADS1015", address);
+    if (mains == NULL) mains = arena.create<MainsCanceller<MMG_CHANNELS> >("MMG mains", (int32_t) INT16_MAX);
     MMG_ads->setGain(GAIN);        // 2x gain   +/- 2.048V  1 bit = 1mV (2x FSR, 16x piezo)
     MMG_ads->setSPS(SAMPLE_RATE); //3300 SPS -> Each channel takes around 630 us to be read
     MMG_ads->begin();
 }
 
+/**
+ * @description: Full scale range of the current gain in mV
+*/
+int MMG::getFullScaleMilliVolts(void){
+    switch (MMG_ads->getGain()){
+        case GAIN_TWOTHIRDS: return 6144;
+        case GAIN_ONE:       return 4096;
+        case GAIN_TWO:       return 2048;
+        case GAIN_FOUR:      return 1024;
+        case GAIN_EIGHT:     return 512;
+        case GAIN_SIXTEEN:   return 256;
+        default:             return 6144;
+    }
+}
+
 /**
  * @description: This function update the data acquired by the ADS1015
 */
 void MMG::updateMMGData(void){
+    TRACE_SCOPE(TRACE_UPDATE_MMG, address);
     for (int chan = 0; chan < MMG_CHANNELS; chan++){
         MMGData[chan] = MMG_ads->readADC_SingleEnded(chan);
     }
+    if (mains->frequency != 0){ // the envelope and the RMS see the samples without the mains
+        TRACE_SCOPE(TRACE_MAINS, address);
+        mains->apply(MMGData, (1 << MMG_CHANNELS) - 1);
+    }
+    updateEnvelope();
+}
+
+/**
+ * @description: Adds the last sample to the envelope and the RMS of each channel: the distance to
+ *  a slow baseline is rectified and smoothed by a first order filter, and its square replaces the
+ *  oldest one of the RMS window. A few operations per channel whatever the window
+*/
+void MMG::updateEnvelope(void){
+    if (!envelopeStarted){
+        for (int chan = 0; chan < MMG_CHANNELS; chan++){
+            baseline[chan] = (long) MMGData[chan] * 256;
+            envelope[chan] = 0;
+            squareSum[chan] = 0;
+            for (int i = 0; i < MMG_RMS_WINDOW; i++) squares[chan][i] = 0;
+        }
+        envelopeStarted = true;
+    }
+    for (int chan = 0; chan < MMG_CHANNELS; chan++){
+        baseline[chan] += ((long) MMGData[chan] * 256 - baseline[chan]) >> MMG_BASELINE_SHIFT;
+        long distance = MMGData[chan] - (baseline[chan] >> 8);
+        unsigned long rectified = distance < 0 ? -distance : distance;
+        envelope[chan] += ((long) (rectified << 8) - envelope[chan]) >> MMG_ENVELOPE_SHIFT;
+        unsigned long square = rectified * rectified; // below 2^32, the distance is below 2^16
+        squareSum[chan] += square;
+        squareSum[chan] -= squares[chan][squareIndex];
+        squares[chan][squareIndex] = square;
+    }
+    squareIndex = (squareIndex + 1) % MMG_RMS_WINDOW;
+}
+
+/**
+ * @description: Envelope of a channel, in counts of the ADS1015
+*/
+short MMG::getEnvelope(byte chan){
+    long value = envelope[chan] >> 8;
+    return value > 32767 ? 32767 : value;
+}
+
+/**
+ * @description: RMS of a channel over the last MMG_RMS_WINDOW samples, in counts of the ADS1015
+*/
+short MMG::getRMS(byte chan){
+    long value = lrintf(sqrtf((float) squareSum[chan] / MMG_RMS_WINDOW));
+    return value > 32767 ? 32767 : value;
+}
+
+/**
+ * @description: Adds the last sample to the serial packet
+*/
+void MMG::decimateMMGData(void){
+    for (int chan = 0; chan < MMG_CHANNELS; chan++){
+        if (MMGSumCount == 0) MMGSum[chan] = 0;
+        MMGSum[chan] += MMGData[chan];
+    }
+    MMGSumCount++;
+}
+
+/**
+ * @description: Places the average of the samples added since the last packet in MMGSerialData
+*/
+void MMG::averageMMGData(void){
+    if (MMGSumCount == 0) return;  // no new samples, keep the last values
+    for (int chan = 0; chan < MMG_CHANNELS; chan++){
+        MMGSerialData[chan] = MMGSum[chan] / MMGSumCount;
+    }
+    MMGSumCount = 0;
 }
 
 /**
 * @description Writes data to serial port.
+* @param `outputs` - [byte] - MMG_OUTPUT_RAW, MMG_OUTPUT_ENVELOPE and MMG_OUTPUT_RMS bits, sent in that order
 */
-void MMG::sendMMGData(boolean serial_stream)
+void MMG::sendMMGData(boolean serial_stream, byte outputs)
 {
     if(serial_stream) {
-        if (curTxMode == DATA_RAW) {sendMMGDataSerial_Raw();}
-        if (curTxMode == DATA_ASCII) {sendMMGDataSerial_Ascii();}
+        if (curTxMode == DATA_RAW) {sendMMGDataSerial_Raw(outputs);}
+        if (curTxMode == DATA_ASCII) {sendMMGDataSerial_Ascii(outputs);}
     }
 }
 
 /**
-* @description Writes channel data to serial port sending chunks of 8 bytes.
+* @description Writes channel data to serial port sending chunks of 8 bytes, one for each output.
+*  The envelope and the RMS are the last values, already smooth, the raw data the average
 */
-void MMG::sendMMGDataSerial_Raw(void)
+void MMG::sendMMGDataSerial_Raw(byte outputs)
 {
-    for (int i = 0; i < MMG_CHANNELS; i++)
+    if (outputs & MMG_OUTPUT_RAW)
+    {
+        for (int i = 0; i < MMG_CHANNELS; i++)
+        {
+            Serial.write((uint8_t)highByte(MMGSerialData[i]));
+            Serial.write((uint8_t)lowByte(MMGSerialData[i]));
+        }
+    }
+    if (outputs & MMG_OUTPUT_ENVELOPE)
     {
-        Serial.write((uint8_t)highByte(MMGData[i]));
-        Serial.write((uint8_t)lowByte(MMGData[i]));
+        for (int i = 0; i < MMG_CHANNELS; i++)
+        {
+            short value = getEnvelope(i);
+            Serial.write((uint8_t)highByte(value));
+            Serial.write((uint8_t)lowByte(value));
+        }
+    }
+    if (outputs & MMG_OUTPUT_RMS)
+    {
+        for (int i = 0; i < MMG_CHANNELS; i++)
+        {
+            short value = getRMS(i);
+            Serial.write((uint8_t)highByte(value));
+            Serial.write((uint8_t)lowByte(value));
+        }
     }
 }
 
 /**
 * @description Writes channel data to serial port sending whole data in ascii format.
 */
-void MMG::sendMMGDataSerial_Ascii(void)
+void MMG::sendMMGDataSerial_Ascii(byte outputs)
 {
-    for (int i = 0; i < MMG_CHANNELS; i++)
+    for (int i = 0; (outputs & MMG_OUTPUT_RAW) && i < MMG_CHANNELS; i++)
+    {
+        Serial.print(MMGSerialData[i]);
+        Serial.print(" ");
+    }
+    for (int i = 0; (outputs & MMG_OUTPUT_ENVELOPE) && i < MMG_CHANNELS; i++)
+    {
+        Serial.print(getEnvelope(i));
+        Serial.print(" ");
+    }
+    for (int i = 0; (outputs & MMG_OUTPUT_RMS) && i < MMG_CHANNELS; i++)
     {
-        Serial.print(MMGData[i]);
+        Serial.print(getRMS(i));
         Serial.print(" ");
     }
 }
@@ -9,34 +9,60 @@
 
 #include <Wire.h>
 #include "ADS1X15.h" // https://github.com/soligen2010/Adafruit_ADS1X15
+#include "Brainwear_mains.h"
 
 #define MMG_CHANNELS 4
 
+// Muscle activity of each channel, updated with every sample. Time constants are in samples, the
+// times are those at 250 Hz
+#define MMG_BASELINE_SHIFT  9   // the baseline follows the signal with a time constant of 2^9 samples, 2 s
+#define MMG_ENVELOPE_SHIFT  4   // the rectified signal is smoothed over 2^4 samples, 64 ms
+#define MMG_RMS_WINDOW      32  // samples of the sliding RMS, 128 ms
+
 class MMG {
 public:
     MMG(uint8_t);
 
     //ENUMS
-    typedef enum TX_MODE{ //How to send data
+    enum TX_MODE { //How to send data
         DATA_RAW,
         DATA_ASCII
     };
 
+    void averageMMGData(void);
     void begin(adsGain_t , adsSPS_t);
-    void sendMMGData(boolean);
+    void decimateMMGData(void);
+    short getEnvelope(byte);
+    int getFullScaleMilliVolts(void);
+    short getRMS(byte);
+    void sendMMGData(boolean, byte);
     void setCurTxMode(TX_MODE);
     void updateMMGData(void);
 
-    Adafruit_ADS1015 *MMG_ads;
+    Adafruit_ADS1015 *MMG_ads;  // in the arena, created by begin
+    MainsCanceller<MMG_CHANNELS> *mains;    // mains canceller of the samples, in the arena, created by begin
 
     short MMGData[MMG_CHANNELS];
+    short MMGSerialData[MMG_CHANNELS];  // averaged data sent to the serial port
 
     // ENUM
     TX_MODE curTxMode;
 
 private:
-    void sendMMGDataSerial_Raw(void);
-    void sendMMGDataSerial_Ascii(void);
+    void sendMMGDataSerial_Raw(byte);
+    void sendMMGDataSerial_Ascii(byte);
+    void updateEnvelope(void);
+
+    uint8_t address;            // I2C address of the ADS1015
+    long MMGSum[MMG_CHANNELS];  // sum of the samples of the current serial packet
+    byte MMGSumCount;           // samples added to MMGSum
+
+    boolean envelopeStarted;                // the baselines start at the first sample
+    long baseline[MMG_CHANNELS];            // slow mean of each channel, 8 fraction bits
+    long envelope[MMG_CHANNELS];            // smoothed distance to the baseline, 8 fraction bits
+    unsigned long squares[MMG_CHANNELS][MMG_RMS_WINDOW];  // last squared distances to the baseline
+    uint64_t squareSum[MMG_CHANNELS];       // sum of squares
+    byte squareIndex;                       // oldest entry of squares
 
 };
 #endif //SOFTWARE_MMG_H
\ No newline at end of file
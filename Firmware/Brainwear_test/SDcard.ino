@@ -13,6 +13,7 @@
 
 
 #define OVER_DIM 20 // make room for up to 20 write-time overruns
+#define SESSION_RETRIES 4 // session numbers tried when a file with that name is already on the card
 
 boolean cardInit = false;
 boolean fileIsOpen = false;
@@ -22,22 +23,52 @@ Sd2Card card;// SPI needs to be init'd before here
 SdVolume volume;
 SdFile root;
 uint32_t bgnBlock, endBlock; // file extent bookends
-uint8_t* pCache;      // array to store the block of data before saving it on the SD card
+uint8_t* pCache;      // block of data before saving it on the SD card, in the arena
 uint32_t MICROS_PER_BLOCK = 2000; // block write longer than this will get flaged
 uint32_t BLOCK_COUNT;
 boolean openvol;
+boolean rawWriteActive = false; // true between card.writeStart and card.writeStop
 
-char currentFileName[]="ADS_SD00.txt";
-byte fileTens, fileOnes;  // enumerate succesive files on card and store number in EEPROM
+uint32_t DATA_BLOCK_COUNT;  // blocks of BLOCK_COUNT available for samples, the rest holds index and super block
+SDSuperBlock superBlock;    // layout of the open file, stored in its last block
+SDIndexEntry *indexCache;   // index block being filled, SD_INDEX_PER_BLOCK entries in the arena
+uint32_t indexEntries;      // index entries written in the open file
+uint32_t sdSampleCount;     // samples stored in the open file
+SDCommit *commitCache;      // commit being filled with the CRC of each data block, in the arena
+uint32_t commitCount;       // commits written in the open file
+
+byte sdFormat = SD_FORMAT_TXT; // layout of the next file
+byte sdChannels;               // EEG channels stored in the open file, ADS_ALL_CHANNELS mask
+byte sdMMGOutputs;             // MMG values stored in the open file, MMG_OUTPUT_ bits
+boolean sdArtifacts;           // the open file stores the artifact flags of each sample
+BDF *bdf;                      // header and record builder for SD_FORMAT_BDF, in the arena
+long bdfRecords;               // BDF records written in the open file
+char bdfPrefiltering[ADS_CHANNELS_BOARD][MONTAGE_TEXT + 16]; // prefiltering of the EEG signals, the mains and the row of the montage
+char bdfMMGPrefiltering[8];    // prefiltering of the MMG signals, the mains
+const char* const bdfLabels[] = {"EEG 1", "EEG 2", "EEG 3", "EEG 4",
+                                 "FSR 1", "FSR 2", "FSR 3", "FSR 4",
+                                 "Piezo 1", "Piezo 2", "Piezo 3", "Piezo 4"};
+const char* const bdfEnvelopeLabels[] = {"FSR 1 envelope", "FSR 2 envelope", "FSR 3 envelope", "FSR 4 envelope",
+                                         "Piezo 1 envelope", "Piezo 2 envelope", "Piezo 3 envelope", "Piezo 4 envelope"};
+const char* const bdfRMSLabels[] = {"FSR 1 RMS", "FSR 2 RMS", "FSR 3 RMS", "FSR 4 RMS",
+                                    "Piezo 1 RMS", "Piezo 2 RMS", "Piezo 3 RMS", "Piezo 4 RMS"};
+
+char currentFileName[]="00000000.TXT"; // session number in hex
+SdFile catalogFile;            // SD_CATALOG_NAME, list of the sessions on the card
+SDCatalogHeader catalog;       // header of the catalog
+SDCatalogRecord session;       // catalog record of the open file
+uint32_t sessionRecord;        // position of session in the catalog
+boolean sessionInCatalog = false;
 File file;
 
 int byteCounter = 0;    // used to hold position in cache
-int blockCounter;       // count up to BLOCK_COUNT with this
+uint32_t blockCounter;  // count up to BLOCK_COUNT with this
 
-struct {
+typedef struct {
     uint32_t block;   // holds block number that over-ran
     uint32_t micro;  // holds the length of this of over-run
-} over[OVER_DIM];
+} SDOverrun;
+SDOverrun *over;        // OVER_DIM overruns, in the arena
 uint32_t overruns;      // count the number of overruns
 uint32_t maxWriteTime;  // keep track of longest write time
 uint32_t minWriteTime;  // and shortest write time
@@ -52,6 +83,17 @@ const char blockTime[] PROGMEM = {  "%block, uS\n"};         // 11
 const char startStamp[] PROGMEM = {  "%START AT\n"};    // used to stamp SD record when started by PC
 const char stopStamp[] PROGMEM = {  "%STOP AT\n"};      // used to stamp SD record when stopped by PC
 
+/**
+ * @description Takes the buffers of the SD recording from the arena, once in setup()
+ */
+void beginSD(){
+    pCache = arena.createArray<uint8_t>(SD_BLOCK_SIZE, "SD block");
+    indexCache = arena.createArray<SDIndexEntry>(SD_INDEX_PER_BLOCK, "SD index block");
+    commitCache = arena.create<SDCommit>("SD commit block");
+    over = arena.createArray<SDOverrun>(OVER_DIM, "SD overruns");
+    bdf = arena.create<BDF>("BDF record");
+}
+
 /**
  * @description Process the command sent via serial port
  */
@@ -83,6 +125,16 @@ char sdProcessChar(char character) {
             SDfileOpen = setupSDcard(character);
             break;
 
+        case ADS_SD_FORMAT_TXT:
+            setSDformat(SD_FORMAT_TXT);
+            break;
+        case ADS_SD_FORMAT_BDF:
+            setSDformat(SD_FORMAT_BDF);
+            break;
+        case ADS_SD_FORMAT_RICE:
+            setSDformat(SD_FORMAT_RICE);
+            break;
+
         case ADS_RST_SDCOUNT: // Reset counter in EEPROM for files
             resetFileCounter();
         break;
@@ -97,14 +149,17 @@ char sdProcessChar(char character) {
             break;
 
         case ADS_STREAM_STOP:
-            if(SDfileOpen) {
+            if(SDfileOpen && sdFormat == SD_FORMAT_TXT) {
                 stampSD(OFF);
             }
+            if(SDfileOpen && sdFormat == SD_FORMAT_RICE) {
+                writeCodecRecord(); // last block of the stream, flushed by boardProcessChar
+            }
             break;
 
         case ADS_STREAM_START:
             if(SDfileOpen) {
-                stampSD(ON);
+                if(sdFormat == SD_FORMAT_TXT) stampSD(ON);
                 t = millis();
             }
             break;
@@ -169,19 +224,24 @@ boolean setupSDcard(char limit){
             }
             return fileIsOpen;
     }
-    incrementFileCounter();
-    Serial.println(currentFileName);
     openvol = root.openRoot(volume);
 
-
-    openfile.remove(root, currentFileName); // if the file is over-writing, let it!
-    root.ls(LS_R | LS_DATE | LS_SIZE);
-
-    if (!openfile.createContiguous(root, currentFileName, BLOCK_COUNT*512UL)) {
+    // session numbers only increase, an existing file is never overwritten
+    uint32_t number = nextSessionNumber();
+    boolean created = false;
+    for(int i = 0; i < SESSION_RETRIES && !created; i++){
+        setFileName(number);
+        created = openfile.createContiguous(root, currentFileName, BLOCK_COUNT*512UL);
+        if(!created) number++; // left by a lost catalog, try the next number
+    }
+    Serial.println(currentFileName);
+    if (!created) {
         if(!EEG.streaming) {
             Serial.println("created Contiguous fail");
         }
         cardInit = false;
+    } else{
+        addSession(number);
     }
     if (!openfile.contiguousRange(&bgnBlock, &endBlock)) {
         if(!EEG.streaming) {
@@ -189,7 +249,6 @@ boolean setupSDcard(char limit){
         }
         cardInit = false;
     }
-    pCache = (uint8_t*)volume.cacheClear();
     if (!card.erase(bgnBlock, endBlock)){
         if(!EEG.streaming) {
             Serial.println("erase block fail");
@@ -202,13 +261,22 @@ boolean setupSDcard(char limit){
         }
         cardInit = false;
     }
-    if (!card.writeStart(bgnBlock, BLOCK_COUNT)){
+    // the layout of the file is fixed here: the channels powered up now, all of them if none is
+    sdChannels = EEG.getActiveChannels();
+    if (sdChannels == 0) sdChannels = ADS_ALL_CHANNELS;
+    sdMMGOutputs = EEG.mmgOutputs;
+    sdArtifacts = EEG.artifactMode != ADS_ARTIFACTS_OFF;
+    // index, commits and super block live at the end of the file
+    DATA_BLOCK_COUNT = BLOCK_COUNT - (BLOCK_COUNT / SD_INDEX_BLOCK_RATIO + 1) - (BLOCK_COUNT / SD_COMMIT_INTERVAL + 2) - 1;
+    initIndex();
+    if (!card.writeStart(bgnBlock, DATA_BLOCK_COUNT)){
         if(!EEG.streaming) {
             Serial.println("writeStart fail");
         }
         cardInit = false;
     } else{
         fileIsOpen = true;
+        rawWriteActive = true;
         delay(1);
     }
     // initialize write-time overrun error counter and min/max wirte time benchmarks
@@ -217,6 +285,9 @@ boolean setupSDcard(char limit){
     minWriteTime = 65000;
     byteCounter = 0;  // counter from 0 - 512
     blockCounter = 0; // counter from 0 - BLOCK_COUNT;
+    if(fileIsOpen && sdFormat == SD_FORMAT_BDF){
+        beginBDF();
+    }
     if(fileIsOpen == true){  // send corresponding file name to controlling program
         if(!EEG.streaming) {
             Serial.print("Corresponding SD file ");
@@ -230,36 +301,111 @@ boolean setupSDcard(char limit){
 }
 
 /**
- * @description Increments the filecounter to store the file in the SD card with a different identifier
+ * @description Next session number, the highest of the catalog and the EEPROM mirror.
+ *  Only the catalog header is read, the directory is never listed
+ */
+uint32_t nextSessionNumber(){
+    catalog.magic = SD_CATALOG_MAGIC;
+    catalog.version = SD_CATALOG_VERSION;
+    catalog.nextNumber = 0;
+    catalog.sessions = 0;
+    if(catalogFile.open(root, SD_CATALOG_NAME, O_RDWR | O_CREAT)){
+        SDCatalogHeader header;
+        if(catalogFile.read(&header, sizeof(header)) == sizeof(header) &&
+           header.magic == SD_CATALOG_MAGIC && header.version == SD_CATALOG_VERSION){
+            catalog = header;
+        }
+        catalogFile.close();
+    }
+    uint32_t number = readSessionNumber();
+    return catalog.nextNumber > number ? catalog.nextNumber : number;
+}
+
+/**
+ * @description Adds the new file to the catalog and moves the session number past it
  */
-void incrementFileCounter(){
-    fileTens = EEPROM.read(0);
-    fileOnes = EEPROM.read(1);
-//     if it's the first time writing to EEPROM, seed the file number to '00'
-    if(fileTens == 0xFF | fileOnes == 0xFF){
-        fileTens = fileOnes = '0';
+void addSession(uint32_t number){
+    session.number = number;
+    session.blockCount = BLOCK_COUNT;
+    session.totalSamples = 0;
+    session.sampleRate = EEG.getSampleRateHz();
+    session.format = sdFormat;
+    session.closed = 0;
+    catalog.nextNumber = number + 1;
+    writeSessionNumber(catalog.nextNumber);
+
+    sessionInCatalog = false;
+    if(!catalogFile.open(root, SD_CATALOG_NAME, O_RDWR | O_CREAT)) return;
+    // the header goes first, a new catalog is empty and can't be seeked past its end
+    catalogFile.write(&catalog, sizeof(catalog));
+    sessionRecord = catalog.sessions;
+    if(catalogFile.seekSet(sizeof(SDCatalogHeader) + sessionRecord * sizeof(SDCatalogRecord)) &&
+       catalogFile.write(&session, sizeof(session)) == sizeof(session)){
+        catalog.sessions++;
+        sessionInCatalog = true;
+        catalogFile.seekSet(0);
+        catalogFile.write(&catalog, sizeof(catalog));
     }
-    fileOnes++;   // increment the file name
-    if (fileOnes == ':'){fileOnes = 'A';}
-    if (fileOnes > 'F'){
-        fileOnes = '0';         // hexify
-        fileTens++;
-        if(fileTens == ':'){fileTens = 'A';}
-        if(fileTens > 'F'){fileTens = '0';fileOnes = '1';}
+    catalogFile.close();
+}
+
+/**
+ * @description Marks the session closed in the catalog, with the number of samples written
+ */
+void closeSession(){
+    if(!sessionInCatalog) return;
+    session.totalSamples = sdSampleCount;
+    session.closed = 1;
+    if(catalogFile.open(root, SD_CATALOG_NAME, O_RDWR)){
+        if(catalogFile.seekSet(sizeof(SDCatalogHeader) + sessionRecord * sizeof(SDCatalogRecord))){
+            catalogFile.write(&session, sizeof(session));
+        }
+        catalogFile.close();
+    }
+    sessionInCatalog = false;
+}
+
+/**
+ * @description Names the file after the session number, 8 hex digits and the format extension
+ */
+void setFileName(uint32_t number){
+    const char hex[] = "0123456789ABCDEF";
+    for(int i = 7; i >= 0; i--){
+        currentFileName[i] = hex[number & 0x0F];
+        number >>= 4;
+    }
+    strcpy(&currentFileName[9], sdFormat == SD_FORMAT_BDF ? "BDF" : sdFormat == SD_FORMAT_RICE ? "BWC" : "TXT");
+}
+
+/**
+ * @description Session number mirrored in the EEPROM, 0 if none was stored
+ */
+uint32_t readSessionNumber(){
+    if(EEPROM.read(EEPROM_SESSION_MARK) != EEPROM_SESSION_KEY) return 0;
+    uint32_t number = 0;
+    for(int i = 3; i >= 0; i--){
+        number = (number << 8) | EEPROM.read(EEPROM_SESSION_NUMBER + i);
+    }
+    return number;
+}
+
+/**
+ * @description Mirrors the next session number in the EEPROM, so a new card continues the numbering
+ */
+void writeSessionNumber(uint32_t number){
+    EEPROM.write(EEPROM_SESSION_MARK, EEPROM_SESSION_KEY);
+    for(int i = 0; i < 4; i++){
+        EEPROM.write(EEPROM_SESSION_NUMBER + i, (number >> (i*8)) & 0xFF);
     }
-    EEPROM.write(0,fileTens);     // store current file number in eeprom
-    EEPROM.write(1,fileOnes);
     EEPROM.commit();
-    currentFileName[6] = fileTens;
-    currentFileName[7] = fileOnes;
 }
 
 /**
- * @description Reset the counter that keeps track of the number of files stored in the SD (used for debug purposes)
+ * @description Clears the session number of the EEPROM (used for debug purposes). The numbering
+ *  continues from the catalog of the card, so no file is overwritten
  */
 void resetFileCounter(){
-    EEPROM.write(0,0xFF);
-    EEPROM.write(1,0xFF);
+    EEPROM.write(EEPROM_SESSION_MARK, 0xFF);
     EEPROM.commit();
     Serial.println("File counter restarted");
     EEG.sendEOT();
@@ -268,29 +414,67 @@ void resetFileCounter(){
 /**
  * @description Write data to the SDcard
  */
-void writeDataToSDcard(byte sampleNumber){
+void writeDataToSDcard(){
+    TRACE_SCOPE(TRACE_SD_SAMPLE, 0);
     boolean addComma = true;
-    // convert 8 bit sampleCounter into HEX
-    convertToHex(sampleNumber, 1, addComma);
-    // convert 24 bit channelData into HEX
-    for (int currentChannel = 0; currentChannel < ADS_CHANNELS_BOARD; currentChannel++){
-        if (!addAuxtoSD && currentChannel == ADS_CHANNELS_BOARD-1) addComma = false;
+    if(sdFormat == SD_FORMAT_BDF){
+        writeBDFSample();
+        return;
+    }
+    if(sdFormat == SD_FORMAT_RICE){
+        writeCodecRecord();
+        return;
+    }
+    if(sdSampleCount % SD_INDEX_INTERVAL == 0){
+        addIndexEntry(millis());
+    }
+    // convert 8 bit sample number into HEX, the SD counts its own samples
+    convertToHex(sdSampleCount & 0xFF, 1, addComma);
+    sdSampleCount++;
+    // convert 24 bit channelData into HEX, channels of sdChannels only
+    byte lastChannel = 31 - __builtin_clz(sdChannels);
+    for (int currentChannel = 0; currentChannel <= lastChannel; currentChannel++){
+        if (!bitRead(sdChannels, currentChannel)) continue;
+        if (!addAuxtoSD && !sdArtifacts && currentChannel == lastChannel) addComma = false;
         convertToHex(EEG.boardChannelDataInt[currentChannel], 5, addComma);
     }
 
     if(addAuxtoSD && multimode){
-        // convert MMG into HEX
-        for(int currentChannel = 0; currentChannel <  MMG_BOARDS*MMG_CHANNELS; currentChannel++){
-            if(currentChannel < MMG_CHANNELS){
-                convertToHex(MMG1.MMGData[currentChannel], 3, addComma);
-            } else{
-                if(currentChannel == (2*MMG_CHANNELS-1)) addComma = false;
-                convertToHex(MMG2.MMGData[currentChannel], 3, addComma);
-            }
-
+        // convert MMG into HEX, the values of each output of sdMMGOutputs
+        short values[MMG_OUTPUTS*MMG_BOARDS*MMG_CHANNELS];
+        byte count = getMMGValues(values);
+        for(int i = 0; i < count; i++){
+            if(i == count - 1 && !sdArtifacts) addComma = false;
+            convertToHex(values[i], 3, addComma);
         }
         addAuxtoSD = false;
     }
+
+    if(sdArtifacts){
+        // the three masks of the artifact flags, transient, step then saturated
+        convertToHex(sampleArtifacts, 5, false);
+    }
+}
+
+/**
+ * @description MMG values of the current sample for the SD card: for each output of sdMMGOutputs
+ *  (raw, envelope, RMS) the channels of MMG1 then those of MMG2
+ * @returns the number of values
+ */
+byte getMMGValues(short *values){
+    byte count = 0;
+    for(int output = 0; output < MMG_OUTPUTS; output++){
+        if(!bitRead(sdMMGOutputs, output)) continue;
+        for(int board = 0; board < MMG_BOARDS; board++){
+            MMG &mmg = board == 0 ? MMG1 : MMG2;
+            for(int i = 0; i < MMG_CHANNELS; i++){
+                if(output == 0) values[count++] = mmg.MMGData[i];
+                else if(output == 1) values[count++] = mmg.getEnvelope(i);
+                else values[count++] = mmg.getRMS(i);
+            }
+        }
+    }
+    return count;
 }
 
 /**
@@ -327,7 +511,11 @@ void convertToHex(long rawData, int numNibbles, boolean useComma){
  * @description counts the number of blocks written
  */
 void writeCache(){
-    if(blockCounter > BLOCK_COUNT) return;
+    TRACE_SCOPE(TRACE_SD_BLOCK, blockCounter);
+    if(blockCounter >= DATA_BLOCK_COUNT){
+        byteCounter = 0; // file is full, drop the block
+        return;
+    }
     uint32_t tw = micros();  // start block write timer
     if(!card.writeData(pCache)){
         if (!EEG.streaming) {
@@ -345,18 +533,30 @@ void writeCache(){
         }
         overruns++;
     }
+    commitCache->crc[commitCache->numCrc] = sdCrc16(pCache, 512, 0xFFFF);
+    commitCache->numCrc++;
     byteCounter = 0; // reset 512 byte counter for next block
     blockCounter++;    // increment BLOCK counter
+    if(commitCache->numCrc == SD_COMMIT_INTERVAL){
+        commitSD();
+    }
 
-    if(blockCounter == BLOCK_COUNT-1){
+    if(blockCounter == DATA_BLOCK_COUNT-1){
         t = millis() - t;
         EEG.streamStop();
-        writeFooter();
+        if(sdFormat == SD_FORMAT_TXT){
+            writeFooter();
+        } else{
+            memset(pCache + byteCounter, 0, 512 - byteCounter); // close with an empty block, finishBDF drops a cut record
+            byteCounter = 512;
+            writeCache();
+        }
     }
 
-    if(blockCounter == BLOCK_COUNT){
-        closeSDfile();
+    if(blockCounter == DATA_BLOCK_COUNT){
+        SDfileOpen = closeSDfile();
         BLOCK_COUNT = 0;
+        DATA_BLOCK_COUNT = 0;
     }  // we did it!
 
 }
@@ -366,8 +566,33 @@ void writeCache(){
  */
 boolean closeSDfile(){
     if(fileIsOpen){
+        if(sdFormat == SD_FORMAT_BDF && bdf->padRecord()){ // complete the last record
+            writeBDFRecord();
+        }
+        if(sdFormat == SD_FORMAT_RICE){ // frames of the last, partial block
+            flushBlock();
+            writeCodecRecord();
+        }
+        if(byteCounter > 0 && blockCounter < DATA_BLOCK_COUNT){ // keep the samples still in the cache
+            memset(pCache + byteCounter, 0, 512 - byteCounter);
+            card.writeData(pCache);
+            commitCache->crc[commitCache->numCrc] = sdCrc16(pCache, 512, 0xFFFF);
+            commitCache->numCrc++;
+            blockCounter++;
+            byteCounter = 0;
+        }
         card.writeStop();
+        rawWriteActive = false;
+        if(commitCache->numCrc > 0){
+            commitSD();
+        }
+        if(sdFormat == SD_FORMAT_BDF){
+            finishBDF();
+        } else{
+            finishIndex();
+        }
         openfile.close();
+        closeSession();
         fileIsOpen = false;
         if(!EEG.streaming){ // verbosity. this also gets insterted as footer in openFile
             Serial.print("Total Elapsed Time: ");Serial.print(t);Serial.println(" mS"); //delay(10);
@@ -452,12 +677,361 @@ void writeFooter(){
     if (overruns) {
         uint8_t n = overruns > OVER_DIM ? OVER_DIM : overruns;
         for (uint8_t i = 0; i < n; i++) {
+            pCache[byteCounter] = '%'; // a footer line as the others, readers skip it as a sample
+            byteCounter++;
+            if(byteCounter == 512){
+                writeCache();
+            }
             convertToHex(over[i].block, 7, true);
             convertToHex(over[i].micro, 7, false);
         }
     }
     for(int i=byteCounter; i<512; i++){
-        pCache[i] = NULL;
+        pCache[i] = 0;
     }
     writeCache();
-}
\ No newline at end of file
+}
+
+//////////////////////////////////////////////
+///////////////// Block index ////////////////
+//////////////////////////////////////////////
+
+/**
+ * @description Lays out the index at the end of the open file and stores the first super block
+ */
+void initIndex(){
+    superBlock.magic = SD_SUPER_MAGIC;
+    superBlock.version = SD_FORMAT_VERSION;
+    superBlock.closed = 0;
+    superBlock.blockCount = BLOCK_COUNT;
+    superBlock.dataBlocks = DATA_BLOCK_COUNT;
+    superBlock.indexStart = DATA_BLOCK_COUNT;
+    superBlock.indexInterval = SD_INDEX_INTERVAL;
+    superBlock.sampleRate = EEG.getSampleRateHz();
+    superBlock.usedBlocks = 0;
+    superBlock.indexEntries = 0;
+    superBlock.totalSamples = 0;
+    superBlock.format = sdFormat;
+    superBlock.channels = sdChannels;
+    superBlock.mmgOutputs = sdMMGOutputs;
+    superBlock.artifacts = sdArtifacts;
+    superBlock.montage = EEG.montage;
+    superBlock.montageTerms = EEG.montage == MONTAGE_CUSTOM ? EEG.montageTermCount : 0;
+    memset(superBlock.montageTerm, 0, sizeof(superBlock.montageTerm));
+    for(uint32_t i = 0; i < superBlock.montageTerms; i++){
+        superBlock.montageTerm[i][0] = EEG.montageTerms[i].channels;
+        superBlock.montageTerm[i][1] = (uint8_t) EEG.montageTerms[i].weight;
+    }
+    superBlock.commitBlocks = BLOCK_COUNT / SD_COMMIT_INTERVAL + 2;
+    superBlock.commitStart = BLOCK_COUNT - 1 - superBlock.commitBlocks;
+    superBlock.commitInterval = SD_COMMIT_INTERVAL;
+    superBlock.indexBlocks = superBlock.commitStart - DATA_BLOCK_COUNT;
+
+    indexEntries = 0;
+    sdSampleCount = 0;
+    commitCount = 0;
+    memset(commitCache, 0, sizeof(SDCommit));
+    writeSuperBlock();
+    memset(indexCache, 0, SD_BLOCK_SIZE);
+}
+
+/**
+ * @description Records where the current sample starts and when it was acquired. Called every
+ *  SD_INDEX_INTERVAL samples
+ */
+void addIndexEntry(uint32_t stamp){
+    if(indexEntries / SD_INDEX_PER_BLOCK >= superBlock.indexBlocks) return; // index is full
+    SDIndexEntry *entry = &indexCache[indexEntries % SD_INDEX_PER_BLOCK];
+    entry->sample = sdSampleCount;
+    entry->millis = stamp;
+    entry->block = blockCounter;
+    entry->offset = byteCounter;
+    entry->tag = SD_INDEX_TAG;
+    indexEntries++;
+    if(indexEntries % SD_INDEX_PER_BLOCK == 0){
+        flushIndexBlock();
+    }
+}
+
+/**
+ * @description Writes the index block being filled to its place in the file and starts a new one
+ */
+void flushIndexBlock(){
+    suspendRawWrite();
+    writeIndexBlock();
+    resumeRawWrite();
+    memset(indexCache, 0, SD_BLOCK_SIZE);
+}
+
+/**
+ * @description Writes the index block being filled, complete or not. The multi-block write has to be suspended
+ */
+void writeIndexBlock(){
+    uint32_t block = superBlock.indexStart + (indexEntries - 1) / SD_INDEX_PER_BLOCK;
+    if(!card.writeBlock(bgnBlock + block, (const uint8_t*)indexCache)){
+        if (!EEG.streaming) {
+            Serial.println("index write fail");
+            EEG.sendEOT();
+        }
+    }
+}
+
+/**
+ * @description Appends a commit with the progress of the file and the CRC of the data blocks
+ *  written since the previous one. The index written so far is stored first, so everything a
+ *  commit refers to is on the card before the commit itself.
+ */
+void commitSD(){
+    if(commitCount < superBlock.commitBlocks){
+        commitCache->magic = SD_COMMIT_MAGIC;
+        commitCache->sequence = commitCount;
+        commitCache->usedBlocks = blockCounter;
+        commitCache->indexEntries = indexEntries;
+        commitCache->totalSamples = sdSampleCount;
+        commitCache->millis = millis();
+        commitCache->firstBlock = blockCounter - commitCache->numCrc;
+        commitCache->commitCrc = sdCrc16((const uint8_t*)commitCache, offsetof(SDCommit, commitCrc), 0xFFFF);
+
+        suspendRawWrite();
+        if(indexEntries % SD_INDEX_PER_BLOCK != 0){
+            writeIndexBlock();
+        }
+        if(!card.writeBlock(bgnBlock + superBlock.commitStart + commitCount, (const uint8_t*)commitCache)){
+            if (!EEG.streaming) {
+                Serial.println("commit write fail");
+                EEG.sendEOT();
+            }
+        }
+        resumeRawWrite();
+        commitCount++;
+    }
+    memset(commitCache->crc, 0, sizeof(commitCache->crc));
+    commitCache->numCrc = 0;
+}
+
+/**
+ * @description Flushes the last index block and marks the file as closed in the super block
+ */
+void finishIndex(){
+    if(indexEntries % SD_INDEX_PER_BLOCK != 0){
+        flushIndexBlock();
+    }
+    superBlock.closed = 1;
+    superBlock.usedBlocks = blockCounter;
+    superBlock.indexEntries = indexEntries;
+    superBlock.totalSamples = sdSampleCount;
+    writeSuperBlock();
+}
+
+/**
+ * @description Stores the super block in the last block of the file
+ */
+void writeSuperBlock(){
+    memset(indexCache, 0, SD_BLOCK_SIZE);
+    memcpy(indexCache, &superBlock, sizeof(superBlock));
+    writeBlockOutOfBand(superBlock.blockCount - 1, (const uint8_t*)indexCache);
+}
+
+/**
+ * @description Writes one block of the open file outside the sample stream
+ */
+boolean writeBlockOutOfBand(uint32_t fileBlock, const uint8_t* src){
+    suspendRawWrite();
+    boolean ok = card.writeBlock(bgnBlock + fileBlock, src);
+    resumeRawWrite();
+    return ok;
+}
+
+/**
+ * @description Stops a running multi-block write so single blocks can be written
+ */
+void suspendRawWrite(){
+    if(rawWriteActive){
+        card.writeStop();
+    }
+}
+
+/**
+ * @description Restarts the multi-block write at the next data block
+ */
+void resumeRawWrite(){
+    if(rawWriteActive && blockCounter < DATA_BLOCK_COUNT){
+        if(!card.writeStart(bgnBlock + blockCounter, DATA_BLOCK_COUNT - blockCounter)){
+            if (!EEG.streaming) {
+                Serial.println("writeStart fail");
+                EEG.sendEOT();
+            }
+        }
+    }
+}
+
+//////////////////////////////////////////////
+//////////////// BDF recording ///////////////
+//////////////////////////////////////////////
+
+/**
+ * @description Selects the layout of the next SD file
+ */
+void setSDformat(byte format){
+    if(fileIsOpen){
+        if(!EEG.streaming) {
+            Serial.println("Close the SD file before changing its format");
+            EEG.sendEOT();
+        }
+        return;
+    }
+    sdFormat = format;
+    if(!EEG.streaming) {
+        Serial.println(sdFormat == SD_FORMAT_BDF ? "SD format: BDF" : sdFormat == SD_FORMAT_RICE ? "SD format: compressed" : "SD format: text");
+        EEG.sendEOT();
+    }
+}
+
+/**
+ * @description Describes the signals of the new file and writes the BDF header.
+ *  Scaling comes from the channel gains (VREF = 4.5V) and the MMG full scale ranges.
+ */
+void beginBDF(){
+    byte eegSignals = __builtin_popcount(sdChannels);
+    byte numSignals = eegSignals;
+    if(multimode) numSignals += __builtin_popcount(sdMMGOutputs)*MMG_BOARDS*MMG_CHANNELS;
+    if(sdArtifacts) numSignals++;
+    bdf->begin(numSignals, EEG.getSampleRateHz(), "Brainwear ADS1299");
+    byte signal = 0;
+    Montage<ADS_CHANNELS_BOARD> rows; // the montage of the stream, for the channels of the file
+    rows.configure(EEG.montage, EEG.montageTerms, EEG.montageTermCount, sdChannels);
+    // the mains canceller is a notch that follows the mains, N: as in the EDF+ prefiltering
+    if(EEG.mainsMode != ADS_MAINS_OFF) snprintf(bdfMMGPrefiltering, sizeof(bdfMMGPrefiltering), "N:%uHz", EEG.getMainsFrequencyHz());
+    else bdfMMGPrefiltering[0] = '\0';
+    for(int i = 0; i < ADS_CHANNELS_BOARD; i++){
+        if(!bitRead(sdChannels, i)) continue; // the labels tell which channels were recorded
+        long range = 4500000L / EEG.getChannelGain(i); // uV
+        char row[MONTAGE_TEXT];
+        rows.rowText(i, row);
+        int length = snprintf(bdfPrefiltering[i], sizeof(bdfPrefiltering[i]), "%s", bdfMMGPrefiltering);
+        if(row[0] != '\0'){
+            snprintf(bdfPrefiltering[i] + length, sizeof(bdfPrefiltering[i]) - length, "%sMontage %s", length > 0 ? " " : "", row);
+        }
+        bdf->setSignal(signal++, bdfLabels[i], "AgAgCl electrode", "uV", -range, range, -8388608L, 8388607L, bdfPrefiltering[i]);
+    }
+    if(multimode){
+        // in the order of getMMGValues
+        for(int output = 0; output < MMG_OUTPUTS; output++){
+            if(!bitRead(sdMMGOutputs, output)) continue;
+            const char* const *labels = output == 0 ? bdfLabels + ADS_CHANNELS_BOARD : output == 1 ? bdfEnvelopeLabels : bdfRMSLabels;
+            for(int i = 0; i < MMG_BOARDS*MMG_CHANNELS; i++){
+                long range = (i < MMG_CHANNELS ? MMG1 : MMG2).getFullScaleMilliVolts();
+                bdf->setSignal(signal++, labels[i], i < MMG_CHANNELS ? "FSR" : "Piezo", "mV", -range, range, -32768, 32767, bdfMMGPrefiltering);
+            }
+        }
+    }
+    if(sdArtifacts){
+        // the 24 bits of the flags, as the Status signal of the BioSemi files
+        bdf->setSignal(signal++, "Status", "Artifact flags", "Boolean", -8388608L, 8388607L, -8388608L, 8388607L);
+    }
+    bdfRecords = 0;
+    bdf->writeHeader(putByteSD, -1); // number of records is set by finishBDF
+}
+
+/**
+ * @description Adds the current sample to the BDF record, stores the record once complete
+ */
+void writeBDFSample(){
+    int32_t values[BDF_MAX_SIGNALS];
+    byte eegSignals = 0;
+    for(int i = 0; i < ADS_CHANNELS_BOARD; i++){
+        if(bitRead(sdChannels, i)) values[eegSignals++] = EEG.boardChannelDataInt[i];
+    }
+    for(int i = eegSignals; i < bdf->numSignals; i++){
+        values[i] = 0;
+    }
+    if(addAuxtoSD && multimode && bdf->numSignals > eegSignals){
+        short mmgValues[MMG_OUTPUTS*MMG_BOARDS*MMG_CHANNELS];
+        byte count = getMMGValues(mmgValues);
+        for(int i = 0; i < count && eegSignals + i < bdf->numSignals; i++){
+            values[eegSignals + i] = mmgValues[i];
+        }
+        addAuxtoSD = false;
+    }
+    sdSampleCount++;
+    if(sdArtifacts){
+        values[bdf->numSignals - 1] = sampleArtifacts;
+    }
+    if(bdf->addSample(values)){
+        writeBDFRecord();
+    }
+}
+
+/**
+ * @description Stores the completed BDF record
+ */
+void writeBDFRecord(){
+    const uint8_t* record = bdf->getRecord();
+    unsigned int recordSize = bdf->recordSize();
+    for(unsigned int i = 0; i < recordSize; i++){
+        putByteSD(record[i]);
+    }
+    bdfRecords++;
+}
+
+/**
+ * @description Sets the number of records in the header and cuts the file after the last
+ *  complete record, so the readers accept it. The index is not needed as records have a fixed size.
+ */
+void finishBDF(){
+    long records = 0;
+    uint32_t bytes = blockCounter * 512UL;
+    if(bytes > bdf->headerSize()){
+        records = (bytes - bdf->headerSize()) / bdf->recordSize();
+    }
+    if(records > bdfRecords) records = bdfRecords;
+
+    uint8_t* buf = (uint8_t*)indexCache;
+    if(card.readBlock(bgnBlock, buf)){
+        BDF::formatNumberOfRecords((char*)buf + BDF_RECORDS_FIELD_OFFSET, records);
+        card.writeBlock(bgnBlock, buf);
+    }
+    openfile.truncate(bdf->headerSize() + records * bdf->recordSize());
+}
+
+//////////////////////////////////////////////
+///////////// Compressed recording ///////////
+//////////////////////////////////////////////
+
+/**
+ * @description True when the open file records the blocks coded by processBlock
+ */
+boolean sdStoresCodecBlocks(){
+    return SDfileOpen && sdFormat == SD_FORMAT_RICE;
+}
+
+/**
+ * @description Stores the block coded by processBlock, if one is waiting, as a record: its size
+ *  then the block. The index entry of a record is stamped with the time of its first sample
+ */
+void writeCodecRecord(){
+    if(!codecPending) return;
+    codecPending = false;
+    if(blockCounter >= DATA_BLOCK_COUNT) return; // file is full
+    uint8_t frames = codecBlock[4];
+    if(indexEntries * SD_INDEX_INTERVAL < sdSampleCount + frames){ // holds the next indexed sample
+        addIndexEntry(millis() - (frames - 1) * 1000UL / EEG.getSampleRateHz());
+    }
+    putByteSD(codecLength & 0xFF);
+    putByteSD(codecLength >> 8);
+    for(size_t i = 0; i < codecLength; i++){
+        putByteSD(codecBlock[i]);
+    }
+    sdSampleCount += frames;
+}
+
+/**
+ * @description Appends one byte to the sample stream
+ */
+void putByteSD(uint8_t value){
+    pCache[byteCounter] = value;
+    byteCounter++;
+    if(byteCounter == 512){
+        writeCache();
+    }
+}
@@ -0,0 +1,562 @@
+/**
+ Host reader for the SD recordings of the Brainwear board.
+ Maps the file in memory and uses the block index stored at its end to jump straight
+ to the requested samples, without parsing anything before them.
+
+ Files that were not closed (power loss, reset) are read up to their last commit. Closed BDF
+ recordings are plain BDF files, only their layout and samples can be printed. Compressed
+ recordings are decoded with Brainwear_codec.h.
+
+ Usage:
+   sd_reader FILE                          print the file layout
+   sd_reader FILE -s FIRST COUNT           print COUNT samples starting at sample FIRST (any format)
+   sd_reader FILE -t START_MS END_MS       print the samples between two millis() stamps
+   sd_reader FILE -c                       check the CRC of every committed data block
+   sd_reader FILE -r OUT                   write a closed copy of FILE, a valid BDF for BDF files
+   sd_reader SESSIONS.CAT                  list the sessions recorded on the card
+**/
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../Brainwear_test/Brainwear_BDF.h"
+#include "../Brainwear_test/Brainwear_codec.h"
+#include "../Brainwear_test/Brainwear_montage.h"
+#include "../Brainwear_test/Brainwear_int24.h"
+#include "../Brainwear_test/Brainwear_SDformat.h"
+
+struct Recording {
+    const uint8_t *base;
+    size_t size;
+    const SDSuperBlock *super;
+    const SDIndexEntry *index;
+    const SDCommit *commits;
+    uint32_t numCommits;    // valid commits
+    uint32_t entries;       // valid index entries
+    uint32_t usedBlocks;    // valid data blocks
+    uint32_t totalSamples;
+};
+
+/**
+ * @description A commit is valid when it is complete and stored in its own slot
+ */
+static bool validCommit(const Recording &rec, uint32_t n)
+{
+    const SDCommit &c = rec.commits[n];
+    return c.magic == SD_COMMIT_MAGIC && c.sequence == n && c.numCrc <= SD_COMMIT_MAX_CRCS &&
+           c.commitCrc == sdCrc16((const uint8_t *) &c, offsetof(SDCommit, commitCrc), 0xFFFF);
+}
+
+/**
+ * @description Reads an integer field of a BDF header
+ */
+static long bdfField(const uint8_t *header, size_t offset, size_t width)
+{
+    char buf[16];
+    memcpy(buf, header + offset, width);
+    buf[width] = 0;
+    return strtol(buf, NULL, 10);
+}
+
+/**
+ * @description Describes a closed BDF recording, a plain BDF file without super block: no index
+ *  and no commits, the samples run to the end of the file
+ */
+static void openClosedBDF(Recording &rec)
+{
+    static SDSuperBlock super;
+    memset(&super, 0, sizeof(super));
+    super.magic = SD_SUPER_MAGIC;
+    super.version = SD_FORMAT_VERSION;
+    super.closed = 1;
+    super.format = SD_FORMAT_BDF;
+    super.blockCount = (rec.size + SD_BLOCK_SIZE - 1) / SD_BLOCK_SIZE;
+    super.dataBlocks = super.blockCount;
+    super.usedBlocks = super.blockCount;
+    super.indexInterval = SD_INDEX_INTERVAL;
+    long numSignals = bdfField(rec.base, 252, 4);
+    long records = bdfField(rec.base, BDF_RECORDS_FIELD_OFFSET, BDF_RECORDS_FIELD_SIZE);
+    long perRecord = numSignals > 0 ? bdfField(rec.base, 256 + numSignals * 216, 8) : 0;
+    char duration[9];
+    memcpy(duration, rec.base + 244, 8);
+    duration[8] = 0;
+    if (atof(duration) > 0) super.sampleRate = (uint32_t) (perRecord / atof(duration) + 0.5);
+    if (records > 0 && perRecord > 0) super.totalSamples = records * perRecord;
+    rec.super = &super;
+    rec.index = NULL;
+    rec.commits = NULL;
+    rec.numCommits = 0;
+    rec.entries = 0;
+    rec.usedBlocks = super.usedBlocks;
+    rec.totalSamples = super.totalSamples;
+}
+
+/**
+ * @description Maps FILE and locates its super block and index
+ */
+static bool openRecording(const char *path, Recording &rec)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < SD_BLOCK_SIZE) {
+        fprintf(stderr, "%s: too small to be a recording\n", path);
+        close(fd);
+        return false;
+    }
+    rec.size = st.st_size;
+    rec.base = (const uint8_t *) mmap(NULL, rec.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (rec.base == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+
+    rec.super = (const SDSuperBlock *) (rec.base + rec.size - SD_BLOCK_SIZE);
+    // version 1 has no channels field, versions 1-2 no mmgOutputs, 1-3 no artifacts and 1-4 no montage,
+    // the bytes after the super block are 0
+    bool valid = rec.super->magic == SD_SUPER_MAGIC && rec.super->version >= 1 && rec.super->version <= SD_FORMAT_VERSION;
+    if (rec.base[0] == 0xFF && memcmp(rec.base + 1, "BIOSEMI", 7) == 0 && !valid) {
+        openClosedBDF(rec);
+        return true;
+    }
+    if (!valid) {
+        fprintf(stderr, "%s: no super block, the file has no index\n", path);
+        return false;
+    }
+    rec.index = (const SDIndexEntry *) (rec.base + (size_t) rec.super->indexStart * SD_BLOCK_SIZE);
+
+    rec.commits = (const SDCommit *) (rec.base + (size_t) rec.super->commitStart * SD_BLOCK_SIZE);
+
+    // commits are appended in order, the valid ones are a prefix of the commit blocks
+    uint32_t lo = 0, hi = rec.super->commitBlocks;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (validCommit(rec, mid)) lo = mid + 1;
+        else hi = mid;
+    }
+    rec.numCommits = lo;
+
+    if (rec.super->closed) {
+        rec.entries = rec.super->indexEntries;
+        rec.usedBlocks = rec.super->usedBlocks;
+        rec.totalSamples = rec.super->totalSamples;
+    } else if (rec.numCommits > 0) {
+        const SDCommit &last = rec.commits[rec.numCommits - 1];
+        rec.entries = last.indexEntries;
+        rec.usedBlocks = last.usedBlocks;
+        rec.totalSamples = last.totalSamples;
+    } else {
+        rec.entries = 0;
+        rec.usedBlocks = 0;
+        rec.totalSamples = 0;
+    }
+    return true;
+}
+
+/**
+ * @description Returns a pointer to the first byte of the record described by an index entry
+ */
+static const char *recordAt(const Recording &rec, const SDIndexEntry &entry)
+{
+    return (const char *) rec.base + (size_t) entry.block * SD_BLOCK_SIZE + entry.offset;
+}
+
+/**
+ * @description End of the valid sample stream
+ */
+static const char *streamEnd(const Recording &rec)
+{
+    return (const char *) rec.base + (size_t) rec.usedBlocks * SD_BLOCK_SIZE;
+}
+
+/**
+ * @description Advances p to the start of the next sample record. Stamps ("%START AT" and
+ *  their time line) and the footer carry no commas and are skipped.
+ *  @returns the end of the record, or NULL when the stream is over
+ */
+static const char *nextRecord(const char *&p, const char *end)
+{
+    while (p < end && *p != 0) {
+        const char *eol = (const char *) memchr(p, '\n', end - p);
+        if (eol == NULL) return NULL;
+        if (*p != '%' && memchr(p, ',', eol - p) != NULL) return eol;
+        p = eol + 1;
+    }
+    return NULL;
+}
+
+/**
+ * @description Decodes the compressed record at p into values (channel major) and moves p to the
+ *  next record
+ * @returns false at the end of the stream, or when the record is cut or not valid
+ */
+static bool nextCodecRecord(const uint8_t *&p, const uint8_t *end, CodecBlockInfo &info, int32_t *values)
+{
+    if (end - p < SD_RECORD_LENGTH_BYTES) return false;
+    size_t length = p[0] | (p[1] << 8);
+    if (length == 0 || (size_t) (end - p) < SD_RECORD_LENGTH_BYTES + length) return false;
+    if (codecDecodeBlock(p + SD_RECORD_LENGTH_BYTES, length, info, values) != length) return false;
+    p += SD_RECORD_LENGTH_BYTES + length;
+    return true;
+}
+
+static void printCodecSample(uint32_t sample, const CodecBlockInfo &info, const int32_t *values, int n)
+{
+    printf("%u", sample);
+    for (int c = 0; c < info.eegChannels + info.mmgChannels; c++) printf(",%d", values[c * info.frames + n]);
+    printf("\n");
+}
+
+/**
+ * @description Prints a hex record as decimal CSV: sample counter, ADS channels (24 bit), MMG (16 bit)
+ *  and with artifacts the flags of Brainwear_artifact.h (24 bits, unsigned)
+ */
+static void printRecord(uint32_t sample, const char *p, const char *eol, bool artifacts)
+{
+    printf("%u", sample);
+    while (p < eol) {
+        long value = 0;
+        int nibbles = 0;
+        for (; p < eol && *p != ','; p++, nibbles++) {
+            char c = *p;
+            value = (value << 4) | (c <= '9' ? c - '0' : c - 'A' + 10);
+        }
+        bool flags = artifacts && p >= eol;
+        if (nibbles == 6 && (value & 0x800000) && !flags) value -= 0x1000000;   // ADS1299 channel
+        if (nibbles == 4 && (value & 0x8000)) value -= 0x10000;       // MMG channel
+        printf(",%ld", value);
+        p++;
+    }
+    printf("\n");
+}
+
+/**
+ * @description Prints COUNT samples of a BDF recording starting at FIRST. Records have a fixed
+ *  size, the one holding FIRST is found directly. Each signal of a record is a run of little
+ *  endian 24-bit samples, converted in one go.
+ */
+static int printBDFSamples(const Recording &rec, uint32_t first, uint32_t count)
+{
+    long headerSize = bdfField(rec.base, 184, 8);
+    long numSignals = bdfField(rec.base, 252, 4);
+    long perRecord = numSignals > 0 ? bdfField(rec.base, 256 + numSignals * 216, 8) : 0;
+    if (numSignals <= 0 || numSignals > BDF_MAX_SIGNALS || perRecord <= 0) {
+        fprintf(stderr, "not a BDF header\n");
+        return 1;
+    }
+    for (long i = 1; i < numSignals; i++) {
+        if (bdfField(rec.base, 256 + numSignals * 216 + i * 8, 8) != perRecord) {
+            fprintf(stderr, "signals with different sample rates are not supported\n");
+            return 1;
+        }
+    }
+    long recordSize = numSignals * perRecord * BDF_BYTES_PER_SAMPLE;
+    size_t used = (size_t) rec.usedBlocks * SD_BLOCK_SIZE;
+    if (used > rec.size) used = rec.size;
+    uint32_t records = (long) used > headerSize ? (used - headerSize) / recordSize : 0;
+    uint32_t samples = records * perRecord;
+    if (rec.totalSamples > 0 && rec.totalSamples < samples) samples = rec.totalSamples;
+    if (first >= samples) {
+        fprintf(stderr, "sample %u is past the end of the recording\n", first);
+        return 1;
+    }
+    if (count > samples - first) count = samples - first;
+
+    int32_t *values = (int32_t *) malloc(numSignals * perRecord * sizeof(int32_t));
+    uint32_t sample = first;
+    while (sample < first + count) {
+        uint32_t record = sample / perRecord;
+        const uint8_t *p = rec.base + headerSize + (size_t) record * recordSize;
+        for (long i = 0; i < numSignals; i++) {
+            int24LEToInt32(p + i * perRecord * BDF_BYTES_PER_SAMPLE, values + i * perRecord, perRecord);
+        }
+        for (uint32_t k = sample % perRecord; k < (uint32_t) perRecord && sample < first + count; k++, sample++) {
+            printf("%u", sample);
+            for (long i = 0; i < numSignals; i++) printf(",%d", values[i * perRecord + k]);
+            printf("\n");
+        }
+    }
+    free(values);
+    return 0;
+}
+
+/**
+ * @description Prints COUNT samples starting at FIRST. The index entry is found directly
+ *  from the sample number, at most SD_INDEX_INTERVAL - 1 records are skipped after it.
+ */
+static int printSamples(const Recording &rec, uint32_t first, uint32_t count)
+{
+    if (rec.super->format == SD_FORMAT_BDF) return printBDFSamples(rec, first, count);
+    uint32_t e = first / rec.super->indexInterval;
+    if (e >= rec.entries) {
+        fprintf(stderr, "sample %u is past the end of the recording\n", first);
+        return 1;
+    }
+    const SDIndexEntry &entry = rec.index[e];
+    if (rec.super->format == SD_FORMAT_RICE) {
+        static int32_t values[CODEC_MAX_CHANNELS * CODEC_MAX_FRAMES];
+        const uint8_t *p = (const uint8_t *) recordAt(rec, entry);
+        const uint8_t *end = (const uint8_t *) streamEnd(rec);
+        uint32_t sample = entry.sample;
+        CodecBlockInfo info;
+        while (sample < first + count && nextCodecRecord(p, end, info, values)) {
+            for (int n = 0; n < info.frames && sample < first + count; n++, sample++) {
+                if (sample >= first) printCodecSample(sample, info, values, n);
+            }
+        }
+        return 0;
+    }
+    const char *p = recordAt(rec, entry);
+    const char *end = streamEnd(rec);
+    uint32_t sample = entry.sample;
+    while (sample < first + count) {
+        const char *eol = nextRecord(p, end);
+        if (eol == NULL) break;
+        if (sample >= first) printRecord(sample, p, eol, rec.super->artifacts != 0);
+        p = eol + 1;
+        sample++;
+    }
+    return 0;
+}
+
+/**
+ * @description Prints the samples stored between two millis() stamps. The entry is estimated
+ *  from the sample rate and corrected with its neighbours, so a gap in the stream only
+ *  costs a few extra steps.
+ */
+static int printTimeRange(const Recording &rec, uint32_t startMs, uint32_t endMs)
+{
+    if (rec.entries == 0) return 1;
+    const SDIndexEntry *index = rec.index;
+    double msPerEntry = 1000.0 * rec.super->indexInterval / rec.super->sampleRate;
+    long e = (long) ((double) ((int64_t) startMs - index[0].millis) / msPerEntry);
+    if (e < 0) e = 0;
+    if (e >= (long) rec.entries) e = rec.entries - 1;
+    while (e > 0 && index[e].millis > startMs) e--;
+    while (e + 1 < (long) rec.entries && index[e + 1].millis <= startMs) e++;
+
+    double msPerSample = 1000.0 / rec.super->sampleRate;
+    if (rec.super->format == SD_FORMAT_RICE) {
+        static int32_t values[CODEC_MAX_CHANNELS * CODEC_MAX_FRAMES];
+        const uint8_t *p = (const uint8_t *) recordAt(rec, index[e]);
+        const uint8_t *end = (const uint8_t *) streamEnd(rec);
+        uint32_t sample = index[e].sample;
+        CodecBlockInfo info;
+        while (nextCodecRecord(p, end, info, values)) {
+            for (int n = 0; n < info.frames; n++, sample++) {
+                uint32_t k = sample / rec.super->indexInterval;
+                if (k >= rec.entries) k = rec.entries - 1;
+                double ms = index[k].millis + ((double) sample - index[k].sample) * msPerSample;
+                if (ms >= endMs) return 0;
+                if (ms >= startMs) printCodecSample(sample, info, values, n);
+            }
+        }
+        return 0;
+    }
+    const char *p = recordAt(rec, index[e]);
+    const char *end = streamEnd(rec);
+    uint32_t sample = index[e].sample;
+    while (true) {
+        // time of this sample, from the last index entry at or before it
+        uint32_t k = sample / rec.super->indexInterval;
+        if (k >= rec.entries) k = rec.entries - 1;
+        double ms = index[k].millis + (sample - index[k].sample) * msPerSample;
+        if (ms >= endMs) break;
+        const char *eol = nextRecord(p, end);
+        if (eol == NULL) break;
+        if (ms >= startMs) printRecord(sample, p, eol, rec.super->artifacts != 0);
+        p = eol + 1;
+        sample++;
+    }
+    return 0;
+}
+
+static const char *formatName(uint32_t format)
+{
+    return format == SD_FORMAT_BDF ? "BDF" : format == SD_FORMAT_RICE ? "rice" : "text";
+}
+
+/**
+ * @description Prints the super block
+ */
+static void printInfo(const Recording &rec)
+{
+    const SDSuperBlock *s = rec.super;
+    printf("blocks         %u\n", s->blockCount);
+    printf("data blocks    %u\n", s->dataBlocks);
+    printf("index blocks   %u at block %u\n", s->indexBlocks, s->indexStart);
+    printf("index interval %u samples\n", s->indexInterval);
+    printf("sample rate    %u Hz\n", s->sampleRate);
+    printf("format         %s\n", formatName(s->format));
+    if (s->channels != 0) {
+        printf("EEG channels  ");
+        for (int c = 0; c < 32; c++) {
+            if (s->channels & (1UL << c)) printf(" %d", c + 1);
+        }
+        printf("%s\n", s->format == SD_FORMAT_RICE ? " (each block has its own)" : "");
+    } else if (rec.index != NULL) {
+        printf("EEG channels   all\n");
+    }
+    if (s->mmgOutputs != 0 && s->format != SD_FORMAT_RICE) {    // MMG_OUTPUT_ bits of Brainwear_definitions.h
+        printf("MMG outputs   %s%s%s\n", s->mmgOutputs & 1 ? " raw" : "", s->mmgOutputs & 2 ? " envelope" : "",
+               s->mmgOutputs & 4 ? " RMS" : "");
+    }
+    if (s->artifacts != 0 && s->format != SD_FORMAT_RICE) printf("artifact flags yes\n");
+    if (s->montage != MONTAGE_AS_MEASURED && s->montage <= MONTAGE_CUSTOM) {
+        MontageTerm terms[SD_MONTAGE_TERMS];
+        uint32_t count = s->montageTerms < SD_MONTAGE_TERMS ? s->montageTerms : SD_MONTAGE_TERMS;
+        for (uint32_t i = 0; i < count; i++) {
+            terms[i].channels = s->montageTerm[i][0];
+            terms[i].weight = (int8_t) s->montageTerm[i][1];
+        }
+        Montage<8> montage;
+        montage.configure(s->montage, terms, count, s->channels != 0 ? s->channels : 0xFF);
+        printf("montage       ");
+        for (int c = 0; c < 8; c++) {
+            char text[MONTAGE_TEXT];
+            montage.rowText(c, text);
+            if (text[0] != '\0') printf(" %s", text);
+        }
+        printf("\n");
+    }
+    printf("closed         %s\n", s->closed ? "yes" : "no, read up to the last commit");
+    printf("commits        %u every %u blocks\n", rec.numCommits, s->commitInterval);
+    printf("index entries  %u\n", rec.entries);
+    printf("used blocks    %u\n", rec.usedBlocks);
+    printf("samples        %u\n", rec.totalSamples);
+    if (rec.entries > 0) {
+        printf("first stamp    %u ms\n", rec.index[0].millis);
+        printf("last stamp     %u ms\n", rec.index[rec.entries - 1].millis);
+    }
+}
+
+/**
+ * @description Compares every committed data block with its CRC. Torn or corrupted blocks are listed
+ */
+static int checkBlocks(const Recording &rec)
+{
+    uint32_t checked = 0, bad = 0;
+    for (uint32_t n = 0; n < rec.numCommits; n++) {
+        const SDCommit &c = rec.commits[n];
+        for (uint32_t i = 0; i < c.numCrc; i++) {
+            uint32_t block = c.firstBlock + i;
+            if (block >= rec.super->dataBlocks) break;
+            uint16_t crc = sdCrc16(rec.base + (size_t) block * SD_BLOCK_SIZE, SD_BLOCK_SIZE, 0xFFFF);
+            if (crc != c.crc[i]) {
+                printf("block %u: bad CRC\n", block);
+                bad++;
+            }
+            checked++;
+        }
+    }
+    printf("%u blocks checked, %u bad\n", checked, bad);
+    return bad ? 1 : 0;
+}
+
+/**
+ * @description Writes a closed copy of the recording. Text and compressed files keep their layout
+ *  with the super block completed from the last commit. BDF files get the number of records and
+ *  are cut after the last complete record, as the firmware does on close.
+ */
+static int recoverFile(const Recording &rec, const char *out)
+{
+    FILE *f = fopen(out, "wb");
+    if (f == NULL) {
+        perror(out);
+        return 1;
+    }
+    size_t used = (size_t) rec.usedBlocks * SD_BLOCK_SIZE;
+    if (rec.super->format == SD_FORMAT_BDF) {
+        long headerSize = bdfField(rec.base, 184, 8);
+        long numSignals = bdfField(rec.base, 252, 4);
+        long recordSize = 0;
+        for (long i = 0; i < numSignals; i++) {
+            recordSize += BDF_BYTES_PER_SAMPLE * bdfField(rec.base, 256 + numSignals * 216 + i * 8, 8);
+        }
+        long records = (recordSize > 0 && (long) used > headerSize) ? (used - headerSize) / recordSize : 0;
+        uint8_t *header = (uint8_t *) malloc(headerSize);
+        memcpy(header, rec.base, headerSize);
+        BDF::formatNumberOfRecords((char *) header + BDF_RECORDS_FIELD_OFFSET, records);
+        fwrite(header, 1, headerSize, f);
+        fwrite(rec.base + headerSize, 1, records * recordSize, f);
+        free(header);
+        printf("%ld BDF records recovered\n", records);
+    } else {
+        SDSuperBlock super = *rec.super;
+        super.closed = 1;
+        super.usedBlocks = rec.usedBlocks;
+        super.indexEntries = rec.entries;
+        super.totalSamples = rec.totalSamples;
+        fwrite(rec.base, 1, rec.size - SD_BLOCK_SIZE, f);
+        uint8_t block[SD_BLOCK_SIZE] = {0};
+        memcpy(block, &super, sizeof(super));
+        fwrite(block, 1, SD_BLOCK_SIZE, f);
+        printf("%u blocks, %u samples recovered\n", rec.usedBlocks, rec.totalSamples);
+    }
+    fclose(f);
+    return 0;
+}
+
+/**
+ * @description Lists the session catalog of a card
+ * @returns false if the file is not a catalog
+ */
+static bool printCatalog(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return false;
+    SDCatalogHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != SD_CATALOG_MAGIC) {
+        fclose(f);
+        return false;
+    }
+    printf("next session   %08X\n", header.nextNumber);
+    printf("file            format  rate  blocks    samples  closed\n");
+    SDCatalogRecord record;
+    for (uint32_t i = 0; i < header.sessions && fread(&record, sizeof(record), 1, f) == 1; i++) {
+        printf("%08X.%s    %-6s  %-5u %-9u %-8u %s\n", record.number,
+               record.format == SD_FORMAT_BDF ? "BDF" : record.format == SD_FORMAT_RICE ? "BWC" : "TXT", formatName(record.format),
+               record.sampleRate, record.blockCount, record.totalSamples, record.closed ? "yes" : "no");
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 5) {
+        fprintf(stderr, "usage: %s FILE [-s FIRST COUNT | -t START_MS END_MS | -c | -r OUT]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && printCatalog(argv[1])) return 0;
+    Recording rec;
+    if (!openRecording(argv[1], rec)) return 1;
+
+    if (argc == 2) {
+        printInfo(rec);
+        return 0;
+    }
+    if (argc == 3 && strcmp(argv[2], "-c") == 0) return checkBlocks(rec);
+    if (argc == 4 && strcmp(argv[2], "-r") == 0) return recoverFile(rec, argv[3]);
+    if (argc != 5) {
+        fprintf(stderr, "missing arguments for %s\n", argv[2]);
+        return 2;
+    }
+    uint32_t a = strtoul(argv[3], NULL, 0);
+    uint32_t b = strtoul(argv[4], NULL, 0);
+    if (strcmp(argv[2], "-s") == 0) return printSamples(rec, a, b);
+    if (strcmp(argv[2], "-t") == 0) return printTimeRange(rec, a, b);
+    fprintf(stderr, "unknown option %s\n", argv[2]);
+    return 2;
+}
@@ -0,0 +1,303 @@
+/**
+ Decodes the serial stream of the Brainwear board to CSV, one line per sample.
+
+ The input is a capture of the serial port. The compressed blocks (command {) are sent as ADS_BOP,
+ the size of the block (2 bytes, little endian), the block coded as in Brainwear_codec.h and
+ ADS_EOP_CODEC; their lines are the sample number, the EEG channels and the MMG channels. Blocks
+ that do not decode are dropped and the samples missing between blocks are reported. The lines hold
+ the EEG channels of the block only, the channels that were powered down are left out; a change is
+ reported.
+
+ The sample packets (ADS_BOP, packet counter, samples, ADS_EOP) follow the layout of the last stream
+ header (ADS_BOP, ..., ADS_EOP_HEADER, see Brainwear::sendStreamHeader), the OpenBCI layout of 24-bit
+ samples of every channel before the first one. Their lines are the packet counter, the active EEG
+ channels in counts of the ADS1299 (the shifted samples multiplied back), the MMG values (for each
+ output the channels of MMG1 then MMG2) and the three masks of the artifact flags when the packets
+ carry them. Whether the packets hold the MMG boards (commands M and N) is not in the header, it is
+ taken from where the packets end. The band power, impedance and MMG event packets and the bytes
+ around the packets (status messages, ASCII lines) are skipped.
+
+ Usage:
+   stream_decoder CAPTURE [OUT.csv]
+**/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Brainwear_test/Brainwear_codec.h"
+
+#define ADS_BOP             0xA0    // as in Brainwear_definitions.h
+#define ADS_EOP             0xC0
+#define ADS_EOP_CODEC       0xC1
+#define ADS_EOP_HEADER      0xC2
+#define ADS_EOP_FEATURES    0xC3
+#define ADS_EOP_IMPEDANCE   0xC4
+#define ADS_EOP_MMG_EVENT   0xC5
+#define MAX_CHANNELS        8
+#define MAX_SHIFT           9       // ADS_SERIAL_SHIFT_MAX
+#define MMG_BYTES           16      // 2 boards of 4 channels, 16 bits, for each output
+#define ARTIFACT_BYTES      3
+#define FEATURE_BANDS       5
+#define MONTAGE_CUSTOM      3
+#define MONTAGE_MAX_TERMS   16
+
+static int32_t values[CODEC_MAX_CHANNELS * CODEC_MAX_FRAMES];
+
+/**
+ * Layout of the sample packets, from a stream header
+ */
+typedef struct {
+    int bytes;          // per EEG sample
+    int channels;       // of the board
+    int mask;           // active EEG channels, bit n for channel n + 1
+    int shift[MAX_CHANNELS];
+    int mmgOutputs;     // raw, envelope and RMS bits, 0 when only the MMG events are sent
+    int artifactBytes;
+    int montage;
+} Layout;
+
+static const char *montageNames[] = {"as measured", "common average", "bipolar", "custom"};
+
+static int bitCount(int mask)
+{
+    int count = 0;
+    for (; mask != 0; mask &= mask - 1) count++;
+    return count;
+}
+
+/**
+ * @description Bytes of a sample packet, ADS_BOP and ADS_EOP included
+ */
+static long packetLength(const Layout &layout, bool mmg)
+{
+    return 3 + bitCount(layout.mask) * layout.bytes + (mmg ? MMG_BYTES * bitCount(layout.mmgOutputs) : 0) +
+           layout.artifactBytes;
+}
+
+/**
+ * @description Reads the stream header at p, up to end
+ * @returns its length, 0 when p does not hold one
+ */
+static long parseHeader(const uint8_t *p, const uint8_t *end, Layout &layout)
+{
+    Layout next;
+    const uint8_t *q = p + 1;
+    if (end - q < 3) return 0;
+    next.bytes = *q++;
+    next.channels = *q++;
+    next.mask = *q++;
+    if (next.bytes < 1 || next.bytes > 3 || next.channels < 1 || next.channels > MAX_CHANNELS ||
+        next.mask >= 1 << next.channels || end - q < next.channels + 3) return 0;
+    for (int c = 0; c < next.channels; c++) {
+        next.shift[c] = *q++;
+        if (next.shift[c] > MAX_SHIFT) return 0;
+    }
+    next.mmgOutputs = *q++;
+    next.artifactBytes = *q++;
+    next.montage = *q++;
+    if (next.mmgOutputs > 7 || (next.artifactBytes != 0 && next.artifactBytes != ARTIFACT_BYTES) ||
+        next.montage > MONTAGE_CUSTOM) return 0;
+    if (next.montage == MONTAGE_CUSTOM) {
+        if (q == end || *q > MONTAGE_MAX_TERMS || end - q < 1 + 2 * *q) return 0;
+        q += 1 + 2 * *q;
+    }
+    if (q == end || *q != ADS_EOP_HEADER) return 0;
+    layout = next;
+    return q + 1 - p;
+}
+
+/**
+ * @description Length of the band power, impedance or MMG event packet at p, up to end
+ * @returns 0 when p does not hold one
+ */
+static long otherPacketLength(const uint8_t *p, const uint8_t *end)
+{
+    if (end - p < 4) return 0;
+    long length = 4 + 2 * FEATURE_BANDS * bitCount(p[2]);
+    if (end - p >= length && p[length - 1] == ADS_EOP_FEATURES) return length;
+    length = 4 + 2 * bitCount(p[2]);
+    if (end - p >= length && p[length - 1] == ADS_EOP_IMPEDANCE) return length;
+    length = 8;
+    if (end - p >= length && p[length - 1] == ADS_EOP_MMG_EVENT) return length;
+    return 0;
+}
+
+/**
+ * @description A sample packet of length bytes ends at p[length - 1]
+ * @returns 2 when the next packet or the end of the capture follows, 1 when other bytes follow, 0
+ *  when it does not end there
+ */
+static int packetEnds(const uint8_t *p, const uint8_t *end, long length)
+{
+    if (end - p < length || p[length - 1] != ADS_EOP) return 0;
+    return end - p == length || p[length] == ADS_BOP ? 2 : 1;
+}
+
+static void printLayout(FILE *f, const Layout &layout, int mmg)
+{
+    fprintf(f, "packets: %d bytes per sample, EEG channels", layout.bytes);
+    for (int c = 0; c < layout.channels; c++) {
+        if (layout.mask & (1 << c)) fprintf(f, " %d", c + 1);
+    }
+    fprintf(f, ", shifts");
+    for (int c = 0; c < layout.channels; c++) fprintf(f, " %d", layout.shift[c]);
+    if (mmg > 0) fprintf(f, ", MMG outputs %d", layout.mmgOutputs);
+    if (layout.artifactBytes > 0) fprintf(f, ", artifact flags");
+    fprintf(f, ", montage %s\n", montageNames[layout.montage]);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s CAPTURE [OUT.csv]\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *) malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, in) != (size_t) size) {
+        fprintf(stderr, "%s: read error\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+
+    uint32_t blocks = 0, samples = 0, missing = 0, codedBytes = 0;
+    uint32_t channels = 0;
+    int eegMask = -1;
+    bool started = false;
+    uint32_t nextSample = 0;
+
+    // the OpenBCI packets until the first header
+    Layout layout = {3, 4, 0x0F, {0}, 1, 0, 0};
+    uint32_t packets = 0, headers = 0, others = 0, lostPackets = 0;
+    int mmg = -1;               // the packets hold the MMG boards, -1 until a packet tells
+    int counter = -1;           // of the last packet
+    bool layoutPrinted = false;
+
+    const uint8_t *end = data + size;
+    long pos = 0;
+    while (pos + 4 <= size) {
+        if (data[pos] != ADS_BOP) {
+            pos++;
+            continue;
+        }
+        const uint8_t *p = data + pos;
+        long length = data[pos + 1] | (data[pos + 2] << 8);
+        long blockEnd = pos + 3 + length;
+        CodecBlockInfo info;
+        if (length >= CODEC_HEADER_BYTES && blockEnd < size && data[blockEnd] == ADS_EOP_CODEC &&
+            codecDecodeBlock(data + pos + 3, length, info, values) == (size_t) length) {
+            if (started && info.firstSample != nextSample) {
+                if (info.firstSample > nextSample) {
+                    fprintf(stderr, "samples %u to %u missing\n", nextSample, info.firstSample - 1);
+                    missing += info.firstSample - nextSample;
+                } else {
+                    fprintf(stderr, "stream restarted at sample %u\n", info.firstSample);
+                }
+            }
+            if (info.eegMask != eegMask) {
+                fprintf(stderr, "sample %u: EEG channels", info.firstSample);
+                for (int c = 0; c < 8; c++) {
+                    if (info.eegMask & (1 << c)) fprintf(stderr, " %d", c + 1);
+                }
+                fprintf(stderr, "\n");
+                eegMask = info.eegMask;
+            }
+            int numChannels = info.eegChannels + info.mmgChannels;
+            for (int n = 0; n < info.frames; n++) {
+                fprintf(out, "%u", info.firstSample + n);
+                for (int c = 0; c < numChannels; c++) fprintf(out, ",%d", values[c * info.frames + n]);
+                fprintf(out, "\n");
+            }
+            started = true;
+            nextSample = info.firstSample + info.frames;
+            blocks++;
+            samples += info.frames;
+            channels = numChannels;
+            codedBytes += length;
+            pos = blockEnd + 1;
+            continue;
+        }
+
+        length = parseHeader(p, end, layout);
+        if (length > 0) {
+            headers++;
+            layoutPrinted = false;
+            counter = -1;       // a header starts a stream or comes between two packets
+            pos += length;
+            continue;
+        }
+
+        // with and without the MMG boards: when both fit, the one followed by the next packet, then
+        // the one of the last packets
+        long withMMG = packetLength(layout, true), withoutMMG = packetLength(layout, false);
+        int fitsMMG = packetEnds(p, end, withMMG), fitsNoMMG = packetEnds(p, end, withoutMMG);
+        if (fitsMMG > 0 || fitsNoMMG > 0) {
+            int packetMMG = fitsMMG > fitsNoMMG || (fitsMMG == fitsNoMMG && mmg != 0);
+            if (packetMMG != mmg) layoutPrinted = false;
+            mmg = packetMMG;
+            length = mmg ? withMMG : withoutMMG;
+            if (!layoutPrinted) {
+                printLayout(stderr, layout, mmg);
+                layoutPrinted = true;
+            }
+            if (counter >= 0 && p[1] != ((counter + 1) & 0xFF)) {
+                lostPackets += (p[1] - counter - 1) & 0xFF;
+            }
+            counter = p[1];
+
+            const uint8_t *q = p + 2;
+            fprintf(out, "%u", p[1]);
+            for (int c = 0; c < layout.channels; c++) {
+                if (!(layout.mask & (1 << c))) continue;
+                int32_t value = (int8_t) *q++;      // big endian, signed
+                for (int b = 1; b < layout.bytes; b++) value = value * 256 + *q++;
+                fprintf(out, ",%ld", (long) value * (1L << layout.shift[c]));
+            }
+            for (int i = 0; mmg && i < MMG_BYTES / 2 * bitCount(layout.mmgOutputs); i++, q += 2) {
+                fprintf(out, ",%d", (int16_t) (q[0] << 8 | q[1]));
+            }
+            for (int i = 0; i < layout.artifactBytes; i++) fprintf(out, ",%u", *q++);
+            fprintf(out, "\n");
+            packets++;
+            pos += length;
+            continue;
+        }
+
+        length = otherPacketLength(p, end);
+        if (length > 0) {
+            others++;
+            pos += length;
+            continue;
+        }
+        pos++;
+    }
+    free(data);
+    if (out != stdout) fclose(out);
+
+    if (blocks > 0 || packets == 0) {
+        fprintf(stderr, "%u blocks, %u samples, %u missing\n", blocks, samples, missing);
+        if (samples > 0 && channels > 0) {
+            fprintf(stderr, "%.2f bits per sample and channel\n", 8.0 * codedBytes / samples / channels);
+        }
+    }
+    if (packets > 0 || headers > 0) {
+        fprintf(stderr, "%u sample packets, %u lost, %u headers, %u other packets\n", packets, lostPackets,
+                headers, others);
+    }
+    return 0;
+}
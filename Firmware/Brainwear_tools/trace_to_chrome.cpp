@@ -0,0 +1,137 @@
+/**
+ Converts the trace dumps of the Brainwear board to the Chrome trace format (JSON), to be opened
+ in chrome://tracing or https://ui.perfetto.dev.
+
+ The input is a capture of the serial port that contains one or more dumps (command &), the
+ bytes around them are skipped. Consecutive dumps are joined on one time line.
+
+ Usage:
+   trace_to_chrome CAPTURE [OUT.json]
+**/
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../Brainwear_test/Brainwear_trace.h"
+
+static const char *stageNames[TRACE_STAGES] = {
+    "DRDY", "updateBoardData", "updateMMGData", "writeDataToSDcard", "writeCache", "sendData", "command", "mains"
+};
+
+struct Timeline {
+    bool started;
+    uint32_t lastCycles;
+    int64_t cycles;     // unwrapped time of the last event
+};
+
+/**
+ * @description Time of an event in cycles since the first event. The counter wraps around, the
+ *  events are close enough that the difference with the previous one fits in 32 bits. DRDY
+ *  events are recorded after the stage they started, so differences can be negative
+ */
+static int64_t unwrap(Timeline &timeline, uint32_t cycles)
+{
+    if (!timeline.started) {
+        timeline.started = true;
+        timeline.cycles = 0;
+    } else {
+        timeline.cycles += (int32_t) (cycles - timeline.lastCycles);
+    }
+    timeline.lastCycles = cycles;
+    return timeline.cycles;
+}
+
+static void writeEvent(FILE *out, const TraceEvent &event, double us, bool &first)
+{
+    if (event.stage >= TRACE_STAGES || event.phase > TRACE_INSTANT) return;
+    char name[48];
+    if (event.stage == TRACE_UPDATE_MMG || (event.stage == TRACE_MAINS && event.arg != 0)) {
+        snprintf(name, sizeof(name), "%s 0x%02X", stageNames[event.stage], event.arg);
+    } else if (event.stage == TRACE_COMMAND) {
+        if (isalnum(event.arg) || (ispunct(event.arg) && event.arg != '"' && event.arg != '\\')) {
+            snprintf(name, sizeof(name), "%s '%c'", stageNames[event.stage], event.arg);
+        } else {
+            snprintf(name, sizeof(name), "%s 0x%02X", stageNames[event.stage], event.arg);
+        }
+    } else {
+        snprintf(name, sizeof(name), "%s", stageNames[event.stage]);
+    }
+    static const char phases[] = {'B', 'E', 'i'};
+    fprintf(out, "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", first ? "" : ",", name,
+            phases[event.phase], us, event.stage == TRACE_DRDY ? 1 : 2);
+    if (event.phase == TRACE_INSTANT) fprintf(out, ",\"s\":\"t\"");
+    if (event.stage == TRACE_SD_BLOCK && event.phase == TRACE_BEGIN) fprintf(out, ",\"args\":{\"block\":%u}", event.arg);
+    fprintf(out, "}");
+    first = false;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s CAPTURE [OUT.json]\n", argv[0]);
+        return 2;
+    }
+    FILE *in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = (uint8_t *) malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, in) != (size_t) size) {
+        fprintf(stderr, "%s: read error\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+
+    FILE *out = argc == 3 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL) {
+        perror(argv[2]);
+        return 1;
+    }
+    fprintf(out, "{\"traceEvents\":[");
+    fprintf(out, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"DRDY interrupt\"}}");
+    fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"loop\"}}");
+    bool first = false;
+
+    Timeline timeline = {false, 0, 0};
+    int dumps = 0;
+    uint32_t events = 0;
+    uint32_t lost = 0;
+    long pos = 0;
+    while (pos + (long) sizeof(TraceDumpHeader) <= size) {
+        TraceDumpHeader header;
+        memcpy(&header, data + pos, sizeof(header));
+        long end = pos + sizeof(header) + (long) header.count * sizeof(TraceEvent);
+        if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.cpuMHz == 0 ||
+            header.count > TRACE_RING_SIZE || end > size) {
+            pos++;
+            continue;
+        }
+        for (uint32_t i = 0; i < header.count; i++) {
+            TraceEvent event;
+            memcpy(&event, data + pos + sizeof(header) + i * sizeof(TraceEvent), sizeof(event));
+            double us = (double) unwrap(timeline, event.cycles) / header.cpuMHz;
+            writeEvent(out, event, us, first);
+        }
+        dumps++;
+        events += header.count;
+        lost += header.lost;
+        pos = end;
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    if (out != stdout) fclose(out);
+    free(data);
+
+    if (dumps == 0) {
+        fprintf(stderr, "%s: no trace dump found\n", argv[1]);
+        return 1;
+    }
+    fprintf(stderr, "%d dumps, %u events, %u lost\n", dumps, events, lost);
+    return 0;
+}